@@ -27,35 +27,75 @@
 #define IS1             (4)
 // IS1 = A4
 #define IS2             (5)
+// IS1 = A4 = ADC4, IS2 = A5 = ADC5, reference is AVcc like analogRead
+#define MUX_ADC_TO_IS1() do { ADMUX = (1<<REFS0) | (1<<MUX2); } while(0)
+#define MUX_ADC_TO_IS2() do { ADMUX = (1<<REFS0) | (1<<MUX2) | (1<<MUX0); } while(0)
+// the average is taken over roughly the last 2^CURRENT_AVERAGE_SHIFT samples
+#define CURRENT_AVERAGE_SHIFT (3)
+
+/* MACRO SECTION */
+// IN1 = OC0B, IN2 = OC0A - the output compare units override the port pins while connected
+#define HW_PWM_DISCONNECT() do { TCCR0A &= ~((1<<COM0A1) | (1<<COM0A0) | (1<<COM0B1) | (1<<COM0B0)); } while(0)
+#define HW_PWM_ON_IN1() do { HW_PWM_DISCONNECT(); TCCR0A |= (1<<COM0B1); } while(0)
+#define HW_PWM_ON_IN2() do { HW_PWM_DISCONNECT(); TCCR0A |= (1<<COM0A1); } while(0)
 
 typedef struct {
   uint8_t spd;
   E_DIRECTION dir;
+  E_PWM_MODE pwm_mode;
 } 
 s_motor_params;
 static volatile s_motor_params m_motor_params = {
-  0, FWD};
+  0, FWD, SOFTWARE_PWM};
+
+typedef struct {
+  uint16_t is1;
+  uint16_t is2;
+  uint16_t is1_average;
+  uint16_t is2_average;
+}
+s_current_sense;
+// the adc isr writes the buffer which is not read and flips m_current_sense_read_idx afterwards, so the getters never see a half written value
+static volatile s_current_sense m_current_sense[2] = {{0, 0, 0, 0}, {0, 0, 0, 0}};
+static volatile uint8_t m_current_sense_read_idx = 0;
+static volatile bool m_is_current_sampling_active = false;
+
+/* PROTOTYPE SECTION */
+static void update_hardware_pwm();
 
 /**
  * @brief initializes the motorshield
+ * @param pwm_mode selects how the pwm signal for IN1/IN2 is generated
  */
-void LXR_highpower_motorshield::begin() {
+void LXR_highpower_motorshield::begin(E_PWM_MODE const pwm_mode) {
   // set inh to output and to low (halfbridges deactivated)
   INH_PORT &= ~INH;
   INH_DDR |= INH;
+  // stop the software pwm first in case begin is called a second time, its overflow isr would set IN1/IN2 again
+  TIMSK2 = 0x00;
+  TCCR2B = 0x00;
   // set inX pins to outputs with value low
   IN1_PORT &= ~IN1;
   IN1_DDR |= IN1;
   IN2_PORT &= ~IN2;
   IN2_DDR |= IN2;
-  // clear TCCR2A from whatever might be still left there
-  TCCR2A = 0x00;	
-  // reset the timer value
-  TCNT2 = 0;
-  // enable compare and overflow interrupts
-  TIMSK2 = (1<<OCIE2A) | (1<<TOIE2);
-  // activate timer with prescaler 32 => f_PWM = 1,96 kHz
-  TCCR2B = (1<<CS21) | (1<<CS20);
+  m_motor_params.pwm_mode = pwm_mode;
+  if(pwm_mode == HARDWARE_PWM) {
+    // timer 0 has been set up by the arduino core: fast pwm, prescaler 64 => f_PWM = 976 Hz
+    // only the output compare units are used here, millis() keeps working
+    OCR0A = 0;
+    OCR0B = 0;
+  } else {
+    HW_PWM_DISCONNECT();
+    // clear TCCR2A from whatever might be still left there
+    TCCR2A = 0x00;	
+    // reset the timer value
+    TCNT2 = 0;
+    // enable compare and overflow interrupts
+    TIMSK2 = (1<<OCIE2A) | (1<<TOIE2);
+    // activate timer with prescaler 32 => f_PWM = 1,96 kHz
+    TCCR2B = (1<<CS21) | (1<<CS20);
+  }
   // set direction
   LXR_highpower_motorshield::set_direction(m_motor_params.dir);
   // set speed
@@ -70,7 +110,13 @@ void LXR_highpower_motorshield::begin() {
  */
 void LXR_highpower_motorshield::set_speed(uint8_t const speed) {
   m_motor_params.spd = speed;
-  OCR2A = m_motor_params.spd;
+  if(m_motor_params.pwm_mode == HARDWARE_PWM) {
+    OCR0A = m_motor_params.spd;
+    OCR0B = m_motor_params.spd;
+    update_hardware_pwm();
+  } else {
+    OCR2A = m_motor_params.spd;
+  }
 }
 
 /** 
@@ -86,6 +132,7 @@ uint8_t LXR_highpower_motorshield::get_speed() {
  */
 void LXR_highpower_motorshield::set_direction(E_DIRECTION const dir) {
   m_motor_params.dir = dir;
+  if(m_motor_params.pwm_mode == HARDWARE_PWM) update_hardware_pwm();
 }
 
 /** 
@@ -95,18 +142,59 @@ E_DIRECTION LXR_highpower_motorshield::get_direction() {
   return m_motor_params.dir;
 }
 
+/**
+ * @brief starts the interrupt driven sampling of IS1 and IS2 in the background
+ */
+void LXR_highpower_motorshield::begin_current_sampling() {
+  // the adc has been enabled with prescaler 128 (fADC = 125 kHz) by the arduino core
+  // wait for a conversion started by analogRead to finish
+  while(ADCSRA & (1<<ADSC)) { }
+  m_is_current_sampling_active = true;
+  // clear interrupt flag and enable adc complete interrupt
+  ADCSRA |= (1<<ADIF) | (1<<ADIE);
+  // mux to is 1 and start the first conversion, the isr alternates between both channels
+  MUX_ADC_TO_IS1();
+  ADCSRA |= (1<<ADSC);
+}
+
 /**
  * @brief returns the current flow over the half brigde 1
  */
 int LXR_highpower_motorshield::get_current_half_brigde_1() {
-  return analogRead(IS1);
+  if(!m_is_current_sampling_active) return analogRead(IS1);
+  return m_current_sense[m_current_sense_read_idx].is1;
 }
 
 /**
  * @brief returns the current flow over the half brigde 2
  */
 int LXR_highpower_motorshield::get_current_half_brigde_2() {
-  return analogRead(IS2);
+  if(!m_is_current_sampling_active) return analogRead(IS2);
+  return m_current_sense[m_current_sense_read_idx].is2;
+}
+
+/**
+ * @brief returns the average of the recent current samples of half brigde 1 - requires begin_current_sampling
+ */
+int LXR_highpower_motorshield::get_average_current_half_brigde_1() {
+  return m_current_sense[m_current_sense_read_idx].is1_average;
+}
+
+/**
+ * @brief returns the average of the recent current samples of half brigde 2 - requires begin_current_sampling
+ */
+int LXR_highpower_motorshield::get_average_current_half_brigde_2() {
+  return m_current_sense[m_current_sense_read_idx].is2_average;
+}
+
+/**
+ * @brief connects the output compare unit matching the direction to its pin
+ */
+static void update_hardware_pwm() {
+  // even with OCR0x = 0 the fast pwm mode emits a spike every period, therefore the pins are disconnected at speed 0
+  if(m_motor_params.spd == 0) HW_PWM_DISCONNECT();
+  else if(m_motor_params.dir == FWD) HW_PWM_ON_IN1();
+  else if(m_motor_params.dir == BWD) HW_PWM_ON_IN2();
 }
 
 /**
@@ -127,3 +215,37 @@ ISR(TIMER2_COMPA_vect) {
   IN2_PORT &= ~IN2;
 }
 
+/**
+ * @brief ISR for adc conversion complete - alternates between IS1 and IS2
+ */
+ISR(ADC_vect) {
+  // state owned by the isr, the exponential moving averages are kept scaled by 2^CURRENT_AVERAGE_SHIFT
+  static s_current_sense current_sense = {0, 0, 0, 0};
+  static uint16_t is1_average_acc = 0;
+  static uint16_t is2_average_acc = 0;
+
+  uint16_t const sample = ADC;
+  bool const is_is1 = (ADMUX & (1<<MUX0)) == 0;
+
+  // start the conversion of the other channel right away
+  if(is_is1) MUX_ADC_TO_IS2();
+  else MUX_ADC_TO_IS1();
+  ADCSRA |= (1<<ADSC);
+
+  if(is_is1) {
+    is1_average_acc = is1_average_acc - (is1_average_acc >> CURRENT_AVERAGE_SHIFT) + sample;
+    current_sense.is1 = sample;
+    current_sense.is1_average = is1_average_acc >> CURRENT_AVERAGE_SHIFT;
+  } else {
+    is2_average_acc = is2_average_acc - (is2_average_acc >> CURRENT_AVERAGE_SHIFT) + sample;
+    current_sense.is2 = sample;
+    current_sense.is2_average = is2_average_acc >> CURRENT_AVERAGE_SHIFT;
+  }
+
+  uint8_t const write_idx = m_current_sense_read_idx ^ 1;
+  m_current_sense[write_idx].is1 = current_sense.is1;
+  m_current_sense[write_idx].is2 = current_sense.is2;
+  m_current_sense[write_idx].is1_average = current_sense.is1_average;
+  m_current_sense[write_idx].is2_average = current_sense.is2_average;
+  m_current_sense_read_idx = write_idx;
+}
@@ -14,12 +14,19 @@ typedef enum {
   FWD = 0, BWD = 1} 
 E_DIRECTION;
 
+// SOFTWARE_PWM: timer 2 isrs switch IN1/IN2 (1.96 kHz)
+// HARDWARE_PWM: IN1/IN2 are driven by OC0B/OC0A of timer 0 which is already running in fast pwm mode for millis() (976 Hz), no isr is required
+typedef enum {
+  SOFTWARE_PWM = 0, HARDWARE_PWM = 1}
+E_PWM_MODE;
+
 class LXR_highpower_motorshield {
 public:
   /**
    * @brief initializes the motorshield
+   * @param pwm_mode selects how the pwm signal for IN1/IN2 is generated
    */
-  static void begin();
+  static void begin(E_PWM_MODE const pwm_mode = SOFTWARE_PWM);
 
   /** 
    * @brief set the speed of the motor control
@@ -43,15 +50,33 @@ public:
    */
    static E_DIRECTION get_direction();
    
+   /**
+    * @brief starts the interrupt driven sampling of IS1 and IS2 in the background
+    * afterwards the adc is owned by the library, analogRead must not be used anymore
+    */
+   static void begin_current_sampling();
+
    /**
     * @brief returns the current flow over the half brigde 1
+    * without background sampling this performs a blocking analogRead, otherwise the latest sample is returned immediately
     */
    static int get_current_half_brigde_1();
    
    /**
     * @brief returns the current flow over the half brigde 2
+    * without background sampling this performs a blocking analogRead, otherwise the latest sample is returned immediately
     */
    static int get_current_half_brigde_2();
+
+   /**
+    * @brief returns the average of the recent current samples of half brigde 1 - requires begin_current_sampling
+    */
+   static int get_average_current_half_brigde_1();
+
+   /**
+    * @brief returns the average of the recent current samples of half brigde 2 - requires begin_current_sampling
+    */
+   static int get_average_current_half_brigde_2();
 };
 
 #endif
@@ -9,6 +9,7 @@
 
 void setup() {
   LXR_highpower_motorshield::begin();
+  LXR_highpower_motorshield::begin_current_sampling();
   Serial.begin(115200);
 }
 
@@ -0,0 +1,62 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this sketch measures the cpu time consumed by the software and the hardware pwm mode of the LXRobotics Highpower Arduino Motorshield Library
+ * @file pwm_cpu_load.ino
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "LXR_highpower_motorshield.h"
+
+// the motor is driven with half speed during the measurement - disconnect the motor supply if that is not desired
+static uint8_t const TEST_SPEED = 128;
+static unsigned long const MEASUREMENT_MS = 1000;
+// expected result, estimated by counting the instruction cycles of the isrs: the two timer 2 isrs of SOFTWARE_PWM take about 65 cycles
+// per pwm period of 8192 cycles (prescaler 32), i.e. roughly 0.8 % cpu load, HARDWARE_PWM adds no isr at all
+
+void setup() {
+  Serial.begin(115200);
+
+  // reference without any pwm generation
+  unsigned long const reference = count_loops();
+
+  LXR_highpower_motorshield::begin(SOFTWARE_PWM);
+  LXR_highpower_motorshield::set_direction(FWD);
+  LXR_highpower_motorshield::set_speed(TEST_SPEED);
+  unsigned long const software_pwm = count_loops();
+
+  LXR_highpower_motorshield::begin(HARDWARE_PWM);
+  LXR_highpower_motorshield::set_direction(FWD);
+  LXR_highpower_motorshield::set_speed(TEST_SPEED);
+  unsigned long const hardware_pwm = count_loops();
+
+  LXR_highpower_motorshield::set_speed(0);
+
+  print_result("reference   ", reference, reference);
+  print_result("SOFTWARE_PWM", software_pwm, reference);
+  print_result("HARDWARE_PWM", hardware_pwm, reference);
+}
+
+void loop() {
+}
+
+/**
+ * @brief counts the iterations of an empty loop within MEASUREMENT_MS, every cycle spent in an isr is missing here
+ */
+unsigned long count_loops() {
+  Serial.flush();
+  volatile unsigned long cnt = 0;
+  unsigned long const start = millis();
+  while(millis() - start < MEASUREMENT_MS) cnt++;
+  return cnt;
+}
+
+/**
+ * @brief prints the loop count and the cpu load compared to the reference
+ */
+void print_result(char const *name, unsigned long const cnt, unsigned long const reference) {
+  char buf[64];
+  // load in 0.01 % steps, a run which counted more loops than the reference due to measurement noise has no load
+  unsigned long const load = (cnt < reference) ? ((reference - cnt) * 10000UL) / reference : 0;
+  int const len = sprintf(buf, "%s loops = %lu, cpu load = %lu.%02lu %%\n", name, cnt, load / 100, load % 100);
+  Serial.write((uint8_t*)(buf), len);
+}
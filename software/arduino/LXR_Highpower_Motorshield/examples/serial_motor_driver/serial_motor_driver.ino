@@ -10,74 +10,518 @@
 /* PROTOCOL DESIGN */
 /* PC -> ARDUINO
    1 Byte ID
-   1 Byte DIRECTION
-   1 Byte SPEED
+   1 Byte DIRECTION (or MOTOR_CMD_TELEMETRY)
+   1 Byte SPEED (telemetry period in ms for MOTOR_CMD_TELEMETRY, 0 = off)
    1 BYTE CHECKSUM = ID xor DIRETCTION xor SPEED
  */
+/* PC -> ARDUINO (trajectory upload, 0 points only query the free space of the trajectory buffer)
+   1 Byte ID
+   1 Byte MOTOR_CMD_TRAJECTORY
+   1 Byte NUMBER OF POINTS (0 to TRAJECTORY_MAX_POINTS_PER_MSG)
+   1 Byte CHECKSUM = ID xor MOTOR_CMD_TRAJECTORY xor NUMBER OF POINTS
+   per point:
+     2 Byte TIME OFFSET in ms to the previous point (little endian)
+     1 Byte DIRECTION
+     1 Byte SPEED
+   1 Byte CHECKSUM = xor of all point bytes
+ */
 /* ARDUINO -> PC
    1 Byte ID
    1 Byte STATUS
    1 Byte CHECKSUM = ID xor STATUS
  */
+/* ARDUINO -> PC (reply to a trajectory upload)
+   1 Byte ID
+   1 Byte STATUS_TRAJECTORY
+   1 Byte NUMBER OF ACCEPTED POINTS, the remaining ones did not fit into the buffer and have to be sent again
+   1 Byte NUMBER OF FREE POINTS in the trajectory buffer
+   1 Byte CHECKSUM = xor of all previous bytes
+ */
+/* ARDUINO -> PC (telemetry, sent every telemetry period)
+   1 Byte ID
+   1 Byte STATUS_TELEMETRY
+   2 Byte TIMESTAMP in ms (little endian)
+   2 Byte CURRENT HALF BRIDGE 1 (little endian)
+   2 Byte CURRENT HALF BRIDGE 2 (little endian)
+   1 Byte SPEED
+   1 Byte DIRECTION
+   1 Byte CHECKSUM = xor of all previous bytes
+ */
+/* PC -> ARDUINO (protocol handshake, not supported with SERIAL_MOTOR_DRIVER_MULTI_DROP)
+   1 Byte ID
+   1 Byte MOTOR_CMD_PROTOCOL
+   1 Byte PROTOCOL VERSION, takes effect after the reply
+   1 Byte CHECKSUM = ID xor MOTOR_CMD_PROTOCOL xor PROTOCOL VERSION
+ */
+/* PC -> ARDUINO (protocol version 2 only)
+   1 Byte ID
+   1 Byte MOTOR_CMD_BAUD_RATE
+   1 Byte BAUD RATE INDEX (0 = 115200, 1 = 500000, 2 = 1000000), takes effect after the reply
+   1 Byte CHECKSUM = ID xor MOTOR_CMD_BAUD_RATE xor BAUD RATE INDEX
+ */
+/* PROTOCOL VERSION 2
+   every message and reply above is sent as one frame, which is resynchronized at its delimiter:
+   COBS encoding of (1 Byte SEQUENCE NUMBER, the message including its checksums, 1 Byte CRC-8 of the previous bytes)
+   1 Byte 0x00 DELIMITER
+   a reply carries the sequence number of its request, telemetry the one of the latest request
+   a corrupted frame is answered with STATUS_ERROR, a repeated sequence number with the previous reply without processing the message again
+   without a valid frame for SERIAL_TIMEOUT_MS the arduino returns to protocol version 1 at 115200 baud
+ */
 
 /* DEFINE SECTION */
 
 #define SERIAL_MOTOR_DRIVER_ID      (128)
+// set to 1 when several drivers with different ids share one serial line, frames with a valid checksum but a foreign id are then ignored silently
+#define SERIAL_MOTOR_DRIVER_MULTI_DROP (0)
 #define SERIAL_TIMEOUT_MS           (250)
 #define MOTOR_DIR_BACKWARD          (0)
 #define MOTOR_DIR_FORWARD           (1)
+#define MOTOR_CMD_TELEMETRY         (2)
+#define MOTOR_CMD_TRAJECTORY        (3)
+#define MOTOR_CMD_PROTOCOL          (4)
+#define MOTOR_CMD_BAUD_RATE         (5)
 #define STATUS_ERROR                (0)
 #define STATUS_OK                   (1)
+#define STATUS_TELEMETRY            (2)
+#define STATUS_TRAJECTORY           (3)
+// a telemetry frame takes ~1 ms at 115200 baud, shorter periods would starve the replies
+#define TELEMETRY_MIN_PERIOD_MS     (5)
+// the points are executed from a ring buffer, has to be a power of 2 - 4 bytes of ram per point
+#define TRAJECTORY_BUFFER_SIZE      (32)
+// an upload has to fit into the 64 byte receive buffer of the serial port
+#define TRAJECTORY_MAX_POINTS_PER_MSG (8)
+#define PROTOCOL_VERSION_1          (1)
+#define PROTOCOL_VERSION_2          (2)
+#define FRAME_DELIMITER             (0)
+// CRC-8 polynomial x^8 + x^2 + x + 1
+#define CRC8_POLYNOMIAL             (0x07)
 
 /* CONSTANT SECTION */
 static int const recv_msg_size = 4;
 static int const reply_msg_size = 3;
+static int const telemetry_msg_size = 11;
+static int const trajectory_point_size = 4;
+static int const trajectory_reply_msg_size = 5;
+static uint8_t const trajectory_mask = TRAJECTORY_BUFFER_SIZE - 1;
+static int const max_recv_msg_size = recv_msg_size + TRAJECTORY_MAX_POINTS_PER_MSG * trajectory_point_size + 1;
+// sequence number and crc, the cobs encoding adds one byte for frames of up to 254 bytes
+static int const frame_overhead = 3;
+static unsigned long const baud_rates[] = {115200, 500000, 1000000};
+
+/* TYPEDEF SECTION */
+typedef struct {
+  uint16_t time_offset_ms; // to the previous point, to the reception for the first point of an empty buffer
+  uint8_t direction;
+  uint8_t speed;
+} s_trajectory_point;
+
+/* GLOBAL VARIABLE SECTION */
+#if SERIAL_MOTOR_DRIVER_MULTI_DROP
+static unsigned long last_own_msg_ms = 0;
+#endif
+static unsigned long last_rx_ms = 0;
+static int last_rx_available = 0;
+static uint8_t telemetry_period_ms = 0;
+static unsigned long last_telemetry_ms = 0;
+static s_trajectory_point trajectory[TRAJECTORY_BUFFER_SIZE];
+static uint8_t trajectory_head = 0; // next point to execute
+static uint8_t trajectory_count = 0;
+static unsigned long trajectory_due_ms = 0; // execution time of the point at the head
+// the header of an upload has been received, its points are still outstanding
+static uint8_t pending_trajectory_points = 0;
+static boolean is_pending_trajectory_foreign = false;
+static uint8_t protocol_version = PROTOCOL_VERSION_1;
+static uint8_t frame_buffer[max_recv_msg_size + frame_overhead];
+static int frame_length = 0;
+static uint8_t rx_seq = 0; // sequence number of the latest request
+static uint8_t last_reply_frame[trajectory_reply_msg_size + frame_overhead + 1];
+static int last_reply_frame_size = 0;
+static boolean is_last_reply_valid = false;
 
 /* CODE SECTION */
 
 void setup() {
   LXR_highpower_motorshield::begin();
+  LXR_highpower_motorshield::begin_current_sampling();
   LXR_highpower_motorshield::set_direction(FWD);
   Serial.begin(115200);
   Serial.setTimeout(SERIAL_TIMEOUT_MS);
 }
 
 void loop() {
-  uint8_t msg_buffer[recv_msg_size];
-  uint8_t return_msg[reply_msg_size];
+  unsigned long const now = millis();
+  if(protocol_version == PROTOCOL_VERSION_2) {
+    receive_frames(now);
+  } else {
+    receive_messages(now);
+  }
 
-  int const bytes_received = Serial.readBytes((char *)(msg_buffer), recv_msg_size);
-  boolean const msg_received = (bytes_received == recv_msg_size);
+  execute_trajectory(millis());
 
+  if(telemetry_period_ms > 0 && (now - last_telemetry_ms) >= telemetry_period_ms) {
+    // keep a fixed rate, but do not try to catch up after a stall
+    last_telemetry_ms += telemetry_period_ms;
+    if((now - last_telemetry_ms) >= telemetry_period_ms) last_telemetry_ms = now;
+    send_telemetry(now);
+  }
+}
+
+/**
+ * @brief receives the messages of protocol version 1, which are aligned by their sizes only
+ */
+void receive_messages(unsigned long const now) {
+  int const available = Serial.available();
+  if(available != last_rx_available) {
+    last_rx_ms = now;
+    last_rx_available = available;
+  }
+
+  // the points of a trajectory upload follow its header
+  int const expected_size = (pending_trajectory_points > 0) ? (pending_trajectory_points * trajectory_point_size + 1) : recv_msg_size;
+  if(available >= expected_size) {
+    uint8_t msg_buffer[TRAJECTORY_MAX_POINTS_PER_MSG * trajectory_point_size + 1];
+    Serial.readBytes((char *)(msg_buffer), expected_size);
+    last_rx_available = Serial.available();
+    boolean const is_msg_good = (pending_trajectory_points > 0) ? process_trajectory_points(msg_buffer) : process_message(msg_buffer);
+    if(!is_msg_good) {
+      // emergency stop - the connection might is apparently disabled
+      emergency_stop();
+    }
+  } else if(now - last_rx_ms > SERIAL_TIMEOUT_MS) {
+    // no complete message within the timeout - drop a partial message to resynchronize
+    while(Serial.available() > 0) Serial.read();
+    last_rx_available = 0;
+    last_rx_ms = now;
+    pending_trajectory_points = 0;
+    // emergency stop - the connection might is apparently disabled
+    emergency_stop();
+  }
+}
+
+/**
+ * @brief collects the bytes of protocol version 2 frames and processes every complete frame
+ */
+void receive_frames(unsigned long const now) {
+  while(Serial.available() > 0) {
+    uint8_t const c = Serial.read();
+    if(c != FRAME_DELIMITER) {
+      // the bytes of an overlong frame are counted but dropped, the frame is rejected at its delimiter
+      if(frame_length < (int)(sizeof(frame_buffer))) frame_buffer[frame_length] = c;
+      if(frame_length <= (int)(sizeof(frame_buffer))) frame_length++;
+    } else if(frame_length > 0) {
+      process_frame(frame_length);
+      frame_length = 0;
+    }
+  }
+
+  // last_rx_ms is taken after now when a frame has just been processed
+  if((long)(now - last_rx_ms) > SERIAL_TIMEOUT_MS) {
+    // no valid frame within the timeout - return to the defaults, so that the pc can connect again with a handshake
+    Serial.flush();
+    Serial.begin(baud_rates[0]);
+    start_protocol(PROTOCOL_VERSION_1);
+    // emergency stop - the connection might is apparently disabled
+    emergency_stop();
+  }
+}
+
+/**
+ * @brief decodes and checks a frame of protocol version 2 and processes the message it carries
+ */
+void process_frame(int const length) {
+  int const payload_size = (length <= (int)(sizeof(frame_buffer))) ? cobs_decode(frame_buffer, length) : 0;
+  uint8_t const *msg_buffer = frame_buffer + 1;
+  int const msg_size = payload_size - 2;
+  boolean is_frame_valid = (msg_size >= recv_msg_size) && (crc8(frame_buffer, payload_size - 1) == frame_buffer[payload_size - 1]);
+  if(is_frame_valid) {
+    // the points of an upload are part of its frame
+    boolean const is_upload = (msg_buffer[1] == MOTOR_CMD_TRAJECTORY) && (msg_buffer[2] > 0);
+    is_frame_valid = msg_size == (is_upload ? (recv_msg_size + msg_buffer[2] * trajectory_point_size + 1) : recv_msg_size);
+  }
+  if(!is_frame_valid) {
+    // the motor keeps running, the next frame is received correctly again - the reply is not kept for a repetition
+    uint8_t const return_msg[reply_msg_size] = {SERIAL_MOTOR_DRIVER_ID, STATUS_ERROR, SERIAL_MOTOR_DRIVER_ID ^ STATUS_ERROR};
+    uint8_t frame[reply_msg_size + frame_overhead + 1];
+    Serial.write(frame, encode_frame(return_msg, reply_msg_size, frame));
+    return;
+  }
+
+  last_rx_ms = millis();
+  if(is_last_reply_valid && frame_buffer[0] == rx_seq) {
+    // the pc repeats a request whose reply got lost, it must not be applied twice
+    Serial.write(last_reply_frame, last_reply_frame_size);
+    return;
+  }
+  rx_seq = frame_buffer[0];
+  is_last_reply_valid = true;
+
+  boolean is_msg_good = process_message(msg_buffer);
+  if(is_msg_good && pending_trajectory_points > 0) is_msg_good = process_trajectory_points(msg_buffer + recv_msg_size);
+  if(!is_msg_good) {
+    // emergency stop - the connection might is apparently disabled
+    emergency_stop();
+  }
+}
+
+/**
+ * @brief switches the protocol version, the state of the previous version is dropped
+ */
+void start_protocol(uint8_t const version) {
+  protocol_version = version;
+  frame_length = 0;
+  is_last_reply_valid = false;
+  pending_trajectory_points = 0;
+  last_rx_ms = millis();
+  last_rx_available = Serial.available();
+}
+
+/**
+ * @brief evaluates a received message, applies it and sends the reply
+ * @return false if the message was not valid
+ */
+boolean process_message(uint8_t const *msg_buffer) {
+  uint8_t return_msg[reply_msg_size];
   boolean is_msg_good = false;
   return_msg[0] = SERIAL_MOTOR_DRIVER_ID;
   return_msg[1] = STATUS_ERROR;
 
-  if(msg_received) {
-    // check if the message is valud
-    boolean is_id_correct = msg_buffer[0] == SERIAL_MOTOR_DRIVER_ID;
-    boolean is_dir_plausible = (msg_buffer[1] == MOTOR_DIR_BACKWARD) || (msg_buffer[1] == MOTOR_DIR_FORWARD);
-    boolean is_checksum_valid = (msg_buffer[0] ^ msg_buffer[1] ^  msg_buffer[2]) == msg_buffer[3];
-    if(is_id_correct && is_dir_plausible && is_checksum_valid) {
-      // in case of message being valid set direction and speed accordingly
-      if(msg_buffer[1] == MOTOR_DIR_FORWARD) {
-        LXR_highpower_motorshield::set_direction(FWD);
-      } else {
-        LXR_highpower_motorshield::set_direction(BWD);
-      }
-      LXR_highpower_motorshield::set_speed(msg_buffer[2]);      
-      is_msg_good = true;
-      return_msg[1] = STATUS_OK;
+  // check if the message is valud
+  boolean is_id_correct = msg_buffer[0] == SERIAL_MOTOR_DRIVER_ID;
+  boolean is_dir_plausible = (msg_buffer[1] == MOTOR_DIR_BACKWARD) || (msg_buffer[1] == MOTOR_DIR_FORWARD);
+  boolean is_telemetry_cmd = msg_buffer[1] == MOTOR_CMD_TELEMETRY;
+  boolean is_trajectory_cmd = (msg_buffer[1] == MOTOR_CMD_TRAJECTORY) && (msg_buffer[2] <= TRAJECTORY_MAX_POINTS_PER_MSG);
+  boolean is_protocol_cmd = (msg_buffer[1] == MOTOR_CMD_PROTOCOL) && (msg_buffer[2] == PROTOCOL_VERSION_1 || msg_buffer[2] == PROTOCOL_VERSION_2) && !SERIAL_MOTOR_DRIVER_MULTI_DROP;
+  boolean is_baud_rate_cmd = (msg_buffer[1] == MOTOR_CMD_BAUD_RATE) && (msg_buffer[2] < sizeof(baud_rates) / sizeof(baud_rates[0])) && (protocol_version == PROTOCOL_VERSION_2);
+  boolean is_checksum_valid = (msg_buffer[0] ^ msg_buffer[1] ^  msg_buffer[2]) == msg_buffer[3];
+#if SERIAL_MOTOR_DRIVER_MULTI_DROP
+  if(!is_id_correct && is_checksum_valid) {
+    // the points of an upload to another driver have to be skipped as well
+    if(is_trajectory_cmd && msg_buffer[2] > 0) {
+      pending_trajectory_points = msg_buffer[2];
+      is_pending_trajectory_foreign = true;
     }
-    // write return message
-    return_msg[2] = return_msg[0] ^ return_msg[1];
-    Serial.write(return_msg, reply_msg_size);
-  } 
-  
-  if(!msg_received || !is_msg_good) {
-    // emergency stop - the connection might is apparently disabled
-    LXR_highpower_motorshield::set_speed(0);
+    // the frame is addressed to another driver on the bus - only stop if our own frames have stopped arriving
+    return (millis() - last_own_msg_ms) <= SERIAL_TIMEOUT_MS;
   }
+  last_own_msg_ms = millis();
+#endif
+  if(is_id_correct && is_trajectory_cmd && is_checksum_valid) {
+    if(msg_buffer[2] == 0) {
+      send_trajectory_reply(0);
+    } else {
+      // the reply is sent once the points have been received
+      pending_trajectory_points = msg_buffer[2];
+      is_pending_trajectory_foreign = false;
+    }
+    return true;
+  }
+  if(is_id_correct && is_dir_plausible && is_checksum_valid) {
+    // a setpoint replaces a running trajectory
+    trajectory_count = 0;
+    // in case of message being valid set direction and speed accordingly
+    if(msg_buffer[1] == MOTOR_DIR_FORWARD) {
+      LXR_highpower_motorshield::set_direction(FWD);
+    } else {
+      LXR_highpower_motorshield::set_direction(BWD);
+    }
+    LXR_highpower_motorshield::set_speed(msg_buffer[2]);
+    is_msg_good = true;
+    return_msg[1] = STATUS_OK;
+  } else if(is_id_correct && is_telemetry_cmd && is_checksum_valid) {
+    // (re)configure the telemetry stream, the speed byte carries the period
+    telemetry_period_ms = msg_buffer[2];
+    if(telemetry_period_ms > 0 && telemetry_period_ms < TELEMETRY_MIN_PERIOD_MS) telemetry_period_ms = TELEMETRY_MIN_PERIOD_MS;
+    last_telemetry_ms = millis();
+    is_msg_good = true;
+    return_msg[1] = STATUS_OK;
+  } else if(is_id_correct && (is_protocol_cmd || is_baud_rate_cmd) && is_checksum_valid) {
+    is_msg_good = true;
+    return_msg[1] = STATUS_OK;
+  }
+  // write return message
+  return_msg[2] = return_msg[0] ^ return_msg[1];
+  send_frame(return_msg, reply_msg_size);
+
+  // a new protocol version or baud rate takes effect once the reply has been sent completely
+  if(is_msg_good && is_baud_rate_cmd) {
+    Serial.flush();
+    Serial.begin(baud_rates[msg_buffer[2]]);
+  }
+  if(is_msg_good && is_protocol_cmd) start_protocol(msg_buffer[2]);
+
+  return is_msg_good;
+}
+
+/**
+ * @brief appends the points of a trajectory upload to the trajectory buffer and sends the reply
+ * @return false if the points were not valid
+ */
+boolean process_trajectory_points(uint8_t const *msg_buffer) {
+  uint8_t const points = pending_trajectory_points;
+  pending_trajectory_points = 0;
+  if(is_pending_trajectory_foreign) return true;
+
+  uint8_t cs = 0;
+  for(int i = 0; i < points * trajectory_point_size; i++) cs ^= msg_buffer[i];
+  if(cs != msg_buffer[points * trajectory_point_size]) {
+    uint8_t return_msg[reply_msg_size] = {SERIAL_MOTOR_DRIVER_ID, STATUS_ERROR, SERIAL_MOTOR_DRIVER_ID ^ STATUS_ERROR};
+    send_frame(return_msg, reply_msg_size);
+    return false;
+  }
+
+  uint8_t accepted = 0;
+  for(; accepted < points && trajectory_count < TRAJECTORY_BUFFER_SIZE; accepted++) {
+    uint8_t const *point_buffer = msg_buffer + accepted * trajectory_point_size;
+    s_trajectory_point *point = &trajectory[(trajectory_head + trajectory_count) & trajectory_mask];
+    point->time_offset_ms = point_buffer[0] | (point_buffer[1] << 8);
+    point->direction = point_buffer[2];
+    point->speed = point_buffer[3];
+    // the offset of every further point is added when its predecessor is executed
+    if(trajectory_count == 0) trajectory_due_ms = millis() + point->time_offset_ms;
+    trajectory_count++;
+  }
+  send_trajectory_reply(accepted);
+  return true;
 }
 
+/**
+ * @brief replies to a trajectory upload with the number of accepted points and the free space of the trajectory buffer
+ */
+void send_trajectory_reply(uint8_t const accepted) {
+  uint8_t msg[trajectory_reply_msg_size];
+  msg[0] = SERIAL_MOTOR_DRIVER_ID;
+  msg[1] = STATUS_TRAJECTORY;
+  msg[2] = accepted;
+  msg[3] = TRAJECTORY_BUFFER_SIZE - trajectory_count;
+  msg[4] = msg[0] ^ msg[1] ^ msg[2] ^ msg[3];
+  send_frame(msg, trajectory_reply_msg_size);
+}
+
+/**
+ * @brief applies all points of the trajectory buffer which are due - the last setpoint is kept when the buffer runs empty
+ */
+void execute_trajectory(unsigned long const now) {
+  // the due times are accumulated from the offsets, so that a late point does not delay the following ones
+  while(trajectory_count > 0 && (long)(now - trajectory_due_ms) >= 0) {
+    s_trajectory_point const *point = &trajectory[trajectory_head];
+    LXR_highpower_motorshield::set_direction((point->direction == MOTOR_DIR_FORWARD) ? FWD : BWD);
+    LXR_highpower_motorshield::set_speed(point->speed);
+    trajectory_head = (trajectory_head + 1) & trajectory_mask;
+    trajectory_count--;
+    if(trajectory_count > 0) trajectory_due_ms += trajectory[trajectory_head].time_offset_ms;
+  }
+}
+
+/**
+ * @brief stops the motor and discards the trajectory
+ */
+void emergency_stop() {
+  trajectory_count = 0;
+  LXR_highpower_motorshield::set_speed(0);
+}
+
+/**
+ * @brief sends one packed binary telemetry sample
+ */
+void send_telemetry(unsigned long const now) {
+  uint16_t const current_1 = LXR_highpower_motorshield::get_current_half_brigde_1();
+  uint16_t const current_2 = LXR_highpower_motorshield::get_current_half_brigde_2();
 
+  uint8_t msg[telemetry_msg_size];
+  msg[0] = SERIAL_MOTOR_DRIVER_ID;
+  msg[1] = STATUS_TELEMETRY;
+  msg[2] = (uint8_t)(now);
+  msg[3] = (uint8_t)(now >> 8);
+  msg[4] = (uint8_t)(current_1);
+  msg[5] = (uint8_t)(current_1 >> 8);
+  msg[6] = (uint8_t)(current_2);
+  msg[7] = (uint8_t)(current_2 >> 8);
+  msg[8] = LXR_highpower_motorshield::get_speed();
+  msg[9] = (LXR_highpower_motorshield::get_direction() == FWD) ? MOTOR_DIR_FORWARD : MOTOR_DIR_BACKWARD;
+  msg[10] = 0;
+  for(int i = 0; i < telemetry_msg_size - 1; i++) msg[10] ^= msg[i];
+
+  send_frame(msg, telemetry_msg_size);
+}
+
+/**
+ * @brief sends a message, with protocol version 2 as a frame carrying the sequence number of the latest request
+ */
+void send_frame(uint8_t const *msg, int const size) {
+  if(protocol_version == PROTOCOL_VERSION_1) {
+    Serial.write(msg, size);
+    return;
+  }
+  uint8_t frame[telemetry_msg_size + frame_overhead + 1];
+  int const frame_size = encode_frame(msg, size, frame);
+  Serial.write(frame, frame_size);
+  // the reply is kept in case the pc repeats the request
+  if(msg[1] != STATUS_TELEMETRY) {
+    for(int i = 0; i < frame_size; i++) last_reply_frame[i] = frame[i];
+    last_reply_frame_size = frame_size;
+  }
+}
+
+/**
+ * @brief builds a frame of protocol version 2 with the sequence number of the latest request
+ * @return the size of the frame including its delimiter
+ */
+int encode_frame(uint8_t const *msg, int const size, uint8_t *frame) {
+  uint8_t payload[telemetry_msg_size + 2];
+  payload[0] = rx_seq;
+  for(int i = 0; i < size; i++) payload[i + 1] = msg[i];
+  payload[size + 1] = crc8(payload, size + 1);
+  return cobs_encode(payload, size + 2, frame);
+}
+
+/**
+ * @brief consistent overhead byte stuffing, the encoded data contains no zero and is followed by the delimiter
+ * @return the size of the encoded data including the delimiter
+ */
+int cobs_encode(uint8_t const *data, int const size, uint8_t *encoded) {
+  int code_index = 0;
+  int write_index = 1;
+  uint8_t code = 1;
+  for(int i = 0; i < size; i++) {
+    if(data[i] != 0) {
+      encoded[write_index++] = data[i];
+      code++;
+    }
+    if(data[i] == 0 || code == 0xFF) {
+      encoded[code_index] = code;
+      code = 1;
+      code_index = write_index++;
+    }
+  }
+  encoded[code_index] = code;
+  encoded[write_index++] = FRAME_DELIMITER;
+  return write_index;
+}
+
+/**
+ * @brief reverses the byte stuffing in place
+ * @return the size of the decoded data, 0 if the encoding is not valid
+ */
+int cobs_decode(uint8_t *data, int const size) {
+  int read_index = 0;
+  int write_index = 0;
+  while(read_index < size) {
+    uint8_t const code = data[read_index++];
+    if(code == 0 || read_index + code - 1 > size) return 0;
+    for(uint8_t i = 1; i < code; i++) data[write_index++] = data[read_index++];
+    if(code < 0xFF && read_index < size) data[write_index++] = 0;
+  }
+  return write_index;
+}
+
+/**
+ * @brief CRC-8 with the polynomial CRC8_POLYNOMIAL and an initial value of 0
+ */
+uint8_t crc8(uint8_t const *data, int const size) {
+  uint8_t crc = 0;
+  for(int i = 0; i < size; i++) {
+    crc ^= data[i];
+    for(uint8_t bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ CRC8_POLYNOMIAL) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
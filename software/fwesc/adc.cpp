@@ -7,6 +7,10 @@
 
 #include "adc.h"
 #include "motor.h"
+#include "torque.h"
+#include "profiler.h"
+#include "trace.h"
+#include "defines.h"
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
@@ -31,14 +35,18 @@ void read_is_2();
 /* GLOBAL VARIABLE SECTION */
 
 static volatile E_SELECTED_CURRENT_SENSOR m_selected_current_sensor = IS1;
+#if USE_TORQUE_CONTROL
+// timer 0 value at the start of the running conversion, it tells the torque control whether the sample has been taken during the on time of the pwm
+static volatile uint8_t m_sample_pwm_phase = 0;
+#endif
+#if EVENT_TRACE
+// only the changes of the overcurrent cutoff are traced
+static bool m_is_overcurrent = false;
+#endif
 
 /* GLOBAL CONSTANTS */
 
-// 46 A = 4,6 V
-// 1 A = 0.1 V
-// 1024 * 0.1 V / 5 V = 20.48 = 20
-static uint16_t const CURRENT_SENSE_1_A = 20;
-static uint16_t const CURRENT_SENSE_30_A = CURRENT_SENSE_1_A * 30;
+static uint16_t const CURRENT_SENSE_30_A = adc::CURRENT_SENSE_1_A * 30;
 
 /* FUNCTION SECTION */
 
@@ -70,11 +78,25 @@ void adc::init() {
  * @brief adc interrupt service routine
  */
 ISR(ADC_vect) {
+	PROFILE_ISR(PROFILED_ISR_ADC);
 	
-	if(ADC > CURRENT_SENSE_30_A) {
+	uint16_t const current = ADC;
+	if(current > CURRENT_SENSE_30_A) {
+#if EVENT_TRACE
+		if(!m_is_overcurrent) TRACE_EVENT(TRACE_OVERCURRENT, current);
+		m_is_overcurrent = true;
+#endif
 		motor::disable();
 	} else {
+#if EVENT_TRACE
+		if(m_is_overcurrent) TRACE_EVENT(TRACE_OVERCURRENT_CLEARED, current);
+		m_is_overcurrent = false;
+#endif
 		motor::enable();
+#if USE_TORQUE_CONTROL
+		// is2 belongs to half bridge 2 (IN2) whose high side conducts when driving forward
+		torque::update(m_selected_current_sensor == IS2, current, m_sample_pwm_phase);
+#endif
 	}
 		
 	if(m_selected_current_sensor == IS1) read_is_2();
@@ -90,6 +112,9 @@ void read_is_1() {
 	MUX_ADC_TO_IS1();
 	// start conversion
 	ADCSRA |= (1<<ADSC);
+#if USE_TORQUE_CONTROL
+	m_sample_pwm_phase = TCNT0;
+#endif
 }
 
 /** 
@@ -101,4 +126,7 @@ void read_is_2() {
 	MUX_ADC_TO_IS2();
 	// start conversion
 	ADCSRA |= (1<<ADSC);
+#if USE_TORQUE_CONTROL
+	m_sample_pwm_phase = TCNT0;
+#endif
 }
\ No newline at end of file
@@ -8,8 +8,15 @@
 #ifndef ADC_H_
 #define ADC_H_
 
+#include <stdint.h>
+
 class adc {
 public:
+	// 46 A = 4,6 V
+	// 1 A = 0.1 V
+	// 1024 * 0.1 V / 5 V = 20.48 = 20
+	static uint16_t const CURRENT_SENSE_1_A = 20;
+
 	/**
 	 * @brief initializes the adc module
 	 */
@@ -1,4 +1,4 @@
-﻿/**
+/**
 * @author Alexander Entinger, MSc / LXRobotics
 * @brief this moduls maps the receiver pulse width to an appropriate motor action
 * @file control.cpp
@@ -7,7 +7,8 @@
 
 #include "control.h"
 #include "motor.h"
-#include "linear_mapper.h"
+#include "torque.h"
+#include "fixed_point_linear_mapper.h"
 #include "defines.h"
 
 #include <avr/interrupt.h>
@@ -15,40 +16,133 @@
 
 /* GLOBAL CONSTANT SECTION */
 static uint8_t const DEADZONE = 20;
-static uint16_t const CH1_PULSE_WIDTH_MIN_US = 1120;
-static uint16_t const CH1_PULSE_WIDTH_MAX_US = 1910;
-static uint16_t const CH2_PULSE_WIDTH_MIN_US = 1120;
-static uint16_t const CH2_PULSE_WIDTH_MAX_US = 1910;
+// all pulse widths are in 1/2^PULSE_WIDTH_FRACTIONAL_BITS us
+static uint16_t const CH1_PULSE_WIDTH_MIN = PULSE_WIDTH(1120);
+static uint16_t const CH1_PULSE_WIDTH_MAX = PULSE_WIDTH(1910);
+static uint16_t const CH2_PULSE_WIDTH_MIN = PULSE_WIDTH(1120);
+static uint16_t const CH2_PULSE_WIDTH_MAX = PULSE_WIDTH(1910);
+// the lookup table covers all pulse widths accepted by the input module in steps of 4 us, pulse widths in between are interpolated
+static uint16_t const LOOKUP_TABLE_PULSE_WIDTH_MIN = PULSE_WIDTH(1000);
+static uint16_t const LOOKUP_TABLE_PULSE_WIDTH_MAX = PULSE_WIDTH(2000);
+static uint8_t const LOOKUP_TABLE_STEP_SHIFT = 2 + PULSE_WIDTH_FRACTIONAL_BITS;
+static uint8_t const LOOKUP_TABLE_STEP = (1 << LOOKUP_TABLE_STEP_SHIFT);
+static uint8_t const LOOKUP_TABLE_SIZE = (LOOKUP_TABLE_PULSE_WIDTH_MAX - LOOKUP_TABLE_PULSE_WIDTH_MIN) / LOOKUP_TABLE_STEP + 1;
+static int16_t const MOTOR_VALUE_MAX = 255;
+// the neutral point is the mean of the first CALIBRATION_PULSES pulses within CALIBRATION_WINDOW of the first pulse
+static uint8_t const CALIBRATION_PULSES = 8;
+static int16_t const CALIBRATION_WINDOW = PULSE_WIDTH(40);
+// once calibrated, pulses within NEUTRAL_TRACKING_WINDOW of the calibrated neutral point slowly pull the neutral point towards them (trim drift)
+// the window is fixed around the calibrated neutral point so that a slowly moving stick can not drag the neutral point away
+static int16_t const NEUTRAL_TRACKING_WINDOW = PULSE_WIDTH(16);
+static uint8_t const NEUTRAL_TRACKING_SHIFT = 7; // time constant of 128 frames, ~2.5 s
+static uint8_t const NEUTRAL_TRACKING_FRACTIONAL_BITS = 8;
+static int16_t const NEUTRAL_TRACKING_HYSTERESIS = PULSE_WIDTH(2);
+// number of lookup table entries rebuilt per execution of the control task
+static uint8_t const LOOKUP_TABLE_REBUILD_CHUNK = 64;
+#if CONTROL_LATENCY_HISTOGRAM
+// the latency is measured with timer 1 of the input module
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+static uint16_t const LATENCY_HISTOGRAM_BIN_TIMER_STEPS = CONTROL_LATENCY_HISTOGRAM_BIN_US * 2;
+#else
+static uint16_t const LATENCY_HISTOGRAM_BIN_TIMER_STEPS = CONTROL_LATENCY_HISTOGRAM_BIN_US / 4;
+#endif
+#endif
 
 /* TYPEDEF SECTION */
+// Q16 slope - the final shift of the mapping is a selection of the upper word
+typedef fixed_point_linear_mapper<16> pulse_width_mapper;
+
 typedef struct {
-	uint16_t pulse_width_us;
-	uint16_t neutral_pulse_width_us;
+	uint16_t pulse_width;
+	uint16_t neutral_pulse_width;
 	uint16_t deadzone;
-	bool is_updated;
+	uint8_t sequence; // sequence of the last input snapshot taken by the control task
+	bool is_valid; // false from the loss of the channels until the next pulse
+#if CONTROL_LATENCY_HISTOGRAM
+	uint16_t edge_timestamp; // timer 1 value at the last update
+#endif
 } s_channel;
 
+// the input of a channel is written by the isrs only, the control task takes snapshots of it without disabling the interrupts
+// the isrs do not nest, so an isr always completes its modification before the control task continues
+typedef struct {
+	uint16_t pulse_width;
+	uint8_t sequence; // incremented after every modification, a snapshot is consistent if the sequence has not changed while it was taken
+	bool is_discarded; // set when the channels have been lost, the last pulse must not be applied anymore
+#if CONTROL_LATENCY_HISTOGRAM
+	uint16_t edge_timestamp; // timer 1 value at the update
+#endif
+} s_channel_input;
+
 typedef struct {
 	bool calibration_complete;
 } s_control_data;
 
+typedef enum {REINIT_IDLE = 0, REINIT_LOWER_MAPPER = 1, REINIT_UPPER_MAPPER = 2, REINIT_LOOKUP_TABLE = 3} E_REINIT_STEP;
+
+typedef struct {
+	uint16_t seed_pulse_width; // center of the calibration window
+	uint16_t pulse_width_sum; // sum of the accepted pulses
+	uint8_t accepted_pulses;
+	uint8_t rejected_pulses;
+	bool is_calibrated;
+	uint16_t calibrated_neutral_pulse_width; // center of the drift tracking window
+	int32_t filtered_neutral; // neutral point with NEUTRAL_TRACKING_FRACTIONAL_BITS for the drift tracking
+	E_REINIT_STEP reinit_step; // the mapping is reinitialized one step per execution of the control task
+	uint8_t lookup_table_index; // next lookup table entry to be rebuilt
+} s_neutral_estimator;
+
+typedef struct {
+	uint8_t magnitude[LOOKUP_TABLE_SIZE]; // |motor speed value| for every pulse width step
+	uint16_t neutral_pulse_width; // steps below the neutral pulse width map to negative motor speed values
+} s_lookup_table;
+
 /* GLOBAL VARIABLE SECTION */
-static s_channel m_channel_1 = {1500, 1500, DEADZONE, false};
-static s_channel m_channel_2 = {1500, 1500, DEADZONE, false};
+static s_channel m_channel_1 = {PULSE_WIDTH(1500), PULSE_WIDTH(1500), DEADZONE, 0, false};
+static s_channel m_channel_2 = {PULSE_WIDTH(1500), PULSE_WIDTH(1500), DEADZONE, 0, false};
+static volatile s_channel_input m_channel_1_input = {PULSE_WIDTH(1500), 0, false};
+static volatile s_channel_input m_channel_2_input = {PULSE_WIDTH(1500), 0, false};
 static s_control_data m_control_data = {false};
+static s_neutral_estimator m_neutral_estimator_channel_1 = {0, 0, 0, 0, false, 0, 0, REINIT_IDLE, 0};
+static s_neutral_estimator m_neutral_estimator_channel_2 = {0, 0, 0, 0, false, 0, 0, REINIT_IDLE, 0};
+
+// the mappers map the channel input to motor speed values between -255 and +255
+static pulse_width_mapper m_mapper_1_channel_1(CH1_PULSE_WIDTH_MIN, m_channel_1.neutral_pulse_width, (-1)*MOTOR_VALUE_MAX, 0);
+static pulse_width_mapper m_mapper_2_channel_1(m_channel_1.neutral_pulse_width, CH1_PULSE_WIDTH_MAX, 0, MOTOR_VALUE_MAX);
+static pulse_width_mapper m_mapper_1_channel_2(CH2_PULSE_WIDTH_MIN, m_channel_2.neutral_pulse_width, (-1)*MOTOR_VALUE_MAX, 0);
+static pulse_width_mapper m_mapper_2_channel_2(m_channel_2.neutral_pulse_width, CH2_PULSE_WIDTH_MAX, 0, MOTOR_VALUE_MAX);
 
-// the mappers map the channel input to motor speed values
-static linear_mapper m_mapper_1_channel_1(CH1_PULSE_WIDTH_MIN_US, m_channel_1.neutral_pulse_width_us, (-1)*(1<<14), 0);
-static linear_mapper m_mapper_2_channel_1(m_channel_1.neutral_pulse_width_us, CH1_PULSE_WIDTH_MAX_US, 0, (1<<14));
-static linear_mapper m_mapper_1_channel_2(CH2_PULSE_WIDTH_MIN_US, m_channel_2.neutral_pulse_width_us, (-1)*(1<<14), 0);
-static linear_mapper m_mapper_2_channel_2(m_channel_2.neutral_pulse_width_us, CH2_PULSE_WIDTH_MAX_US, 0, (1<<14));
+#if USE_PULSE_WIDTH_LOOKUP_TABLE
+// the lookup tables replace the mappers in the control task once the calibration is complete
+static s_lookup_table m_lookup_table_channel_1;
+static s_lookup_table m_lookup_table_channel_2;
+#define LOOKUP_TABLE_CHANNEL_1 (&m_lookup_table_channel_1)
+#define LOOKUP_TABLE_CHANNEL_2 (&m_lookup_table_channel_2)
+#else
+#define LOOKUP_TABLE_CHANNEL_1 (0)
+#define LOOKUP_TABLE_CHANNEL_2 (0)
+#endif
+
+#if CONTROL_LATENCY_HISTOGRAM
+static uint16_t m_latency_histogram[CONTROL_LATENCY_HISTOGRAM_BINS] = {0};
+#endif
 
 /* PROTOTYPE SECTION */
 int16_t abs(int16_t const val);
-void calibrate();
-void sort(uint16_t *data, uint8_t const length);
-void swap(uint16_t *elem1, uint16_t *elem2);
-uint16_t median(uint16_t const *data, uint8_t const length);
+void take_snapshot(s_channel_input *ch1_snapshot, s_channel_input *ch2_snapshot);
+void copy_channel_input(s_channel_input volatile const *input, s_channel_input *snapshot);
+bool apply_snapshot(s_channel *channel, s_channel_input const *snapshot);
+bool is_channel_updated(s_channel const *channel, s_channel_input volatile const *input);
+void calibrate(bool const ch1_updated, bool const ch2_updated);
+void estimate_neutral(s_neutral_estimator *estimator, s_channel *channel);
+void track_neutral(s_neutral_estimator *estimator, s_channel *channel);
+void reinit_mapping(s_neutral_estimator *estimator, s_channel const *channel, uint16_t const pulse_width_min, uint16_t const pulse_width_max, pulse_width_mapper &lower_mapper, pulse_width_mapper &upper_mapper, s_lookup_table *table);
+void build_lookup_table(s_lookup_table *table, pulse_width_mapper const &lower_mapper, pulse_width_mapper const &upper_mapper, uint16_t const neutral_pulse_width, uint8_t const first_index, uint8_t const length);
+int16_t lookup_entry(s_lookup_table const *table, uint8_t const index);
+int16_t lookup(s_lookup_table const *table, uint16_t const pulse_width);
+#if CONTROL_LATENCY_HISTOGRAM
+void record_latency(s_channel const *channel, uint16_t const now);
+#endif
 
 
 /* FUNCTION SECTION */
@@ -56,59 +150,94 @@ uint16_t median(uint16_t const *data, uint8_t const length);
 /**
 * @brief updates channel 1 - only to be called within isr context
 */
-void control::update_channel_1(uint16_t const ch1_pulse_width_us) {
-	m_channel_1.pulse_width_us = ch1_pulse_width_us;
-	m_channel_1.is_updated = true;
+void control::update_channel_1(uint16_t const ch1_pulse_width) {
+	m_channel_1_input.pulse_width = ch1_pulse_width;
+	m_channel_1_input.is_discarded = false;
+#if CONTROL_LATENCY_HISTOGRAM
+	m_channel_1_input.edge_timestamp = TCNT1;
+#endif
+	// publish the update
+	m_channel_1_input.sequence++;
 }
 
 /**
 * @brief updates channel 2 - only to be called within isr context
 */
-void control::update_channel_2(uint16_t const ch2_pulse_width_us) {
-	m_channel_2.pulse_width_us = ch2_pulse_width_us;
-	m_channel_2.is_updated = true;
+void control::update_channel_2(uint16_t const ch2_pulse_width) {
+	m_channel_2_input.pulse_width = ch2_pulse_width;
+	m_channel_2_input.is_discarded = false;
+#if CONTROL_LATENCY_HISTOGRAM
+	m_channel_2_input.edge_timestamp = TCNT1;
+#endif
+	// publish the update
+	m_channel_2_input.sequence++;
 }
 
 /**
 * @brief this function is called by the input module to indicate that channels have been lost - only to be called within isr context
 */
 void control::channel_s_lost() {
-	motor::set_direction(BREAK);
-	motor::set_speed(0);
-	m_channel_1.is_updated = false;
-	m_channel_2.is_updated = false;
+	// no ramp for the failsafe, the motor is braked at once
+	torque::stop();
+	motor::stop();
+	// discard the pending updates
+	m_channel_1_input.is_discarded = true;
+	m_channel_1_input.sequence++;
+	m_channel_2_input.is_discarded = true;
+	m_channel_2_input.sequence++;
 }
 
 
 /**
-* @brief the control task itself - it is scheduled to be runnable after both channels have updated their data value
+* @brief the control task itself - it is scheduled to be runnable after both channels (or either channel with USE_INCREMENTAL_CONTROL_UPDATE) have updated their data value
 */
 void control::run() {
 	
+	// take a consistent snapshot of both channels, updates which arrive while the task is executed make it runnable again
+	s_channel_input ch1_snapshot, ch2_snapshot;
+	take_snapshot(&ch1_snapshot, &ch2_snapshot);
+	bool const ch1_updated = apply_snapshot(&m_channel_1, &ch1_snapshot);
+	bool const ch2_updated = apply_snapshot(&m_channel_2, &ch2_snapshot);
+	
 	if(m_control_data.calibration_complete) {
 		
-		// calibration is complete, perform the control
+		// calibration is complete, perform the control - a channel which has not been updated contributes its last value
+		
+		// the motor has been stopped by the loss of the channels, it stays stopped until both channels deliver pulses again
+		if(!m_channel_1.is_valid || !m_channel_2.is_valid) return;
+		
+		// follow a slowly drifting neutral point and continue a pending reinitialization of the mapping
+		if(ch1_updated) track_neutral(&m_neutral_estimator_channel_1, &m_channel_1);
+		if(ch2_updated) track_neutral(&m_neutral_estimator_channel_2, &m_channel_2);
+		reinit_mapping(&m_neutral_estimator_channel_1, &m_channel_1, CH1_PULSE_WIDTH_MIN, CH1_PULSE_WIDTH_MAX, m_mapper_1_channel_1, m_mapper_2_channel_1, LOOKUP_TABLE_CHANNEL_1);
+		reinit_mapping(&m_neutral_estimator_channel_2, &m_channel_2, CH2_PULSE_WIDTH_MIN, CH2_PULSE_WIDTH_MAX, m_mapper_1_channel_2, m_mapper_2_channel_2, LOOKUP_TABLE_CHANNEL_2);
 		
 		// ch1 is forward/backward
 		// ch2 is left/right
 		
 		int16_t ch1_motor_value = 0, ch2_motor_value = 0;
 		
-		// perform the mapping and correct the result by shifting 6 right -> resulting area is between -255 and +255
-		if(m_channel_1.pulse_width_us < m_channel_1.neutral_pulse_width_us) {
-			ch1_motor_value = (m_mapper_1_channel_1.map((int16_t)(m_channel_1.pulse_width_us)) / (1<<6));
-		} else if(m_channel_1.pulse_width_us > m_channel_1.neutral_pulse_width_us) {
-			ch1_motor_value = (m_mapper_2_channel_1.map((int16_t)(m_channel_1.pulse_width_us)) / (1<<6));
+#if USE_PULSE_WIDTH_LOOKUP_TABLE
+		// at most two table accesses per channel - resulting area is between -255 and +255
+		ch1_motor_value = lookup(&m_lookup_table_channel_1, m_channel_1.pulse_width);
+		ch2_motor_value = lookup(&m_lookup_table_channel_2, m_channel_2.pulse_width);
+#else
+		// perform the mapping -> resulting area is between -255 and +255
+		if(m_channel_1.pulse_width < m_channel_1.neutral_pulse_width) {
+			ch1_motor_value = m_mapper_1_channel_1.map((int16_t)(m_channel_1.pulse_width));
+		} else if(m_channel_1.pulse_width > m_channel_1.neutral_pulse_width) {
+			ch1_motor_value = m_mapper_2_channel_1.map((int16_t)(m_channel_1.pulse_width));
 		} else {
 			ch1_motor_value = 0;
 		}
-		if(m_channel_2.pulse_width_us < m_channel_2.neutral_pulse_width_us) {
-			ch2_motor_value = (m_mapper_1_channel_2.map((int16_t)(m_channel_2.pulse_width_us)) / (1<<6));
-		} else if(m_channel_2.pulse_width_us > m_channel_2.neutral_pulse_width_us) {
-			ch2_motor_value = (m_mapper_2_channel_2.map((int16_t)(m_channel_2.pulse_width_us)) / (1<<6));
+		if(m_channel_2.pulse_width < m_channel_2.neutral_pulse_width) {
+			ch2_motor_value = m_mapper_1_channel_2.map((int16_t)(m_channel_2.pulse_width));
+		} else if(m_channel_2.pulse_width > m_channel_2.neutral_pulse_width) {
+			ch2_motor_value = m_mapper_2_channel_2.map((int16_t)(m_channel_2.pulse_width));
 		} else {
 			ch2_motor_value = 0;
 		}
+#endif
 		
 		// simple delta mixing
 #ifdef RIGHT_MOTOR
@@ -122,46 +251,51 @@ void control::run() {
 		if(ch1_motor_value > 255) ch1_motor_value = 255;
 		if(ch1_motor_value < -255) ch1_motor_value = -255;
 		
-		if(ch1_motor_value >= 0) {
-			if((uint16_t)(ch1_motor_value) > m_channel_1.deadzone) {
-				motor::set_speed((uint8_t)(ch1_motor_value));
-				motor::set_direction(FORWARD);
-			} else {
-				motor::set_speed(0);
-				motor::set_direction(BREAK);
-			}
-		} else {
-			ch1_motor_value = abs(ch1_motor_value);
-			if((uint16_t)(ch1_motor_value) > m_channel_1.deadzone) {
-				motor::set_speed((uint8_t)(ch1_motor_value));
-				motor::set_direction(BACKWARD);
-			} else {
-				motor::set_speed(0);
-				motor::set_direction(BREAK);
-			}
-		}
+		if((uint16_t)(abs(ch1_motor_value)) <= m_channel_1.deadzone) ch1_motor_value = 0;
+		
+		// the torque module sets the duty cycle (open loop) or the motor current (USE_TORQUE_CONTROL)
+		torque::set_throttle(ch1_motor_value);
+		
+#if CONTROL_LATENCY_HISTOGRAM
+		uint16_t const now = TCNT1;
+		if(ch1_updated) record_latency(&m_channel_1, now);
+		if(ch2_updated) record_latency(&m_channel_2, now);
+#endif
 	} else {
 		// do the calibration
-		calibrate();
+		calibrate(ch1_updated, ch2_updated);
 	}
-
-	// task has been executed, clear the runnable flags
-	cli();
-	m_channel_1.is_updated = false;
-	m_channel_2.is_updated = false;
-	sei();
 }
 
 /**
 * @brief returns true if the control task is runnable in the main thread
 */
 bool control::is_runnable() {
-	cli();
-	bool const runnable = (m_channel_1.is_updated && m_channel_2.is_updated);
-	sei();
+	// the sequences are single bytes which are read atomically
+#if USE_INCREMENTAL_CONTROL_UPDATE
+	bool const runnable = is_channel_updated(&m_channel_1, &m_channel_1_input) || is_channel_updated(&m_channel_2, &m_channel_2_input);
+#else
+	bool const runnable = is_channel_updated(&m_channel_1, &m_channel_1_input) && is_channel_updated(&m_channel_2, &m_channel_2_input);
+#endif
 	return runnable;
 }
 
+#if CONTROL_LATENCY_HISTOGRAM
+/**
+* @brief returns the number of channel updates whose edge to pwm latency was within [bin, bin + 1) * CONTROL_LATENCY_HISTOGRAM_BIN_US
+*/
+uint16_t control::get_latency_histogram(uint8_t const bin) {
+	return (bin < CONTROL_LATENCY_HISTOGRAM_BINS) ? m_latency_histogram[bin] : 0;
+}
+
+/**
+* @brief clears the edge to pwm latency histogram
+*/
+void control::clear_latency_histogram() {
+	uint8_t bin=0; for(; bin<CONTROL_LATENCY_HISTOGRAM_BINS; bin++) m_latency_histogram[bin] = 0;
+}
+#endif
+
 /**
 * @brief returns |val|
 */
@@ -171,65 +305,200 @@ int16_t abs(int16_t const val) {
 	return res;
 }
 
+/** 
+ * @brief copies the input of both channels - the copy is repeated until no isr has modified an input during the copy
+ */
+void take_snapshot(s_channel_input *ch1_snapshot, s_channel_input *ch2_snapshot) {
+	do {
+		copy_channel_input(&m_channel_1_input, ch1_snapshot);
+		copy_channel_input(&m_channel_2_input, ch2_snapshot);
+	} while((ch1_snapshot->sequence != m_channel_1_input.sequence) || (ch2_snapshot->sequence != m_channel_2_input.sequence));
+}
+
+/** 
+ * @brief copies the input of a channel, the sequence is read first
+ */
+void copy_channel_input(s_channel_input volatile const *input, s_channel_input *snapshot) {
+	snapshot->sequence = input->sequence;
+	snapshot->pulse_width = input->pulse_width;
+	snapshot->is_discarded = input->is_discarded;
+#if CONTROL_LATENCY_HISTOGRAM
+	snapshot->edge_timestamp = input->edge_timestamp;
+#endif
+}
+
+/** 
+ * @brief takes over the pulse of a snapshot if it is new and has not been discarded
+ * @return true if the channel has been updated
+ */
+bool apply_snapshot(s_channel *channel, s_channel_input const *snapshot) {
+	bool const is_updated = (snapshot->sequence != channel->sequence) && !snapshot->is_discarded;
+	channel->sequence = snapshot->sequence;
+	if(snapshot->is_discarded) channel->is_valid = false;
+	if(is_updated) {
+		channel->is_valid = true;
+		channel->pulse_width = snapshot->pulse_width;
+#if CONTROL_LATENCY_HISTOGRAM
+		channel->edge_timestamp = snapshot->edge_timestamp;
+#endif
+	}
+	return is_updated;
+}
+
+/** 
+ * @brief returns true if the input of the channel holds a pulse which has not been taken by the control task yet
+ */
+bool is_channel_updated(s_channel const *channel, s_channel_input volatile const *input) {
+	return (input->sequence != channel->sequence) && !input->is_discarded;
+}
+
 /** 
  * @brief performs the calibration
  */
-void calibrate() {
-	// here we store the first 16 values of both channels in an array, drop the 2 highest and the 2 lowest values and get the average
-	uint8_t const MAX_RECEIVED_PULSES = 16;
-	static uint8_t received_pulses_cnt = 0;
-	static uint16_t ch1[16] = {0};
-	static uint16_t ch2[16] = {0};
-	// insert received values into the channel arrays
-	ch1[received_pulses_cnt] = m_channel_1.pulse_width_us;
-	ch2[received_pulses_cnt] = m_channel_2.pulse_width_us;
-	// update the cnt
-	received_pulses_cnt++;
-	if(received_pulses_cnt >= MAX_RECEIVED_PULSES) {
-		// sort
-		sort(ch1, MAX_RECEIVED_PULSES);
-		sort(ch2, MAX_RECEIVED_PULSES);
-		// drop the two lowest and highest values and average
-		m_channel_1.neutral_pulse_width_us = median(ch1 + 2, MAX_RECEIVED_PULSES - 4);
-		m_channel_2.neutral_pulse_width_us = median(ch2 + 2, MAX_RECEIVED_PULSES - 4);
-		// recalibrate the linear mappers
-		m_mapper_1_channel_1.init(CH1_PULSE_WIDTH_MIN_US, m_channel_1.neutral_pulse_width_us, (-1)*(1<<14), 0);
-		m_mapper_2_channel_1.init(m_channel_1.neutral_pulse_width_us, CH1_PULSE_WIDTH_MAX_US, 0, (1<<14));
-		m_mapper_1_channel_2.init(CH2_PULSE_WIDTH_MIN_US, m_channel_2.neutral_pulse_width_us, (-1)*(1<<14), 0);
-		m_mapper_2_channel_2.init(m_channel_2.neutral_pulse_width_us, CH2_PULSE_WIDTH_MAX_US, 0, (1<<14));
+void calibrate(bool const ch1_updated, bool const ch2_updated) {
+	// estimate the neutral points of both channels from their fresh pulses, each one reinitializes its mapping as soon as it is known
+	if(ch1_updated && !m_neutral_estimator_channel_1.is_calibrated) estimate_neutral(&m_neutral_estimator_channel_1, &m_channel_1);
+	if(ch2_updated && !m_neutral_estimator_channel_2.is_calibrated) estimate_neutral(&m_neutral_estimator_channel_2, &m_channel_2);
+	reinit_mapping(&m_neutral_estimator_channel_1, &m_channel_1, CH1_PULSE_WIDTH_MIN, CH1_PULSE_WIDTH_MAX, m_mapper_1_channel_1, m_mapper_2_channel_1, LOOKUP_TABLE_CHANNEL_1);
+	reinit_mapping(&m_neutral_estimator_channel_2, &m_channel_2, CH2_PULSE_WIDTH_MIN, CH2_PULSE_WIDTH_MAX, m_mapper_1_channel_2, m_mapper_2_channel_2, LOOKUP_TABLE_CHANNEL_2);
+	// the control starts once both neutral points are known and the mapping is complete
+	bool const is_channel_1_ready = m_neutral_estimator_channel_1.is_calibrated && (m_neutral_estimator_channel_1.reinit_step == REINIT_IDLE);
+	bool const is_channel_2_ready = m_neutral_estimator_channel_2.is_calibrated && (m_neutral_estimator_channel_2.reinit_step == REINIT_IDLE);
+	if(is_channel_1_ready && is_channel_2_ready) {
 		// update the calibration complete flag
 		m_control_data.calibration_complete = true;
 	}
 }
 
 /** 
- * @brief sorts the array ascending
+ * @brief streaming estimation of the neutral point - O(1) per pulse, pulses outside of the window around the first pulse are rejected as glitches
  */
-void sort(uint16_t *data, uint8_t const length) {
-	bool elements_swapped = false;
-	do {
-		elements_swapped = false;
-		uint8_t i=1; for(; i<length; i++) {
-			if(data[i-1] > data[i]) {
-				swap(&data[i-1], &data[i]);
-				elements_swapped = true;
-			}
-		}		
-	} while(elements_swapped);
+void estimate_neutral(s_neutral_estimator *estimator, s_channel *channel) {
+	uint16_t const pulse_width = channel->pulse_width;
+	if(estimator->accepted_pulses == 0) {
+		// the first pulse seeds the calibration window
+		estimator->seed_pulse_width = pulse_width;
+		estimator->pulse_width_sum = pulse_width;
+		estimator->accepted_pulses = 1;
+		estimator->rejected_pulses = 0;
+	} else if(abs((int16_t)(pulse_width - estimator->seed_pulse_width)) <= CALIBRATION_WINDOW) {
+		estimator->pulse_width_sum += pulse_width;
+		estimator->accepted_pulses++;
+	} else {
+		estimator->rejected_pulses++;
+		// the seed itself was most likely the glitch - start over with the current pulse
+		if(estimator->rejected_pulses >= estimator->accepted_pulses) {
+			estimator->seed_pulse_width = pulse_width;
+			estimator->pulse_width_sum = pulse_width;
+			estimator->accepted_pulses = 1;
+			estimator->rejected_pulses = 0;
+		}
+	}
+	if(estimator->accepted_pulses >= CALIBRATION_PULSES) {
+		uint16_t const neutral_pulse_width = (estimator->pulse_width_sum + CALIBRATION_PULSES / 2) / CALIBRATION_PULSES;
+		channel->neutral_pulse_width = neutral_pulse_width;
+		estimator->calibrated_neutral_pulse_width = neutral_pulse_width;
+		estimator->filtered_neutral = (int32_t)(neutral_pulse_width) << NEUTRAL_TRACKING_FRACTIONAL_BITS;
+		estimator->is_calibrated = true;
+		estimator->reinit_step = REINIT_LOWER_MAPPER;
+	}
 }
 
 /** 
- * @brief swaps to elements - required for sort
+ * @brief follows a slow drift of the neutral point (e.g. transmitter trim) while the stick is near neutral
  */
-void swap(uint16_t *elem1, uint16_t *elem2) {
-	uint16_t const tmp = *elem1;
-	*elem1 = *elem2;
-	*elem2 = tmp;
+void track_neutral(s_neutral_estimator *estimator, s_channel *channel) {
+	int16_t const offset = (int16_t)(channel->pulse_width - estimator->calibrated_neutral_pulse_width);
+	if(abs(offset) > NEUTRAL_TRACKING_WINDOW) return;
+	// exponential moving average with fractional bits, so that single steps of the input timer accumulate
+	int32_t const pulse_width = (int32_t)(channel->pulse_width) << NEUTRAL_TRACKING_FRACTIONAL_BITS;
+	estimator->filtered_neutral += (pulse_width - estimator->filtered_neutral) >> NEUTRAL_TRACKING_SHIFT;
+	uint16_t const neutral_pulse_width = (uint16_t)((estimator->filtered_neutral + (1 << (NEUTRAL_TRACKING_FRACTIONAL_BITS - 1))) >> NEUTRAL_TRACKING_FRACTIONAL_BITS);
+	// the hysteresis keeps the mapping from being reinitialized all the time
+	if(abs((int16_t)(neutral_pulse_width - channel->neutral_pulse_width)) >= NEUTRAL_TRACKING_HYSTERESIS) {
+		channel->neutral_pulse_width = neutral_pulse_width;
+		estimator->reinit_step = REINIT_LOWER_MAPPER;
+	}
 }
 
 /** 
- * @brief calculates the average of an array
+ * @brief performs one step of the reinitialization of the mappers and the lookup table of a channel after its neutral point has changed
  */
-uint16_t median(uint16_t const *data, uint8_t const length) {
-	return data[length/2];
-}
\ No newline at end of file
+void reinit_mapping(s_neutral_estimator *estimator, s_channel const *channel, uint16_t const pulse_width_min, uint16_t const pulse_width_max, pulse_width_mapper &lower_mapper, pulse_width_mapper &upper_mapper, s_lookup_table *table) {
+	switch(estimator->reinit_step) {
+	case REINIT_LOWER_MAPPER:
+		lower_mapper.init(pulse_width_min, channel->neutral_pulse_width, (-1)*MOTOR_VALUE_MAX, 0);
+		estimator->reinit_step = REINIT_UPPER_MAPPER;
+		break;
+	case REINIT_UPPER_MAPPER:
+		upper_mapper.init(channel->neutral_pulse_width, pulse_width_max, 0, MOTOR_VALUE_MAX);
+		estimator->lookup_table_index = 0;
+		estimator->reinit_step = (table != 0) ? REINIT_LOOKUP_TABLE : REINIT_IDLE;
+		break;
+	case REINIT_LOOKUP_TABLE: {
+		// the table is rebuilt in chunks to limit the execution time of the control task
+		uint8_t const remaining = LOOKUP_TABLE_SIZE - estimator->lookup_table_index;
+		uint8_t const length = (remaining < LOOKUP_TABLE_REBUILD_CHUNK) ? remaining : LOOKUP_TABLE_REBUILD_CHUNK;
+		build_lookup_table(table, lower_mapper, upper_mapper, channel->neutral_pulse_width, estimator->lookup_table_index, length);
+		estimator->lookup_table_index += length;
+		if(estimator->lookup_table_index >= LOOKUP_TABLE_SIZE) estimator->reinit_step = REINIT_IDLE;
+	} break;
+	default:
+		break;
+	}
+}
+
+/** 
+ * @brief fills length entries of the lookup table starting at first_index with the mapped motor speed value of the pulse width step
+ */
+void build_lookup_table(s_lookup_table *table, pulse_width_mapper const &lower_mapper, pulse_width_mapper const &upper_mapper, uint16_t const neutral_pulse_width, uint8_t const first_index, uint8_t const length) {
+	// the entries around a moved neutral point are below the deadzone, so the table may be used while it is rebuilt
+	table->neutral_pulse_width = neutral_pulse_width;
+	uint8_t i=first_index; for(; i<first_index+length; i++) {
+		int16_t const pulse_width = (int16_t)(LOOKUP_TABLE_PULSE_WIDTH_MIN + ((uint16_t)(i) << LOOKUP_TABLE_STEP_SHIFT));
+		int16_t magnitude = 0;
+		// the mappers saturate outside of the calibrated range, so the magnitude is always between 0 and 255
+		if(pulse_width < (int16_t)(neutral_pulse_width)) {
+			magnitude = 0 - lower_mapper.map(pulse_width);
+		} else if(pulse_width > (int16_t)(neutral_pulse_width)) {
+			magnitude = upper_mapper.map(pulse_width);
+		}
+		table->magnitude[i] = (uint8_t)(magnitude);
+	}
+}
+
+/** 
+ * @brief returns the signed motor speed value of a lookup table entry
+ */
+int16_t lookup_entry(s_lookup_table const *table, uint8_t const index) {
+	int16_t const magnitude = table->magnitude[index];
+	// the sign follows from the pulse width of the step, the neutral point does not need to fall on a step
+	uint16_t const pulse_width = LOOKUP_TABLE_PULSE_WIDTH_MIN + ((uint16_t)(index) << LOOKUP_TABLE_STEP_SHIFT);
+	return (pulse_width < table->neutral_pulse_width) ? (0 - magnitude) : magnitude;
+}
+
+/** 
+ * @brief returns the signed motor speed value for a pulse width between LOOKUP_TABLE_PULSE_WIDTH_MIN and LOOKUP_TABLE_PULSE_WIDTH_MAX
+ */
+int16_t lookup(s_lookup_table const *table, uint16_t const pulse_width) {
+	uint16_t const offset = pulse_width - LOOKUP_TABLE_PULSE_WIDTH_MIN;
+	uint8_t const index = (uint8_t)(offset >> LOOKUP_TABLE_STEP_SHIFT);
+	uint8_t const fraction = (uint8_t)(offset) & (LOOKUP_TABLE_STEP - 1);
+	int16_t const value = lookup_entry(table, index);
+	if(fraction == 0) return value;
+	// interpolate linearly between two entries - there is always a next entry since the last entry is at a fraction of 0
+	int16_t const delta = lookup_entry(table, index + 1) - value;
+	return value + ((delta * fraction + LOOKUP_TABLE_STEP / 2) >> LOOKUP_TABLE_STEP_SHIFT);
+}
+
+#if CONTROL_LATENCY_HISTOGRAM
+/** 
+ * @brief adds the latency between the last update of the channel and now to the histogram
+ */
+void record_latency(s_channel const *channel, uint16_t const now) {
+	uint16_t const latency = now - channel->edge_timestamp;
+	uint16_t bin = latency / LATENCY_HISTOGRAM_BIN_TIMER_STEPS;
+	if(bin >= CONTROL_LATENCY_HISTOGRAM_BINS) bin = CONTROL_LATENCY_HISTOGRAM_BINS - 1;
+	if(m_latency_histogram[bin] < 0xFFFF) m_latency_histogram[bin]++;
+}
+#endif
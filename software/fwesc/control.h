@@ -10,18 +10,21 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "defines.h"
 
 class control {
 public:
 	/** 
 	 * @brief updates channel 1 - only to be called within isr context
+	 * @param ch1_pulse_width pulse width in 1/2^PULSE_WIDTH_FRACTIONAL_BITS us
 	 */
-	static void update_channel_1(uint16_t const ch1_pulse_width_us);
+	static void update_channel_1(uint16_t const ch1_pulse_width);
 	
 	/** 
 	 * @brief updates channel 2 - only to be called within isr context
+	 * @param ch2_pulse_width pulse width in 1/2^PULSE_WIDTH_FRACTIONAL_BITS us
 	 */
-	static void update_channel_2(uint16_t const ch2_pulse_width_us);
+	static void update_channel_2(uint16_t const ch2_pulse_width);
 	
 	/** 
 	 * @brief this function is called by the input module to indicate that channels have been lost - only to be called within isr context
@@ -37,6 +40,18 @@ public:
 	 * @brief returns true if the control task is runnable in the main thread
 	 */
 	static bool is_runnable();
+	
+#if CONTROL_LATENCY_HISTOGRAM
+	/** 
+	 * @brief returns the number of channel updates whose edge to pwm latency was within [bin, bin + 1) * CONTROL_LATENCY_HISTOGRAM_BIN_US, the last bin also holds all longer latencies
+	 */
+	static uint16_t get_latency_histogram(uint8_t const bin);
+	
+	/** 
+	 * @brief clears the edge to pwm latency histogram
+	 */
+	static void clear_latency_histogram();
+#endif
 
 private:
 	/** 
@@ -8,11 +8,90 @@
 #ifndef DEFINES_H_
 #define DEFINES_H_
 
-//#define LEFT_MOTOR
-#define RIGHT_MOTOR
+// the motor can also be selected from the command line, e.g. -DLEFT_MOTOR
+#if !defined LEFT_MOTOR && !defined RIGHT_MOTOR
+	//#define LEFT_MOTOR
+	#define RIGHT_MOTOR
+#endif
 
 #if defined LEFT_MOTOR && defined RIGHT_MOTOR
 	#error "Can only control one motor per esc"
 #endif
 
+// map the pulse widths to motor speed values via a lookup table built after the calibration instead of the linear mappers
+#ifndef USE_PULSE_WIDTH_LOOKUP_TABLE
+	#define USE_PULSE_WIDTH_LOOKUP_TABLE (1)
+#endif
+
+// capture the receiver pulses with 0.5 us resolution (timer 1 prescaler 8) instead of 4 us resolution (timer 1 prescaler 64)
+#ifndef USE_HIGH_RESOLUTION_PULSE_CAPTURE
+	#define USE_HIGH_RESOLUTION_PULSE_CAPTURE (1)
+#endif
+
+// the input module passes the pulse widths to the control module in units of 1/2^PULSE_WIDTH_FRACTIONAL_BITS us
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+	#define PULSE_WIDTH_FRACTIONAL_BITS (1)
+#else
+	#define PULSE_WIDTH_FRACTIONAL_BITS (0)
+#endif
+#define PULSE_WIDTH(us) ((us) << PULSE_WIDTH_FRACTIONAL_BITS)
+
+// recompute the motor speed as soon as either channel has been updated instead of waiting for both channels
+#ifndef USE_INCREMENTAL_CONTROL_UPDATE
+	#define USE_INCREMENTAL_CONTROL_UPDATE (1)
+#endif
+
+// record the latency between the falling edge of a channel pulse and the update of the motor pwm in a histogram
+#ifndef CONTROL_LATENCY_HISTOGRAM
+	#define CONTROL_LATENCY_HISTOGRAM (0)
+#endif
+#define CONTROL_LATENCY_HISTOGRAM_BINS (48)
+#define CONTROL_LATENCY_HISTOGRAM_BIN_US (500)
+
+// detect the loss of a channel with a periodic deadline check on timer 1 compare channel a instead of counting the pulses per 262 ms
+#ifndef USE_FAST_FAILSAFE
+	#define USE_FAST_FAILSAFE (1)
+#endif
+// a channel is lost at the latest FAILSAFE_TIMEOUT_MS (3 frames) after its last valid pulse, it is checked every FAILSAFE_CHECK_PERIOD_MS,
+// so the loss is detected up to one check period earlier
+#ifndef FAILSAFE_TIMEOUT_MS
+	#define FAILSAFE_TIMEOUT_MS (60)
+#endif
+#define FAILSAFE_CHECK_PERIOD_MS (10)
+
+// limit the slew rate of the motor speed with a ramp which is advanced in the timer 0 overflow isr (every 2.04 ms)
+#ifndef USE_MOTOR_RAMP
+	#define USE_MOTOR_RAMP (1)
+#endif
+// time for a change of the speed from 0 to full speed (acceleration) and from full speed to 0 (deceleration), a reversal takes both
+#ifndef MOTOR_RAMP_ACCELERATION_MS
+	#define MOTOR_RAMP_ACCELERATION_MS (250)
+#endif
+#ifndef MOTOR_RAMP_DECELERATION_MS
+	#define MOTOR_RAMP_DECELERATION_MS (250)
+#endif
+
+// the throttle sets the motor current (torque) which is controlled by a pi loop in the adc isr instead of the pwm duty cycle
+#ifndef USE_TORQUE_CONTROL
+	#define USE_TORQUE_CONTROL (0)
+#endif
+// motor current at full throttle, it has to stay below the overcurrent cutoff of 30 A
+#ifndef TORQUE_CURRENT_MAX_A
+	#define TORQUE_CURRENT_MAX_A (25)
+#endif
+
+// measure the execution times of the isrs and the utilization of the main loop with timer 1, the statistics are dumped over the uart on request
+#ifndef ISR_PROFILING
+	#define ISR_PROFILING (0)
+#endif
+
+// record the pulse captures, the lost channels, the overcurrent cutoffs and the motor commands with timestamps in a ring buffer, it is dumped over the uart on request
+#ifndef EVENT_TRACE
+	#define EVENT_TRACE (0)
+#endif
+// 4 bytes of ram per record, a power of 2 up to 128
+#ifndef TRACE_BUFFER_RECORDS
+	#define TRACE_BUFFER_RECORDS (64)
+#endif
+
 #endif /* DEFINES_H_ */
\ No newline at end of file
@@ -0,0 +1,132 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this file implements linear mappers with a rounded fixed point slope and a saturated output
+ * @file fixed_point_linear_mapper.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef FIXED_POINT_LINEAR_MAPPER_H_
+#define FIXED_POINT_LINEAR_MAPPER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief linear mapper whose ranges are known at runtime only
+ * the slope is kept in Q(FRACTIONAL_BITS) format and rounded to nearest, the mapping itself is rounded to nearest as well
+ * FRACTIONAL_BITS = 16 is the fastest choice on avr since the final shift becomes a selection of the upper word
+ * constraint: |output_max - output_min| * 2^FRACTIONAL_BITS * |value - input_min| / |input_max - input_min| must fit into int32_t
+ */
+template <uint8_t FRACTIONAL_BITS>
+class fixed_point_linear_mapper {
+public:
+	/**
+	 * @brief Constructor initializes the linear mapper
+	 * @param input_min minimum value of the input
+	 * @param input_max maximum value of the input
+	 * @param output_min output value for input_min
+	 * @param output_max output value for input_max
+	 */
+	fixed_point_linear_mapper(int16_t const input_min, int16_t const input_max, int16_t const output_min, int16_t const output_max) {
+		this->init(input_min, input_max, output_min, output_max);
+	}
+
+	/**
+	 * @brief reinitializes this linear mapper
+	 */
+	void init(int16_t const input_min, int16_t const input_max, int16_t const output_min, int16_t const output_max) {
+		int32_t const delta_input = (int32_t)(input_max) - (int32_t)(input_min);
+		int32_t const delta_output = (int32_t)(output_max) - (int32_t)(output_min);
+		// an empty input range yields output_min for every input value
+		m_k = (delta_input != 0) ? rounded_div(delta_output * ((int32_t)(1) << FRACTIONAL_BITS), delta_input) : 0;
+		m_input_min = input_min;
+		// output_min and the rounding constant are folded into one offset
+		m_d = ((int32_t)(output_min) << FRACTIONAL_BITS) + ROUNDING;
+		int16_t const lower = (output_min < output_max) ? output_min : output_max;
+		int16_t const upper = (output_min < output_max) ? output_max : output_min;
+		m_lower_limit = (int32_t)(lower) << FRACTIONAL_BITS;
+		m_upper_limit = ((int32_t)(upper) << FRACTIONAL_BITS) + ROUNDING;
+	}
+
+	/**
+	 * @brief performs the linear mapping
+	 * @param value input value to be mapped to output value
+	 * @return mapped output value, limited to the output range
+	 */
+	int16_t map(int16_t const value) const {
+		int32_t result = m_k * (int32_t)(value - m_input_min) + m_d;
+		if(result < m_lower_limit) result = m_lower_limit;
+		if(result > m_upper_limit) result = m_upper_limit;
+		return (int16_t)(result >> FRACTIONAL_BITS);
+	}
+
+	/**
+	 * @brief maps length values at once
+	 */
+	void map(int16_t const *values, int16_t *results, uint8_t const length) const {
+		uint8_t i=0; for(; i<length; i++) results[i] = this->map(values[i]);
+	}
+
+	/**
+	 * @brief rounds a / b to nearest, b > 0 or b < 0, halves are rounded away from zero
+	 */
+	static int32_t rounded_div(int32_t const a, int32_t const b) {
+		bool const is_negative = (a < 0) != (b < 0);
+		int32_t const abs_a = (a < 0) ? (0 - a) : a;
+		int32_t const abs_b = (b < 0) ? (0 - b) : b;
+		int32_t const abs_q = (abs_a + abs_b / 2) / abs_b;
+		return is_negative ? (0 - abs_q) : abs_q;
+	}
+
+private:
+	static int32_t const ROUNDING = ((int32_t)(1) << FRACTIONAL_BITS) / 2;
+
+	int32_t m_k;
+	int32_t m_d;
+	int32_t m_lower_limit;
+	int32_t m_upper_limit;
+	int16_t m_input_min;
+};
+
+/**
+ * @brief linear mapper whose ranges are known at compile time - slope, offset and limits are folded into constants
+ * same rounding, saturation and overflow constraint as fixed_point_linear_mapper, INPUT_MIN < INPUT_MAX
+ */
+template <int16_t INPUT_MIN, int16_t INPUT_MAX, int16_t OUTPUT_MIN, int16_t OUTPUT_MAX, uint8_t FRACTIONAL_BITS>
+class static_linear_mapper {
+public:
+	/**
+	 * @brief performs the linear mapping
+	 * @param value input value to be mapped to output value
+	 * @return mapped output value, limited to the output range
+	 */
+	static int16_t map(int16_t const value) {
+		int32_t result = K * (int32_t)(value) + D;
+		if(result < LOWER_LIMIT) result = LOWER_LIMIT;
+		if(result > UPPER_LIMIT) result = UPPER_LIMIT;
+		return (int16_t)(result >> FRACTIONAL_BITS);
+	}
+
+	/**
+	 * @brief maps length values at once
+	 */
+	static void map(int16_t const *values, int16_t *results, uint8_t const length) {
+		uint8_t i=0; for(; i<length; i++) results[i] = map(values[i]);
+	}
+
+private:
+	static int32_t const DELTA_INPUT = (int32_t)(INPUT_MAX) - (int32_t)(INPUT_MIN);
+	static int32_t const DELTA_OUTPUT = (int32_t)(OUTPUT_MAX) - (int32_t)(OUTPUT_MIN);
+	static int32_t const ROUNDING = ((int32_t)(1) << FRACTIONAL_BITS) / 2;
+	// slope rounded to nearest, halves away from zero
+	static int32_t const K = (DELTA_OUTPUT * ((int32_t)(1) << FRACTIONAL_BITS) + ((DELTA_OUTPUT < 0) ? (0 - DELTA_INPUT / 2) : (DELTA_INPUT / 2))) / DELTA_INPUT;
+	static int32_t const D = ((int32_t)(OUTPUT_MIN) << FRACTIONAL_BITS) - K * (int32_t)(INPUT_MIN) + ROUNDING;
+	static int32_t const LOWER_LIMIT = (int32_t)((OUTPUT_MIN < OUTPUT_MAX) ? OUTPUT_MIN : OUTPUT_MAX) << FRACTIONAL_BITS;
+	static int32_t const UPPER_LIMIT = ((int32_t)((OUTPUT_MIN < OUTPUT_MAX) ? OUTPUT_MAX : OUTPUT_MIN) << FRACTIONAL_BITS) + ROUNDING;
+
+	/**
+	 * @brief Constructor
+	 */
+	static_linear_mapper() { }
+};
+
+#endif /* FIXED_POINT_LINEAR_MAPPER_H_ */
@@ -0,0 +1,60 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief host (linux) replacement for <avr/interrupt.h> - isrs become ordinary functions which can be called by a test or benchmark driver
+ * @file interrupt.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <stdint.h>
+
+/* GLOBAL VARIABLE SECTION */
+
+// emulated global interrupt enable flag (I bit of SREG)
+extern volatile uint8_t host_global_interrupt_enable;
+
+// statistics of the windows in which the interrupts have been disabled by cli() - the longest window bounds the interrupt latency jitter
+extern unsigned long host_interrupt_disabled_windows;
+extern unsigned long host_interrupt_disabled_max_ns;
+// histogram of the window lengths, bucket n holds the windows of [2^n, 2^(n+1)) ns - the maximum is dominated by the preemption of the host process
+#define HOST_INTERRUPT_DISABLED_BUCKETS (32)
+extern unsigned long host_interrupt_disabled_histogram[HOST_INTERRUPT_DISABLED_BUCKETS];
+
+/* MACRO SECTION */
+
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+
+#define cli() host_cli()
+#define sei() host_sei()
+
+/* PROTOTYPE SECTION */
+
+/**
+ * @brief clears the emulated interrupt enable flag and starts the measurement of the window
+ */
+void host_cli();
+
+/**
+ * @brief sets the emulated interrupt enable flag and records the length of the window
+ */
+void host_sei();
+
+/**
+ * @brief clears the interrupt disabled window statistics
+ */
+void host_reset_interrupt_statistics();
+
+// interrupt vectors which are implemented by the fw esc
+extern "C" void INT0_vect(void);
+extern "C" void INT1_vect(void);
+extern "C" void ADC_vect(void);
+extern "C" void TIMER0_OVF_vect(void);
+extern "C" void TIMER1_OVF_vect(void);
+extern "C" void TIMER1_COMPA_vect(void);
+extern "C" void TIMER2_COMPA_vect(void);
+extern "C" void USART_RX_vect(void);
+extern "C" void USART_UDRE_vect(void);
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
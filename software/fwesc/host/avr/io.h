@@ -0,0 +1,185 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief host (linux) replacement for <avr/io.h> - the atmega328p registers used by the fw esc are plain memory variables
+ * @file io.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+/* REGISTER SECTION */
+
+// port d
+extern volatile uint8_t DDRD;
+extern volatile uint8_t PORTD;
+extern volatile uint8_t PIND;
+
+// timer 0
+extern volatile uint8_t TCCR0A;
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t OCR0B;
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t TIFR0;
+
+// timer 1
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+
+// timer 2
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t TCNT2;
+extern volatile uint8_t OCR2A;
+extern volatile uint8_t OCR2B;
+extern volatile uint8_t TIMSK2;
+extern volatile uint8_t TIFR2;
+
+// external interrupts
+extern volatile uint8_t EICRA;
+extern volatile uint8_t EIMSK;
+extern volatile uint8_t EIFR;
+
+// adc
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRB;
+extern volatile uint16_t ADC;
+extern volatile uint8_t DIDR0;
+/**
+ * @brief ADCSRA is accessed through a function which clears ADSC on every access, a conversion started by the firmware therefore completes immediately
+ */
+volatile uint8_t &host_sfr_adcsra();
+#define ADCSRA (host_sfr_adcsra())
+
+/**
+ * @brief SREG is accessed through a proxy which maps the I bit to the emulated global interrupt enable flag, the other flags are not emulated
+ */
+struct host_sreg {
+	operator uint8_t() const;
+	host_sreg &operator=(uint8_t const value);
+};
+extern host_sreg host_sfr_sreg;
+#define SREG (host_sfr_sreg)
+
+// sleep mode control
+extern volatile uint8_t SMCR;
+
+// usart 0
+extern volatile uint8_t UCSR0A;
+extern volatile uint8_t UCSR0B;
+extern volatile uint8_t UCSR0C;
+extern volatile uint16_t UBRR0;
+extern volatile uint8_t UDR0;
+
+/* BIT SECTION */
+
+// TCCR0A
+#define COM0A1	7
+#define COM0A0	6
+#define COM0B1	5
+#define COM0B0	4
+#define WGM01	1
+#define WGM00	0
+// TCCR0B
+#define WGM02	3
+#define CS02	2
+#define CS01	1
+#define CS00	0
+// TIMSK0
+#define OCIE0B	2
+#define OCIE0A	1
+#define TOIE0	0
+// TIFR0
+#define OCF0B	2
+#define OCF0A	1
+#define TOV0	0
+
+// TCCR1B
+#define WGM13	4
+#define WGM12	3
+#define CS12	2
+#define CS11	1
+#define CS10	0
+// TIMSK1 / TIFR1
+#define ICIE1	5
+#define OCIE1B	2
+#define OCIE1A	1
+#define TOIE1	0
+#define OCF1B	2
+#define OCF1A	1
+#define TOV1	0
+
+// TCCR2A
+#define WGM21	1
+#define WGM20	0
+// TCCR2B
+#define CS22	2
+#define CS21	1
+#define CS20	0
+// TIMSK2 / TIFR2
+#define OCIE2B	2
+#define OCIE2A	1
+#define TOIE2	0
+#define OCF2A	1
+
+// EICRA
+#define ISC11	3
+#define ISC10	2
+#define ISC01	1
+#define ISC00	0
+// EIMSK
+#define INT1	1
+#define INT0	0
+
+// ADMUX
+#define REFS1	7
+#define REFS0	6
+#define ADLAR	5
+#define MUX3	3
+#define MUX2	2
+#define MUX1	1
+#define MUX0	0
+// ADCSRA
+#define ADEN	7
+#define ADSC	6
+#define ADATE	5
+#define ADIF	4
+#define ADIE	3
+#define ADPS2	2
+#define ADPS1	1
+#define ADPS0	0
+// DIDR0
+#define ADC5D	5
+#define ADC4D	4
+
+// SMCR
+#define SM2		3
+#define SM1		2
+#define SM0		1
+#define SE		0
+
+// UCSR0A
+#define RXC0	7
+#define TXC0	6
+#define UDRE0	5
+#define U2X0	1
+// UCSR0B
+#define RXCIE0	7
+#define TXCIE0	6
+#define UDRIE0	5
+#define RXEN0	4
+#define TXEN0	3
+// UCSR0C
+#define UCSZ01	2
+#define UCSZ00	1
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,30 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief host (linux) replacement for <avr/sleep.h> - sleep_cpu calls a hook which lets the test or benchmark driver raise the interrupt that wakes the cpu
+ * @file sleep.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef HOST_AVR_SLEEP_H_
+#define HOST_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+/* GLOBAL VARIABLE SECTION */
+
+// called by sleep_cpu, the hook has to call the isr which wakes up the cpu - without a hook sleep_cpu returns immediately
+extern void (*host_sleep_hook)(void);
+
+/* DEFINE SECTION */
+
+#define SLEEP_MODE_IDLE			(0)
+#define SLEEP_MODE_PWR_DOWN		((1<<SM1))
+
+/* MACRO SECTION */
+
+#define set_sleep_mode(mode) do { SMCR = (SMCR & ~((1<<SM2) | (1<<SM1) | (1<<SM0))) | (mode); } while(0)
+#define sleep_enable() do { SMCR |= (1<<SE); } while(0)
+#define sleep_disable() do { SMCR &= ~(1<<SE); } while(0)
+#define sleep_cpu() do { if(host_sleep_hook != 0) host_sleep_hook(); } while(0)
+
+#endif /* HOST_AVR_SLEEP_H_ */
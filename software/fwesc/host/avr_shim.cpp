@@ -0,0 +1,131 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief storage for the emulated atmega328p registers of the host build
+ * @file avr_shim.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include <time.h>
+
+/* GLOBAL VARIABLE SECTION */
+
+volatile uint8_t DDRD = 0;
+volatile uint8_t PORTD = 0;
+volatile uint8_t PIND = 0;
+
+volatile uint8_t TCCR0A = 0;
+volatile uint8_t TCCR0B = 0;
+volatile uint8_t TCNT0 = 0;
+volatile uint8_t OCR0A = 0;
+volatile uint8_t OCR0B = 0;
+volatile uint8_t TIMSK0 = 0;
+volatile uint8_t TIFR0 = 0;
+
+volatile uint8_t TCCR1A = 0;
+volatile uint8_t TCCR1B = 0;
+volatile uint16_t TCNT1 = 0;
+volatile uint16_t OCR1A = 0;
+volatile uint16_t OCR1B = 0;
+volatile uint8_t TIMSK1 = 0;
+volatile uint8_t TIFR1 = 0;
+
+volatile uint8_t TCCR2A = 0;
+volatile uint8_t TCCR2B = 0;
+volatile uint8_t TCNT2 = 0;
+volatile uint8_t OCR2A = 0;
+volatile uint8_t OCR2B = 0;
+volatile uint8_t TIMSK2 = 0;
+volatile uint8_t TIFR2 = 0;
+
+volatile uint8_t EICRA = 0;
+volatile uint8_t EIMSK = 0;
+volatile uint8_t EIFR = 0;
+
+volatile uint8_t ADMUX = 0;
+volatile uint8_t ADCSRB = 0;
+volatile uint16_t ADC = 0;
+volatile uint8_t DIDR0 = 0;
+
+volatile uint8_t SMCR = 0;
+
+volatile uint8_t UCSR0A = 0;
+volatile uint8_t UCSR0B = 0;
+volatile uint8_t UCSR0C = 0;
+volatile uint16_t UBRR0 = 0;
+volatile uint8_t UDR0 = 0;
+
+volatile uint8_t host_global_interrupt_enable = 0;
+unsigned long host_interrupt_disabled_windows = 0;
+unsigned long host_interrupt_disabled_max_ns = 0;
+unsigned long host_interrupt_disabled_histogram[HOST_INTERRUPT_DISABLED_BUCKETS] = {0};
+
+void (*host_sleep_hook)(void) = 0;
+
+host_sreg host_sfr_sreg;
+
+static volatile uint8_t m_adcsra = 0;
+static struct timespec m_cli_time;
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief access to ADCSRA - a started conversion is completed immediately
+ */
+volatile uint8_t &host_sfr_adcsra() {
+	m_adcsra &= ~(1<<ADSC);
+	return m_adcsra;
+}
+
+/**
+ * @brief reads SREG, only the I bit is set
+ */
+host_sreg::operator uint8_t() const {
+	return host_global_interrupt_enable ? 0x80 : 0x00;
+}
+
+/**
+ * @brief writes SREG, the I bit enables or disables the interrupts like sei() and cli()
+ */
+host_sreg &host_sreg::operator=(uint8_t const value) {
+	if(value & 0x80) host_sei();
+	else host_cli();
+	return *this;
+}
+
+/**
+ * @brief clears the emulated interrupt enable flag and starts the measurement of the window
+ */
+void host_cli() {
+	if(host_global_interrupt_enable) clock_gettime(CLOCK_MONOTONIC, &m_cli_time);
+	host_global_interrupt_enable = 0;
+}
+
+/**
+ * @brief sets the emulated interrupt enable flag and records the length of the window
+ */
+void host_sei() {
+	if(!host_global_interrupt_enable) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		unsigned long const window_ns = (unsigned long)((now.tv_sec - m_cli_time.tv_sec) * 1000000000L + (now.tv_nsec - m_cli_time.tv_nsec));
+		if(window_ns > host_interrupt_disabled_max_ns) host_interrupt_disabled_max_ns = window_ns;
+		host_interrupt_disabled_windows++;
+		unsigned int bucket = 0;
+		while((bucket < HOST_INTERRUPT_DISABLED_BUCKETS - 1) && (window_ns >> (bucket + 1)) != 0) bucket++;
+		host_interrupt_disabled_histogram[bucket]++;
+	}
+	host_global_interrupt_enable = 1;
+}
+
+/**
+ * @brief clears the interrupt disabled window statistics
+ */
+void host_reset_interrupt_statistics() {
+	host_interrupt_disabled_windows = 0;
+	host_interrupt_disabled_max_ns = 0;
+	for(unsigned int bucket = 0; bucket < HOST_INTERRUPT_DISABLED_BUCKETS; bucket++) host_interrupt_disabled_histogram[bucket] = 0;
+}
@@ -0,0 +1,710 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief benchmark driver for the host build of the fw esc - calls the isrs and the control task many times and reports the cost per call
+ * @file bench.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "motor.h"
+#include "input.h"
+#include "control.h"
+#include "adc.h"
+#include "scheduler.h"
+#include "torque.h"
+#include "uart.h"
+#include "profiler.h"
+#include "trace.h"
+#include "defines.h"
+#include "linear_mapper.h"
+#include "fixed_point_linear_mapper.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+/* GLOBAL CONSTANT SECTION */
+static unsigned long const DEFAULT_ITERATIONS = 10000000UL;
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+// timer 1 runs with 0.5 us per step
+static uint16_t const TIMER1_STEPS_PER_PULSE = 1500 * 2;
+static uint16_t const TIMER1_STEPS_PER_FRAME = 20000 * 2;
+#else
+// timer 1 runs with 4 us per step
+static uint16_t const TIMER1_STEPS_PER_PULSE = 1500 / 4;
+static uint16_t const TIMER1_STEPS_PER_FRAME = 20000 / 4;
+#endif
+// the drive (timer 0, motor model and adc) is emulated in steps of 100 us
+static uint16_t const TIMER1_STEPS_PER_DRIVE_STEP = TIMER1_STEPS_PER_FRAME / 200;
+// calibrated range and a typical neutral position of the control module
+static int16_t const MAPPER_INPUT_MIN = 1120;
+static int16_t const MAPPER_INPUT_NEUTRAL = 1508;
+static int16_t const MAPPER_INPUT_MAX = 1910;
+static int16_t const MAPPER_OUTPUT_MAX = 255;
+// dc motor model of the drive emulation - 12 V battery, 0.15 ohm winding, 80 ms mechanical time constant, 2 A no load current
+static double const DRIVE_STEP_S = 100e-6;
+static double const MOTOR_SUPPLY_V = 12.0;
+static double const MOTOR_RESISTANCE_OHM = 0.15;
+static double const MOTOR_MECHANICAL_TIME_CONSTANT_S = 0.08;
+static double const MOTOR_NO_LOAD_CURRENT_A = 2.0;
+static double const ADC_STEPS_PER_A = adc::CURRENT_SENSE_1_A;
+// timer 0 counts up and down with 4 us per step in phase correct mode, i.e. 25 steps per drive step and 510 steps per pwm period
+static uint16_t const TIMER0_STEPS_PER_DRIVE_STEP = 25;
+static uint16_t const TIMER0_STEPS_PER_PERIOD = 510;
+// the adc samples the input 12 us after the start of the conversion
+static uint16_t const ADC_SAMPLE_DELAY_TIMER0_STEPS = 3;
+#if EVENT_TRACE
+// the dump of the event trace is written to this file for the decoder
+static char const * const TRACE_DUMP_FILE = "fwesc_trace.bin";
+#endif
+
+/* TYPEDEF SECTION */
+typedef struct {
+	double supply_v;
+	double back_emf_v; // proportional to the speed
+	double current_a;
+	double load_a_per_v; // load torque proportional to the speed, as current
+	bool is_sense_broken; // the current sensors deliver 0
+	uint16_t timer0_phase; // position within the pwm period
+	uint16_t conversion_phase; // timer 0 phase at the start of the running conversion
+} s_drive_model;
+
+/* GLOBAL VARIABLE SECTION */
+// results of the mapper benchmarks end up here so that the calls are not optimized away
+static volatile int32_t m_mapper_sink = 0;
+// emulated time of the scheduler benchmark
+static unsigned long m_sleep_calls = 0;
+static unsigned long m_injected_overruns = 0;
+// every OVERRUN_PERIOD-th sleep the main loop is late by one tick
+static unsigned long const OVERRUN_PERIOD = 16;
+// state of the emulated drive
+static s_drive_model m_drive = {MOTOR_SUPPLY_V, 0.0, 0.0, 0.0, false, 0, 0};
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief prints one result line
+ */
+static void report(char const *name, unsigned long const calls, std::chrono::steady_clock::duration const elapsed) {
+	double const ns = std::chrono::duration<double, std::nano>(elapsed).count();
+	std::printf("%-20s %12lu calls %10.2f ns/call\n", name, calls, ns / static_cast<double>(calls));
+}
+
+/**
+ * @brief prints the interrupt disabled windows of a benchmark and clears the statistics
+ */
+static void report_interrupt_windows(char const *name, unsigned long const calls) {
+	// 99.9 % of the windows are shorter than the upper bound of this bucket
+	unsigned long cumulated = 0;
+	unsigned int bucket = 0;
+	for(; bucket < HOST_INTERRUPT_DISABLED_BUCKETS - 1; bucket++) {
+		cumulated += host_interrupt_disabled_histogram[bucket];
+		if(cumulated * 1000 >= host_interrupt_disabled_windows * 999) break;
+	}
+	std::printf("%-20s %12lu cli windows (%.2f per call), 99.9 %% < %lu ns, longest %lu ns\n", name, host_interrupt_disabled_windows,
+		static_cast<double>(host_interrupt_disabled_windows) / static_cast<double>(calls), 2UL << bucket, host_interrupt_disabled_max_ns);
+	host_reset_interrupt_statistics();
+}
+
+/**
+ * @brief generates one complete pulse (rising and falling edge) on both channels via the external interrupt isrs
+ */
+static void feed_pulse(uint16_t &timestamp, uint16_t const width_in_timer_steps) {
+	TCNT1 = timestamp;
+	INT0_vect();
+	INT1_vect();
+	TCNT1 = timestamp + width_in_timer_steps;
+	INT0_vect();
+	INT1_vect();
+	timestamp += TIMER1_STEPS_PER_FRAME;
+}
+
+/**
+ * @brief benchmarks an external interrupt isr, every call alternates between rising and falling edge
+ */
+static void bench_int_vect(char const *name, void (*vect)(void), unsigned long const iterations) {
+	uint16_t timestamp = 0;
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i += 2) {
+		TCNT1 = timestamp;
+		vect();
+		TCNT1 = timestamp + TIMER1_STEPS_PER_PULSE + (i & 0x3F);
+		vect();
+		timestamp += TIMER1_STEPS_PER_FRAME;
+	}
+	report(name, iterations, std::chrono::steady_clock::now() - start);
+}
+
+/**
+ * @brief benchmarks the adc isr with a current below the overcurrent threshold
+ */
+static void bench_adc_vect(unsigned long const iterations) {
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) {
+		ADC = static_cast<uint16_t>(i & 0x1FF);
+		ADC_vect();
+	}
+	report("ADC_vect", iterations, std::chrono::steady_clock::now() - start);
+}
+
+#if USE_FAST_FAILSAFE
+/**
+ * @brief benchmarks the timer 1 compare match a isr (failsafe check)
+ */
+static void bench_timer1_compa_vect(unsigned long const iterations) {
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) {
+		TIMER1_COMPA_vect();
+	}
+	report("TIMER1_COMPA_vect", iterations, std::chrono::steady_clock::now() - start);
+}
+#else
+/**
+ * @brief benchmarks the timer 1 overflow isr
+ */
+static void bench_timer1_ovf_vect(unsigned long const iterations) {
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) {
+		TIMER1_OVF_vect();
+	}
+	report("TIMER1_OVF_vect", iterations, std::chrono::steady_clock::now() - start);
+}
+#endif
+
+/**
+ * @brief benchmarks the control task after calibration with a sweeping stick position
+ */
+static void bench_control_run(unsigned long const iterations) {
+	// calibrate with the stick in neutral position
+	host_reset_interrupt_statistics();
+	uint16_t timestamp = 0;
+	for(int i = 0; i < 16; i++) {
+		feed_pulse(timestamp, TIMER1_STEPS_PER_PULSE);
+		if(control::is_runnable()) control::run();
+	}
+	// prepare a sweep of pulse widths between 1000 and 2000 us
+	uint16_t widths[256];
+	for(int i = 0; i < 256; i++) widths[i] = static_cast<uint16_t>(PULSE_WIDTH(1000 + (i * 1000) / 255));
+
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::duration::zero();
+	unsigned long const chunk = 4096;
+	for(unsigned long done = 0; done < iterations; done += chunk) {
+		uint16_t const width = widths[(done / chunk) & 0xFF];
+		std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+		for(unsigned long i = 0; i < chunk; i++) {
+			control::update_channel_1(width);
+			control::update_channel_2(widths[i & 0xFF]);
+			control::run();
+		}
+		elapsed += std::chrono::steady_clock::now() - start;
+	}
+	// update_channel_x are trivial stores, the measurement is dominated by run()
+	report("control::run", (iterations / chunk) * chunk, elapsed);
+	report_interrupt_windows("control::run", (iterations / chunk) * chunk);
+}
+
+/**
+ * @brief reference mapping in double precision
+ */
+static double reference_map(int16_t const value, int16_t const input_min, int16_t const input_max, int16_t const output_min, int16_t const output_max) {
+	return output_min + (double)(output_max - output_min) * (double)(value - input_min) / (double)(input_max - input_min);
+}
+
+/**
+ * @brief compares the maximum error of linear_mapper (used with a 1<<14 output range and a shift by 6 as in control) and fixed_point_linear_mapper
+ * against the double reference on both sides of the neutral position
+ */
+static void compare_mapper_accuracy() {
+	linear_mapper legacy_lower(MAPPER_INPUT_MIN, MAPPER_INPUT_NEUTRAL, (-1)*(1<<14), 0);
+	linear_mapper legacy_upper(MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, (1<<14));
+	fixed_point_linear_mapper<16> fixed_lower(MAPPER_INPUT_MIN, MAPPER_INPUT_NEUTRAL, (-1)*MAPPER_OUTPUT_MAX, 0);
+	fixed_point_linear_mapper<16> fixed_upper(MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, MAPPER_OUTPUT_MAX);
+	typedef static_linear_mapper<MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, MAPPER_OUTPUT_MAX, 16> static_upper;
+
+	double legacy_error = 0.0, fixed_error = 0.0, static_error = 0.0;
+	for(int16_t value = MAPPER_INPUT_MIN; value <= MAPPER_INPUT_MAX; value++) {
+		bool const is_lower = value < MAPPER_INPUT_NEUTRAL;
+		double const reference = is_lower ?
+			reference_map(value, MAPPER_INPUT_MIN, MAPPER_INPUT_NEUTRAL, (-1)*MAPPER_OUTPUT_MAX, 0) :
+			reference_map(value, MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, MAPPER_OUTPUT_MAX);
+		int16_t const legacy = is_lower ? legacy_lower.map(value) / (1<<6) : legacy_upper.map(value) / (1<<6);
+		int16_t const fixed = is_lower ? fixed_lower.map(value) : fixed_upper.map(value);
+		legacy_error = std::fmax(legacy_error, std::fabs(legacy - reference));
+		fixed_error = std::fmax(fixed_error, std::fabs(fixed - reference));
+		if(!is_lower) static_error = std::fmax(static_error, std::fabs(static_upper::map(value) - reference));
+	}
+	std::printf("mapper max error vs double reference in %d..%d us (neutral %d, output +/-%d): linear_mapper %.2f, fixed_point_linear_mapper %.2f, static_linear_mapper %.2f\n",
+		MAPPER_INPUT_MIN, MAPPER_INPUT_MAX, MAPPER_INPUT_NEUTRAL, MAPPER_OUTPUT_MAX, legacy_error, fixed_error, static_error);
+}
+
+/**
+ * @brief benchmarks the single value map() of the linear mappers and the batch map of the fixed point mapper with a sweep of pulse widths
+ */
+static void bench_mapper(unsigned long const iterations) {
+	int16_t values[256];
+	int16_t results[256];
+	for(int i = 0; i < 256; i++) values[i] = static_cast<int16_t>(1000 + (i * 1000) / 255);
+
+	linear_mapper legacy(MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, (1<<14));
+	fixed_point_linear_mapper<16> fixed(MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, MAPPER_OUTPUT_MAX);
+	typedef static_linear_mapper<MAPPER_INPUT_NEUTRAL, MAPPER_INPUT_MAX, 0, MAPPER_OUTPUT_MAX, 16> static_mapper;
+
+	int32_t sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) sum += legacy.map(values[i & 0xFF]);
+	report("linear_mapper", iterations, std::chrono::steady_clock::now() - start);
+
+	start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) sum += fixed.map(values[i & 0xFF]);
+	report("fixed_point_mapper", iterations, std::chrono::steady_clock::now() - start);
+
+	start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) sum += static_mapper::map(values[i & 0xFF]);
+	report("static_mapper", iterations, std::chrono::steady_clock::now() - start);
+
+	unsigned long const batches = iterations / 256;
+	start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < batches; i++) {
+		fixed.map(values, results, 255);
+		sum += results[i % 255];
+	}
+	report("fixed_mapper batch", batches * 255, std::chrono::steady_clock::now() - start);
+
+	m_mapper_sink = sum;
+}
+
+/**
+ * @brief sleep hook of the scheduler benchmark - every sleep lasts until the next tick, every OVERRUN_PERIOD-th sleep a tick is missed
+ */
+static void scheduler_sleep_hook() {
+	m_sleep_calls++;
+	if((m_sleep_calls % OVERRUN_PERIOD) == 0) {
+		TIMER2_COMPA_vect();
+		m_injected_overruns++;
+	}
+	TIMER2_COMPA_vect();
+}
+
+/**
+ * @brief benchmarks the main loop (wait for the tick, poll the control task) and checks that the injected overruns are counted
+ */
+static void bench_scheduler(unsigned long const iterations) {
+	scheduler::init();
+	host_sleep_hook = &scheduler_sleep_hook;
+	host_reset_interrupt_statistics();
+	uint16_t const overruns_before = scheduler::get_overrun_count();
+	unsigned long ticks = 0;
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) {
+		ticks += scheduler::wait_for_tick();
+		if(control::is_runnable()) control::run();
+	}
+	report("main loop tick", iterations, std::chrono::steady_clock::now() - start);
+	report_interrupt_windows("main loop tick", iterations);
+	host_sleep_hook = 0;
+	unsigned long const overruns = scheduler::get_overrun_count() - overruns_before;
+	std::printf("scheduler: %lu ticks, %lu overruns counted, %lu injected%s\n", ticks, overruns, m_injected_overruns,
+		(m_injected_overruns > 0xFFFF) ? " (counter saturated)" : "");
+}
+
+#if CONTROL_LATENCY_HISTOGRAM
+/**
+ * @brief emulates a receiver whose ch2 pulse follows the ch1 pulse by half a frame and a main loop ticking every 1 ms
+ * and prints the distribution of the edge to pwm latency recorded by the control module
+ */
+static void bench_control_latency(unsigned long const frames) {
+	// all times are in timer 1 steps
+	uint16_t const steps_per_ms = TIMER1_STEPS_PER_FRAME / 20;
+	// a frame period of 20.3 ms lets the edges wander over all phases of the 1 ms tick
+	uint32_t const frame_period = 20UL * steps_per_ms + (3UL * steps_per_ms) / 10;
+	uint32_t const ch2_offset = frame_period / 2;
+	uint32_t next_tick = steps_per_ms;
+	control::clear_latency_histogram();
+	for(unsigned long frame = 0; frame < frames; frame++) {
+		uint32_t const frame_start = frame * frame_period;
+		// the stick moves a little every frame so that the control task always has something to do
+		uint16_t const width = TIMER1_STEPS_PER_PULSE + static_cast<uint16_t>(frame & 0x3F);
+		uint32_t const edges[4] = {frame_start, frame_start + width, frame_start + ch2_offset, frame_start + ch2_offset + TIMER1_STEPS_PER_PULSE};
+		void (* const vects[4])(void) = {&INT0_vect, &INT0_vect, &INT1_vect, &INT1_vect};
+		for(int e = 0; e < 4; e++) {
+			// run all main loop ticks before the edge
+			while(next_tick <= edges[e]) {
+				TCNT1 = static_cast<uint16_t>(next_tick);
+				if(control::is_runnable()) control::run();
+				next_tick += steps_per_ms;
+			}
+			TCNT1 = static_cast<uint16_t>(edges[e]);
+			vects[e]();
+		}
+	}
+	unsigned long total = 0;
+	for(uint8_t bin = 0; bin < CONTROL_LATENCY_HISTOGRAM_BINS; bin++) total += control::get_latency_histogram(bin);
+	std::printf("edge to pwm latency (%s, 1 ms tick, ch2 %lu ms after ch1), %lu updates:\n",
+		USE_INCREMENTAL_CONTROL_UPDATE ? "incremental update" : "update after both channels", static_cast<unsigned long>(ch2_offset / steps_per_ms), total);
+	unsigned long cumulated = 0;
+	for(uint8_t bin = 0; bin < CONTROL_LATENCY_HISTOGRAM_BINS; bin++) {
+		uint16_t const count = control::get_latency_histogram(bin);
+		if(count == 0) continue;
+		cumulated += count;
+		std::printf("  %5u - %5u us %8u %6.2f %%\n", bin * CONTROL_LATENCY_HISTOGRAM_BIN_US, (bin + 1) * CONTROL_LATENCY_HISTOGRAM_BIN_US, count, 100.0 * cumulated / total);
+	}
+}
+#endif
+
+/**
+ * @brief timer 0 value at the given position within the pwm period
+ */
+static uint8_t timer0_value(uint16_t const phase) {
+	return static_cast<uint8_t>((phase <= 255) ? phase : (TIMER0_STEPS_PER_PERIOD - phase));
+}
+
+/**
+ * @brief signed voltage applied to the motor by the h bridge according to the emulated timer 0 registers
+ */
+static double applied_voltage() {
+	if(!(PORTD & (1<<7))) return 0.0;
+	if(TCCR0A & (1<<COM0A1)) return m_drive.supply_v * OCR0A / 255.0;
+	if(TCCR0A & (1<<COM0B1)) return -m_drive.supply_v * OCR0B / 255.0;
+	// brake, both low side switches are closed
+	return 0.0;
+}
+
+/**
+ * @brief emulates 100 us of the drive - timer 0 with its overflow isr, the motor (averaged over the pwm period) and one adc conversion
+ * the current sensor of a half bridge only sees the motor current while its high side switch is closed, like on the target
+ */
+static void emulate_drive_step() {
+	m_drive.timer0_phase += TIMER0_STEPS_PER_DRIVE_STEP;
+	if(m_drive.timer0_phase >= TIMER0_STEPS_PER_PERIOD) {
+		m_drive.timer0_phase -= TIMER0_STEPS_PER_PERIOD;
+#if USE_MOTOR_RAMP
+		if(TIMSK0 & (1<<TOIE0)) TIMER0_OVF_vect();
+#endif
+	}
+	TCNT0 = timer0_value(m_drive.timer0_phase);
+
+	bool const is_enabled = (PORTD & (1<<7)) != 0;
+	m_drive.current_a = is_enabled ? (applied_voltage() - m_drive.back_emf_v) / MOTOR_RESISTANCE_OHM : 0.0;
+	double const friction = (m_drive.back_emf_v > 0.0) ? MOTOR_NO_LOAD_CURRENT_A : ((m_drive.back_emf_v < 0.0) ? -MOTOR_NO_LOAD_CURRENT_A : 0.0);
+	double const load = m_drive.load_a_per_v * m_drive.back_emf_v;
+	m_drive.back_emf_v += (m_drive.current_a - friction - load) * MOTOR_RESISTANCE_OHM / MOTOR_MECHANICAL_TIME_CONSTANT_S * DRIVE_STEP_S;
+
+	// is2 (mux 5) senses half bridge 2 which drives forward with oc0a, is1 (mux 4) half bridge 1 which drives backward with oc0b
+	bool const is_is2 = (ADMUX & 0x01) != 0;
+	bool const is_high_side_active = is_is2 ? ((TCCR0A & (1<<COM0A1)) != 0) : ((TCCR0A & (1<<COM0B1)) != 0);
+	uint8_t const compare = is_is2 ? OCR0A : OCR0B;
+	uint8_t const sample_value = timer0_value((m_drive.conversion_phase + ADC_SAMPLE_DELAY_TIMER0_STEPS) % TIMER0_STEPS_PER_PERIOD);
+	bool const is_on = is_enabled && is_high_side_active && ((compare == 255) || (sample_value < compare));
+	double const sensed_a = (is_on && !m_drive.is_sense_broken) ? std::fabs(m_drive.current_a) : 0.0;
+	ADC = static_cast<uint16_t>(std::fmin(sensed_a * ADC_STEPS_PER_A, 1023.0));
+	// the isr starts the next conversion
+	m_drive.conversion_phase = m_drive.timer0_phase;
+	ADC_vect();
+}
+
+/**
+ * @brief resets the motor model to standstill
+ */
+static void reset_drive(double const supply_v, double const load_a_per_v) {
+	torque::stop();
+	motor::stop();
+	motor::enable();
+	m_drive.supply_v = supply_v;
+	m_drive.back_emf_v = 0.0;
+	m_drive.current_a = 0.0;
+	m_drive.load_a_per_v = load_a_per_v;
+	m_drive.is_sense_broken = false;
+}
+
+/**
+ * @brief advances the emulated timer 1 step by step - raises the timer 1 interrupts like the hardware and polls the control task every 1 ms like the main loop
+ */
+static void advance_timer1(uint32_t const steps) {
+	uint16_t const steps_per_ms = TIMER1_STEPS_PER_FRAME / 20;
+	for(uint32_t i = 0; i < steps; i++) {
+		TCNT1 = static_cast<uint16_t>(TCNT1 + 1);
+		if((TCNT1 % TIMER1_STEPS_PER_DRIVE_STEP) == 0) emulate_drive_step();
+#if USE_FAST_FAILSAFE
+		if((TIMSK1 & (1<<OCIE1A)) && (TCNT1 == OCR1A)) TIMER1_COMPA_vect();
+#else
+		if((TIMSK1 & (1<<TOIE1)) && (TCNT1 == 0)) TIMER1_OVF_vect();
+#endif
+		if((TCNT1 % steps_per_ms) == 0) {
+			if(TIMSK2 & (1<<OCIE2A)) TIMER2_COMPA_vect();
+			if(control::is_runnable()) control::run();
+		}
+	}
+}
+
+/**
+ * @brief raises an external interrupt only if its sense control matches the edge, like the hardware
+ */
+static void emulate_edge(void (*vect)(void), uint8_t const isc_shift, bool const is_rising) {
+	uint8_t const sense = (EICRA >> isc_shift) & 0x03;
+	if(sense == (is_rising ? 0x03 : 0x02)) vect();
+}
+
+/**
+ * @brief emulates one 20 ms receiver frame, ch2 follows ch1
+ */
+static void emulate_frame(uint16_t const ch1_width, uint16_t const ch2_width) {
+	emulate_edge(&INT0_vect, ISC00, true);
+	advance_timer1(ch1_width);
+	emulate_edge(&INT0_vect, ISC00, false);
+	emulate_edge(&INT1_vect, ISC10, true);
+	advance_timer1(ch2_width);
+	emulate_edge(&INT1_vect, ISC10, false);
+	advance_timer1(TIMER1_STEPS_PER_FRAME - ch1_width - ch2_width);
+}
+
+/**
+ * @brief measures the time between the last pulse of a receiver which drops out and the stop of the motor
+ */
+static void bench_failsafe_reaction(unsigned int const trials) {
+	uint16_t const steps_per_ms = TIMER1_STEPS_PER_FRAME / 20;
+	// 1800 us on ch1 drives the motor, ch2 in neutral position
+	uint16_t const ch1_width = (TIMER1_STEPS_PER_PULSE * 6) / 5;
+	uint16_t const ch2_width = TIMER1_STEPS_PER_PULSE;
+	double min_ms = 1e9, max_ms = 0.0, sum_ms = 0.0;
+	unsigned int stopped = 0;
+	for(unsigned int trial = 0; trial < trials; trial++) {
+		// shift the frames against the periodic checks of the input module
+		advance_timer1((trial * 37UL * steps_per_ms) / 100);
+		for(int frame = 0; frame < 15; frame++) emulate_frame(ch1_width, ch2_width);
+		bool const is_driving = (OCR0A != 0) && ((TCCR0A & ((1<<COM0A1) | (1<<COM0B1))) != 0);
+		if(!is_driving) continue;
+		// the receiver drops out, the last pulse has ended 20 ms - ch1_width - ch2_width ago
+		uint32_t elapsed = TIMER1_STEPS_PER_FRAME - ch1_width - ch2_width;
+		while(elapsed < 1000UL * steps_per_ms && OCR0A != 0) {
+			advance_timer1(steps_per_ms / 10);
+			elapsed += steps_per_ms / 10;
+		}
+		if(OCR0A != 0) continue;
+		double const reaction_ms = static_cast<double>(elapsed) / steps_per_ms;
+		min_ms = std::fmin(min_ms, reaction_ms);
+		max_ms = std::fmax(max_ms, reaction_ms);
+		sum_ms += reaction_ms;
+		stopped++;
+	}
+	std::printf("failsafe (%s): motor stopped in %u of %u trials, %.1f / %.1f / %.1f ms (min / avg / max) after the last pulse\n",
+		USE_FAST_FAILSAFE ? "deadline check" : "pulse count per 262 ms", stopped, trials, min_ms, stopped ? sum_ms / stopped : 0.0, max_ms);
+}
+
+#if USE_MOTOR_RAMP
+/**
+ * @brief benchmarks the timer 0 overflow isr (ramp step), the setpoint is reversed every 256 calls so that the ramp is always moving
+ */
+static void bench_timer0_ovf_vect(unsigned long const iterations) {
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) {
+		if((i & 0xFF) == 0) {
+			motor::set_setpoint(255, (i & 0x100) ? BACKWARD : FORWARD);
+		}
+		TIMER0_OVF_vect();
+	}
+	report("TIMER0_OVF_vect", iterations, std::chrono::steady_clock::now() - start);
+	motor::stop();
+}
+#endif
+
+#if ISR_PROFILING || EVENT_TRACE
+/**
+ * @brief sends a command to the uart and passes it to the modules like the main loop
+ */
+static void send_command(uint8_t const command) {
+	UDR0 = command;
+	USART_RX_vect();
+	uint8_t received = 0;
+	while(uart::read(&received)) {
+#if ISR_PROFILING
+		profiler::handle_command(received);
+#endif
+#if EVENT_TRACE
+		trace::handle_command(received);
+#endif
+	}
+}
+
+/**
+ * @brief polls the dumps like the main loop and writes the transmitted bytes to a file until the transmission has ended
+ */
+static size_t receive_dump(std::FILE *file) {
+	size_t bytes = 0;
+	for(int pass = 0; pass < 1000; pass++) {
+#if ISR_PROFILING
+		profiler::poll();
+#endif
+#if EVENT_TRACE
+		trace::poll();
+#endif
+		while(UCSR0B & (1<<UDRIE0)) {
+			USART_UDRE_vect();
+			if(UCSR0B & (1<<UDRIE0)) {
+				std::fputc(UDR0, file);
+				bytes++;
+			}
+		}
+	}
+	return bytes;
+}
+#endif
+
+#if ISR_PROFILING
+/**
+ * @brief emulates 10 receiver frames and requests the dump of the statistics over the uart, the transmitted bytes are printed
+ * - timer 1 does not advance within the isrs on the host, so only the counts and the main loop values are meaningful here
+ */
+static void bench_profiler() {
+	profiler::reset();
+	for(int frame = 0; frame < 10; frame++) emulate_frame(TIMER1_STEPS_PER_PULSE, TIMER1_STEPS_PER_PULSE);
+	std::printf("profiler dump:\n");
+	send_command('p');
+	receive_dump(stdout);
+}
+#endif
+
+#if EVENT_TRACE
+/**
+ * @brief records a receiver which drops out for 200 ms while the motor is driven and writes the dump of the event trace to TRACE_DUMP_FILE
+ */
+static void bench_trace() {
+	uint16_t const steps_per_ms = TIMER1_STEPS_PER_FRAME / 20;
+	uint16_t const ch1_width = (TIMER1_STEPS_PER_PULSE * 6) / 5;
+	reset_drive(MOTOR_SUPPLY_V, 0.0);
+	for(int frame = 0; frame < 10; frame++) emulate_frame(ch1_width, TIMER1_STEPS_PER_PULSE);
+	advance_timer1(200UL * steps_per_ms);
+	for(int frame = 0; frame < 5; frame++) emulate_frame(TIMER1_STEPS_PER_PULSE, TIMER1_STEPS_PER_PULSE);
+	std::FILE *file = std::fopen(TRACE_DUMP_FILE, "wb");
+	if(file == 0) {
+		std::perror(TRACE_DUMP_FILE);
+		return;
+	}
+	send_command('t');
+	size_t const bytes = receive_dump(file);
+	std::fclose(file);
+	std::printf("event trace: %zu bytes dumped to %s\n", bytes, TRACE_DUMP_FILE);
+	reset_drive(MOTOR_SUPPLY_V, 0.0);
+}
+
+/**
+ * @brief benchmarks the recording of an event from the main context
+ */
+static void bench_trace_write(unsigned long const iterations) {
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	for(unsigned long i = 0; i < iterations; i++) trace::write(TRACE_SET_SPEED, i & 0xFF);
+	report("trace::write", iterations, std::chrono::steady_clock::now() - start);
+}
+#endif
+
+/**
+ * @brief full throttle reversal of the motor model - the adc isr sees the motor current and trips at 30 A like on the target
+ */
+static void bench_motor_reversal() {
+	double peak_current = 0.0, reversal_s = -1.0;
+	unsigned long trips = 0;
+	bool was_enabled = true;
+	reset_drive(MOTOR_SUPPLY_V, 0.0);
+	torque::set_throttle(255);
+	for(unsigned long step = 0; step < 30000; step++) {
+		// full forward for 1 s, then full backward
+		if(step == 10000) torque::set_throttle(-255);
+		emulate_drive_step();
+		bool const is_enabled = (PORTD & (1<<7)) != 0;
+		if(step >= 10000) {
+			if(std::fabs(m_drive.current_a) > peak_current) peak_current = std::fabs(m_drive.current_a);
+			if(was_enabled && !is_enabled) trips++;
+			if(reversal_s < 0.0 && m_drive.back_emf_v < -0.9 * (MOTOR_SUPPLY_V - MOTOR_NO_LOAD_CURRENT_A * MOTOR_RESISTANCE_OHM)) reversal_s = (step - 10000) * DRIVE_STEP_S;
+		}
+		was_enabled = is_enabled;
+	}
+	reset_drive(MOTOR_SUPPLY_V, 0.0);
+	std::printf("full throttle reversal (%s, %s): peak current %.1f A, %lu overcurrent trips, 90 %% of reverse speed after %.0f ms\n",
+		USE_MOTOR_RAMP ? "ramp" : "no ramp", (torque::get_mode() == TORQUE_CLOSED_LOOP) ? "torque control" : "open loop", peak_current, trips, reversal_s * 1000.0);
+}
+
+/**
+ * @brief half throttle with a speed proportional load at a fresh, a half and an empty 3s lipo - the motor current is the torque
+ */
+static void bench_battery_sag() {
+	double const supplies_v[3] = {12.6, 11.1, 9.6};
+	std::printf("half throttle against a load of 2 A/V (%s):\n", (torque::get_mode() == TORQUE_CLOSED_LOOP) ? "torque control" : "open loop");
+	for(int i = 0; i < 3; i++) {
+		reset_drive(supplies_v[i], 2.0);
+		torque::set_throttle(128);
+		double current_sum = 0.0, current_min = 1e9, current_max = 0.0;
+		for(unsigned long step = 0; step < 15000; step++) {
+			emulate_drive_step();
+			if(step >= 10000) {
+				// steady state over the last 0.5 s
+				current_sum += m_drive.current_a;
+				current_min = std::fmin(current_min, m_drive.current_a);
+				current_max = std::fmax(current_max, m_drive.current_a);
+			}
+		}
+		std::printf("  %4.1f V: motor current %5.2f A (%5.2f - %5.2f A), back emf %5.2f V\n", supplies_v[i], current_sum / 5000, current_min, current_max, m_drive.back_emf_v);
+	}
+#if USE_TORQUE_CONTROL
+	// a broken current measurement must not leave the motor at full duty cycle
+	reset_drive(MOTOR_SUPPLY_V, 2.0);
+	torque::set_throttle(128);
+	m_drive.is_sense_broken = true;
+	unsigned long step = 0;
+	for(; step < 10000 && torque::get_mode() == TORQUE_CLOSED_LOOP; step++) emulate_drive_step();
+	std::printf("  broken current sensor: fallback to open loop after %.1f ms\n", step * DRIVE_STEP_S * 1000.0);
+#endif
+	reset_drive(MOTOR_SUPPLY_V, 0.0);
+}
+
+int main(int argc, char **argv) {
+
+	unsigned long const iterations = (argc > 1) ? std::strtoul(argv[1], 0, 10) : DEFAULT_ITERATIONS;
+
+	motor::init();
+	input::init();
+	adc::init();
+#if ISR_PROFILING || EVENT_TRACE
+	uart::init();
+#endif
+#if ISR_PROFILING
+	profiler::init();
+#endif
+	sei();
+
+	std::printf("fwesc host benchmark, %lu iterations per entry\n", iterations);
+
+	bench_int_vect("INT0_vect", &INT0_vect, iterations);
+	bench_int_vect("INT1_vect", &INT1_vect, iterations);
+	bench_adc_vect(iterations);
+#if USE_FAST_FAILSAFE
+	bench_timer1_compa_vect(iterations);
+#else
+	bench_timer1_ovf_vect(iterations);
+#endif
+#if USE_MOTOR_RAMP
+	bench_timer0_ovf_vect(iterations);
+#endif
+	bench_control_run(iterations);
+	compare_mapper_accuracy();
+	bench_mapper(iterations);
+	bench_scheduler(iterations);
+	bench_failsafe_reaction(32);
+	bench_motor_reversal();
+	bench_battery_sag();
+#if ISR_PROFILING
+	bench_profiler();
+#endif
+#if EVENT_TRACE
+	bench_trace_write(iterations);
+	bench_trace();
+#endif
+#if CONTROL_LATENCY_HISTOGRAM
+	// the histogram saturates at 65535 entries per bin
+	bench_control_latency(30000);
+#endif
+
+	return EXIT_SUCCESS;
+}
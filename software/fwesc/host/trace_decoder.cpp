@@ -0,0 +1,190 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief decoder for the event trace of the fw esc (EVENT_TRACE) - reads a dump from a file or requests it from the esc over a serial device and prints a timeline
+ * @file trace_decoder.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "trace.h"
+#include "motor.h"
+#include "adc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* GLOBAL CONSTANT SECTION */
+// the whole dump is expected within this time after the request
+static int const SERIAL_TIMEOUT_MS = 2000;
+static double const TIMER1_STEP_HIGH_RESOLUTION_US = 0.5;
+static double const TIMER1_STEP_US = 4.0;
+static uint32_t const TIMER1_PERIOD_STEPS = 0x10000;
+static char const * const EVENT_NAMES[TRACE_EVENT_COUNT] = {
+	"PULSE_CH1", "PULSE_CH2", "CHANNEL_LOST", "OVERCURRENT", "OVERCURRENT_CLEARED",
+	"SET_SPEED", "SET_DIRECTION", "MOTOR_STOP", "IDLE", "DUMP"
+};
+static char const * const DIRECTION_NAMES[3] = {"FORWARD", "BACKWARD", "BREAK"};
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief reads a complete file
+ */
+static bool read_file(int const fd, std::vector<uint8_t> &dump) {
+	uint8_t buffer[256];
+	ssize_t bytes = 0;
+	while((bytes = read(fd, buffer, sizeof(buffer))) > 0) dump.insert(dump.end(), buffer, buffer + bytes);
+	return bytes == 0;
+}
+
+/**
+ * @brief configures the serial device (115200 baud, 8n1, raw), requests a dump with 't' and reads it until it is complete or the timeout expires
+ */
+static bool read_serial(int const fd, std::vector<uint8_t> &dump) {
+	struct termios tty;
+	if(tcgetattr(fd, &tty) != 0) return false;
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, B115200);
+	cfsetospeed(&tty, B115200);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | PARENB);
+	if(tcsetattr(fd, TCSANOW, &tty) != 0) return false;
+	tcflush(fd, TCIOFLUSH);
+
+	uint8_t const command = 't';
+	if(write(fd, &command, 1) != 1) return false;
+
+	struct pollfd pfd = {fd, POLLIN, 0};
+	size_t expected = 0;
+	while(expected == 0 || dump.size() < expected) {
+		if(poll(&pfd, 1, SERIAL_TIMEOUT_MS) <= 0) return false;
+		uint8_t buffer[256];
+		ssize_t const bytes = read(fd, buffer, sizeof(buffer));
+		if(bytes <= 0) return false;
+		dump.insert(dump.end(), buffer, buffer + bytes);
+		// the header tells the size of the dump
+		for(size_t i = 0; expected == 0 && i + TRACE_DUMP_HEADER_SIZE <= dump.size(); i++) {
+			if(std::memcmp(&dump[i], "FWTR", 4) == 0) expected = i + TRACE_DUMP_HEADER_SIZE + (dump[i + 6] | (dump[i + 7] << 8)) * TRACE_RECORD_SIZE;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief describes the data of a record
+ */
+static void describe(E_TRACE_EVENT const event, uint16_t const data, char *text, size_t const size) {
+	switch(event) {
+	case TRACE_PULSE_CH1:
+	case TRACE_PULSE_CH2:
+		std::snprintf(text, size, (data == TRACE_DATA_MAX) ? ">= %u us" : "%u us", data);
+		break;
+	case TRACE_CHANNEL_LOST:
+		std::snprintf(text, size, "%s%s", (data & 1) ? "ch1 " : "", (data & 2) ? "ch2" : "");
+		break;
+	case TRACE_OVERCURRENT:
+	case TRACE_OVERCURRENT_CLEARED:
+		std::snprintf(text, size, "adc %u (%.1f A)", data, static_cast<double>(data) / adc::CURRENT_SENSE_1_A);
+		break;
+	case TRACE_SET_SPEED:
+		std::snprintf(text, size, "%u", data);
+		break;
+	case TRACE_SET_DIRECTION:
+		std::snprintf(text, size, "%s", (data <= BREAK) ? DIRECTION_NAMES[data] : "?");
+		break;
+	case TRACE_IDLE:
+		std::snprintf(text, size, "no events for %u ms", data);
+		break;
+	case TRACE_DUMP:
+		std::snprintf(text, size, "events of %u ms dropped during a dump", data);
+		break;
+	default:
+		std::snprintf(text, size, "%u", data);
+		break;
+	}
+}
+
+/**
+ * @brief prints the timeline of a dump, the times are relative to the oldest record
+ */
+static bool decode(std::vector<uint8_t> const &dump) {
+	size_t start = 0;
+	while(start + TRACE_DUMP_HEADER_SIZE <= dump.size() && std::memcmp(&dump[start], "FWTR", 4) != 0) start++;
+	if(start + TRACE_DUMP_HEADER_SIZE > dump.size()) {
+		std::fprintf(stderr, "no trace dump found\n");
+		return false;
+	}
+	uint8_t const *header = &dump[start];
+	if(header[4] != TRACE_DUMP_VERSION) {
+		std::fprintf(stderr, "unsupported dump version %u\n", header[4]);
+		return false;
+	}
+	double const step_us = (header[5] & TRACE_FLAG_HIGH_RESOLUTION) ? TIMER1_STEP_HIGH_RESOLUTION_US : TIMER1_STEP_US;
+	size_t const count = header[6] | (header[7] << 8);
+	if(start + TRACE_DUMP_HEADER_SIZE + count * TRACE_RECORD_SIZE > dump.size()) {
+		std::fprintf(stderr, "dump truncated, %zu records announced\n", count);
+		return false;
+	}
+
+	std::printf("%zu records, timer 1 resolution %.1f us\n", count, step_us);
+	std::printf("%12s %12s  %-20s %s\n", "time [ms]", "delta [ms]", "event", "data");
+	uint8_t const *record = header + TRACE_DUMP_HEADER_SIZE;
+	uint64_t time_steps = 0;
+	uint16_t previous_timestamp = 0;
+	for(size_t i = 0; i < count; i++, record += TRACE_RECORD_SIZE) {
+		uint16_t const timestamp = record[0] | (record[1] << 8);
+		uint16_t const event_data = record[2] | (record[3] << 8);
+		E_TRACE_EVENT const event = static_cast<E_TRACE_EVENT>(event_data >> 12);
+		uint16_t const data = event_data & TRACE_DATA_MAX;
+		uint32_t delta_steps = 0;
+		if(i > 0) {
+			delta_steps = static_cast<uint16_t>(timestamp - previous_timestamp);
+			if(event == TRACE_IDLE || event == TRACE_DUMP) {
+				// these records may follow their predecessor after several timer overflows, their data tells the elapsed ms
+				double const expected_steps = data * 1000.0 / step_us;
+				long const overflows = std::lround((expected_steps - delta_steps) / TIMER1_PERIOD_STEPS);
+				if(overflows > 0) delta_steps += static_cast<uint32_t>(overflows) * TIMER1_PERIOD_STEPS;
+			}
+		}
+		time_steps += delta_steps;
+		previous_timestamp = timestamp;
+
+		char text[64];
+		describe(event, data, text, sizeof(text));
+		std::printf("%12.3f %12.3f  %-20s %s\n", time_steps * step_us / 1000.0, delta_steps * step_us / 1000.0,
+			(event < TRACE_EVENT_COUNT) ? EVENT_NAMES[event] : "UNKNOWN", text);
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+
+	if(argc != 2) {
+		std::fprintf(stderr, "usage: %s <dump file | serial device>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int const fd = open(argv[1], O_RDWR | O_NOCTTY);
+	int const fd_read_only = (fd < 0) ? open(argv[1], O_RDONLY) : fd;
+	if(fd_read_only < 0) {
+		std::perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint8_t> dump;
+	bool const is_read = isatty(fd_read_only) ? read_serial(fd_read_only, dump) : read_file(fd_read_only, dump);
+	close(fd_read_only);
+	if(!is_read) {
+		std::fprintf(stderr, "%s: reading the dump failed\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	return decode(dump) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -7,6 +7,9 @@
 
 #include "input.h"
 #include "control.h"
+#include "defines.h"
+#include "profiler.h"
+#include "trace.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
@@ -28,21 +31,57 @@
 #define CH2_TRIGGER_AT_RISING_EDGE()  do { EICRA &= 0x03; EICRA |= (1<<ISC11) | (1<<ISC10); } while(0)
 #define CH2_TRIGGER_AT_FALLING_EDGE() do { EICRA &= 0x03; EICRA |= (1<<ISC11); } while(0)
 
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+// prescaler = 8
+// fTimer = fCPU / 8 = 16 MHz / 8 = 2 MHz
+// tTimerStep = 0.5 us
+// 2^16 * tTimerStep = 32.768 ms
+#define TIMER1_START() do { TCCR1B = (1<<CS11); } while(0)
+#else
+// prescaler = 64
+// fTimer = fCPU / 64 = 16 MHz / 64 = 250 kHz
+// tTimerStep = 4 us
+// 2^16 * tTimerStep = 262.144 ms
+#define TIMER1_START() do { TCCR1B = (1<<CS11) | (1<<CS10); } while(0)
+#endif
+
 /* GLOBAL CONSTANTS */
 static uint8_t const MIN_PULSES_PER_TIMER_CYCLE = 10; // 262 ms / 20 ms = 13 (-3 to give a little room for error)
-static uint16_t const MIN_PULSE_WIDTH_US = 1000;
-static uint16_t const MAX_PULSE_WIDTH_US = 2000;
+static uint16_t const MIN_PULSE_WIDTH = PULSE_WIDTH(1000);
+static uint16_t const MAX_PULSE_WIDTH = PULSE_WIDTH(2000);
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+// one timer step is 0.5 us = 1 pulse width unit, the loss of pulses is checked every 8 overflows = 262 ms
+static uint16_t const PULSE_WIDTH_PER_TIMER_STEP = 1;
+static uint8_t const TIMER_OVERFLOWS_PER_TIMER_CYCLE = 8;
+static uint16_t const TIMER_STEPS_PER_MS = 2000;
+#else
+static uint16_t const PULSE_WIDTH_PER_TIMER_STEP = 4;
+static uint8_t const TIMER_OVERFLOWS_PER_TIMER_CYCLE = 1;
+static uint16_t const TIMER_STEPS_PER_MS = 250;
+#endif
+#if USE_FAST_FAILSAFE
+static uint16_t const FAILSAFE_CHECK_PERIOD_TIMER_STEPS = FAILSAFE_CHECK_PERIOD_MS * TIMER_STEPS_PER_MS;
+// a channel is lost at the first check after FAILSAFE_TIMEOUT_MS - FAILSAFE_CHECK_PERIOD_MS without a valid pulse,
+// so that it is lost within FAILSAFE_TIMEOUT_MS whatever the phase of the checks, i.e. after 50 to 60 ms
+static uint8_t const FAILSAFE_TIMEOUT_CHECKS = (FAILSAFE_TIMEOUT_MS - FAILSAFE_CHECK_PERIOD_MS) / FAILSAFE_CHECK_PERIOD_MS;
+#endif
 
 /* TYPEDEFS */
 typedef enum {RISING, FALLING} E_PULSE_STATE;
 typedef struct {
 	E_PULSE_STATE pulse_state;
 	uint8_t pulses_received;
+	uint8_t checks_without_pulse; // failsafe checks since the last valid pulse
 } s_pulse_property;
 
 /* GLOBAL VARIABLES */
-static s_pulse_property m_ch1_pulse = {RISING, 0};
-static s_pulse_property m_ch2_pulse = {RISING, 0};
+static s_pulse_property m_ch1_pulse = {RISING, 0, 0};
+static s_pulse_property m_ch2_pulse = {RISING, 0, 0};
+
+/* PROTOTYPES */
+#if USE_FAST_FAILSAFE
+bool is_channel_lost(s_pulse_property *pulse);
+#endif
 	
 /* FUNCTIONS */
 
@@ -64,19 +103,24 @@ void input::init() {
 	
 	// clear timer
 	TCNT1 = 0;
+#if USE_FAST_FAILSAFE
+	// schedule the first failsafe check and enable timer 1 compare match a interrupt
+	OCR1A = FAILSAFE_CHECK_PERIOD_TIMER_STEPS;
+	TIFR1 = (1<<OCF1A);
+	TIMSK1 = (1<<OCIE1A);
+#else
 	// enable timer 1 overflow interrupt
 	TIMSK1 = (1<<TOIE1);
-	// prescaler = 8
-	// fTimer = fCPU / 64 = 16 MHz / 64 = 250 kHz
-	// tTimerStep = 4 us
-	// 2^16 * tTimerStep = 262.144 ms
-	TCCR1B = (1<<CS11) | (1<<CS10);
+#endif
+	// start the timer
+	TIMER1_START();
 }
 
 /** 
  * @brief int0 (ch1) interrupt service routine
  */
 ISR(INT0_vect) {
+	PROFILE_ISR(PROFILED_ISR_INT0);
 	static uint16_t start = 0;
 	static uint16_t stop = 0;
 	
@@ -91,13 +135,15 @@ ISR(INT0_vect) {
 		
 		m_ch1_pulse.pulses_received++;
 		
+		// the unsigned difference is correct across one timer overflow, the pulses are much shorter than a timer period
 		uint16_t const pulse_duration_in_timer_steps = stop - start;
-		uint16_t const timerstep_duration_in_us = 4;
-		uint16_t const pulse_duration_in_us = pulse_duration_in_timer_steps * timerstep_duration_in_us;
+		uint16_t const pulse_duration = pulse_duration_in_timer_steps * PULSE_WIDTH_PER_TIMER_STEP;
+		TRACE_EVENT(TRACE_PULSE_CH1, pulse_duration >> PULSE_WIDTH_FRACTIONAL_BITS);
 		
 		// only update when the value is within acceptable bounds
-		if(pulse_duration_in_us >= MIN_PULSE_WIDTH_US && pulse_duration_in_us <= MAX_PULSE_WIDTH_US) {
-			control::update_channel_1(pulse_duration_in_us);
+		if(pulse_duration >= MIN_PULSE_WIDTH && pulse_duration <= MAX_PULSE_WIDTH) {
+			m_ch1_pulse.checks_without_pulse = 0;
+			control::update_channel_1(pulse_duration);
 		}
 	}
 }
@@ -106,6 +152,7 @@ ISR(INT0_vect) {
  * @brief int1 (ch2) interrupt service routine
  */
 ISR(INT1_vect) {
+	PROFILE_ISR(PROFILED_ISR_INT1);
 	static uint16_t start = 0;
 	static uint16_t stop = 0;
 	
@@ -120,25 +167,69 @@ ISR(INT1_vect) {
 		
 		m_ch2_pulse.pulses_received++;
 		
+		// the unsigned difference is correct across one timer overflow, the pulses are much shorter than a timer period
 		uint16_t const pulse_duration_in_timer_steps = stop - start;
-		uint16_t const timerstep_duration_in_us = 4;
-		uint16_t const pulse_duration_in_ms = pulse_duration_in_timer_steps * timerstep_duration_in_us;
+		uint16_t const pulse_duration = pulse_duration_in_timer_steps * PULSE_WIDTH_PER_TIMER_STEP;
+		TRACE_EVENT(TRACE_PULSE_CH2, pulse_duration >> PULSE_WIDTH_FRACTIONAL_BITS);
 		
 		// only update when the value is within acceptable bounds
-		if(pulse_duration_in_ms >= MIN_PULSE_WIDTH_US && pulse_duration_in_ms <= MAX_PULSE_WIDTH_US) {
-			control::update_channel_2(pulse_duration_in_ms);
+		if(pulse_duration >= MIN_PULSE_WIDTH && pulse_duration <= MAX_PULSE_WIDTH) {
+			m_ch2_pulse.checks_without_pulse = 0;
+			control::update_channel_2(pulse_duration);
 		}
 	}
 }
 
+#if USE_FAST_FAILSAFE
+/** 
+ * @brief timer 1 compare match a interrupt service routine - checks the deadlines of the channels every FAILSAFE_CHECK_PERIOD_MS
+ */
+ISR(TIMER1_COMPA_vect) {
+	PROFILE_ISR(PROFILED_ISR_TIMER1);
+	// schedule the next check, timer 1 keeps running freely for the pulse measurement
+	OCR1A += FAILSAFE_CHECK_PERIOD_TIMER_STEPS;
+	bool const ch1_lost = is_channel_lost(&m_ch1_pulse);
+	bool const ch2_lost = is_channel_lost(&m_ch2_pulse);
+	if(ch1_lost || ch2_lost) {
+		TRACE_EVENT(TRACE_CHANNEL_LOST, (ch1_lost ? 1 : 0) | (ch2_lost ? 2 : 0));
+		// inform the control unit about it
+		control::channel_s_lost();
+	}
+	// a lost channel waits for the next rising edge again
+	if(ch1_lost) {
+		m_ch1_pulse.pulse_state = RISING;
+		CH1_TRIGGER_AT_RISING_EDGE();
+	}
+	if(ch2_lost) {
+		m_ch2_pulse.pulse_state = RISING;
+		CH2_TRIGGER_AT_RISING_EDGE();
+	}
+}
+
+/** 
+ * @brief counts a failsafe check without a valid pulse
+ * @return true exactly once when the channel has exceeded its deadline
+ */
+bool is_channel_lost(s_pulse_property *pulse) {
+	if(pulse->checks_without_pulse > FAILSAFE_TIMEOUT_CHECKS) return false;
+	pulse->checks_without_pulse++;
+	return pulse->checks_without_pulse > FAILSAFE_TIMEOUT_CHECKS;
+}
+#else
 /** 
  * @brief timer 1 overflow interrupt service routine
  */
 ISR(TIMER1_OVF_vect) {
+	PROFILE_ISR(PROFILED_ISR_TIMER1);
+	// extend the timer by software so that the loss of pulses is always evaluated every 262 ms
+	static uint8_t overflows = 0;
+	if(++overflows < TIMER_OVERFLOWS_PER_TIMER_CYCLE) return;
+	overflows = 0;
 	// in case there has occured a loss of pulses ...
 	bool const ch1_pulses_lost = m_ch1_pulse.pulses_received < MIN_PULSES_PER_TIMER_CYCLE;
 	bool const ch2_pulses_lost = m_ch2_pulse.pulses_received < MIN_PULSES_PER_TIMER_CYCLE;
 	if(ch1_pulses_lost || ch2_pulses_lost) {
+		TRACE_EVENT(TRACE_CHANNEL_LOST, (ch1_pulses_lost ? 1 : 0) | (ch2_pulses_lost ? 2 : 0));
 		// inform the control unit about it
 		control::channel_s_lost();
 		// update the channel information
@@ -150,4 +241,5 @@ ISR(TIMER1_OVF_vect) {
 	// clear the pulse counters
 	m_ch1_pulse.pulses_received = 0;
 	m_ch2_pulse.pulses_received = 0;
-}
\ No newline at end of file
+}
+#endif
@@ -10,10 +10,17 @@
 #include "input.h"
 #include "control.h"
 #include "adc.h"
+#include "scheduler.h"
+#include "uart.h"
+#include "profiler.h"
+#include "trace.h"
 #include <avr/interrupt.h>
 
 /* PROTOTYPE SECTION */
 void init_application();
+#if ISR_PROFILING || EVENT_TRACE
+void poll_uart();
+#endif
 
 /* FUNCTION SECTION */
 
@@ -22,9 +29,14 @@ int main(void) {
 	init_application();
 	
 	for(;;) {
+		// the control task is polled once per tick instead of busy spinning, the cpu sleeps in between
+		scheduler::wait_for_tick();
 		if(control::is_runnable()) {
 			control::run();
 		}
+#if ISR_PROFILING || EVENT_TRACE
+		poll_uart();
+#endif
 	}
 }
 
@@ -42,6 +54,47 @@ void init_application() {
 	// initialize the adc module
 	adc::init();
 	
+	// initialize the scheduler
+	scheduler::init();
+	
+#if ISR_PROFILING || EVENT_TRACE
+	// initialize the uart for the dumps of the profiling statistics and the event trace
+	uart::init();
+#endif
+#if ISR_PROFILING
+	// initialize the profiler (timer 1 has to run already)
+	profiler::init();
+#endif
+	
 	// globally enable interrupts
 	sei();
-}
\ No newline at end of file
+}
+
+#if ISR_PROFILING || EVENT_TRACE
+/** 
+ * @brief evaluates the commands received over the uart and continues the pending dump - commands are ignored while a dump is sent, so that the dumps do not interleave
+ */
+void poll_uart() {
+	uint8_t command = 0;
+	while(uart::read(&command)) {
+#if ISR_PROFILING
+		if(profiler::is_dumping()) continue;
+#endif
+#if EVENT_TRACE
+		if(trace::is_dumping()) continue;
+#endif
+#if ISR_PROFILING
+		profiler::handle_command(command);
+#endif
+#if EVENT_TRACE
+		trace::handle_command(command);
+#endif
+	}
+#if ISR_PROFILING
+	profiler::poll();
+#endif
+#if EVENT_TRACE
+	trace::poll();
+#endif
+}
+#endif
\ No newline at end of file
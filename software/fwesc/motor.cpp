@@ -6,6 +6,9 @@
  */
 
 #include "motor.h"
+#include "defines.h"
+#include "profiler.h"
+#include "trace.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
@@ -28,12 +31,32 @@
 #define DRIVE_BACKWARD() do { TCCR0A &= 0x0F; TCCR0A |= (1<<COM0B1); IN2_PORT &= ~IN2; } while(0)
 #define DRIVE_BREAK() do { TCCR0A &= 0x0F; IN1_PORT &= ~IN1; IN2_PORT &= ~IN2; } while (0)
 
+#if USE_MOTOR_RAMP
+/* GLOBAL CONSTANT SECTION */
+// the acceleration step is declared in motor.h, the closed loop control changes the duty cycle at the same rate
+static int16_t const RAMP_DECELERATION_STEP = (int16_t)(((uint32_t)(motor::RAMP_VELOCITY_MAX) * motor::RAMP_TICK_US) / ((uint32_t)(MOTOR_RAMP_DECELERATION_MS) * 1000));
+#endif
+
 /* GLOBAL VARIABLE SECTION */
 typedef struct {
 	uint8_t speed;
 	E_MOTOR_DIRECTION dir;
 } s_motor_state;
+#if USE_MOTOR_RAMP
+// m_motor_state is the setpoint of the ramp which is read by the isr, m_ramp_state is the state applied to the h bridge
+static volatile s_motor_state m_motor_state = {0, BREAK};
+static s_motor_state m_ramp_state = {0, BREAK};
+static int16_t m_ramp_velocity = 0;
+#else
 static s_motor_state m_motor_state = {0, BREAK};
+#endif
+
+/* PROTOTYPE SECTION */
+void apply_direction(E_MOTOR_DIRECTION const dir);
+void apply_speed(uint8_t const speed);
+#if USE_MOTOR_RAMP
+int16_t get_ramp_target();
+#endif
 
 /* FUNCTION SECTION */
 
@@ -46,33 +69,102 @@ void motor::init() {
 	IN2_DDR |= IN2;
 	INH_DDR |= INH;
 	// set speed and direction
-	motor::set_direction(m_motor_state.dir);
-	motor::set_speed(m_motor_state.speed);
+	apply_direction(m_motor_state.dir);
+	apply_speed(m_motor_state.speed);
 	// enable the motor
 	INH_PORT |= INH;
 	// enable phase correct timer mode
 	TCCR0A |= (1<<WGM00);
+#if USE_MOTOR_RAMP
+	// enable timer 0 overflow interrupt for the ramp
+	TIFR0 = (1<<TOV0);
+	TIMSK0 |= (1<<TOIE0);
+#endif
 	// enable timer with prescaler 64
 	TCCR0B |= (1<<CS01) | (1<<CS00);
 }
 
 /**
- * @brief set the direction of the motor
+ * @brief set the direction of the motor - with USE_MOTOR_RAMP this is the direction the ramp is heading for
  */
 void motor::set_direction(E_MOTOR_DIRECTION const dir) {
+	if(dir != m_motor_state.dir) TRACE_EVENT(TRACE_SET_DIRECTION, dir);
 	m_motor_state.dir = dir;
-	if(m_motor_state.dir == FORWARD) DRIVE_FORWARD();
-	else if(m_motor_state.dir == BACKWARD) DRIVE_BACKWARD();
-	else if(m_motor_state.dir == BREAK) DRIVE_BREAK();
+#if !USE_MOTOR_RAMP
+	apply_direction(m_motor_state.dir);
+#endif
 }
 
 /**
- * @brief sets the speed of the motor - 255 is full speed, 0 is break
+ * @brief sets the speed of the motor - 255 is full speed, 0 is break - with USE_MOTOR_RAMP this is the speed the ramp is heading for
  */
 void motor::set_speed(uint8_t const speed) {
+	if(speed != m_motor_state.speed) TRACE_EVENT(TRACE_SET_SPEED, speed);
+	m_motor_state.speed = speed;
+#if !USE_MOTOR_RAMP
+	apply_speed(m_motor_state.speed);
+#endif
+}
+
+/**
+ * @brief sets speed and direction of the motor as one setpoint, so that the ramp never heads for the new speed in the old direction - can be called from the isrs and the main context
+ */
+void motor::set_setpoint(uint8_t const speed, E_MOTOR_DIRECTION const dir) {
+	uint8_t const sreg = SREG;
+	cli();
+	set_speed(speed);
+	set_direction(dir);
+	SREG = sreg;
+}
+
+/**
+ * @brief stops the motor immediately (bypassing the ramp) and brakes it - must be called with interrupts disabled, e.g. from an isr
+ */
+void motor::stop() {
+	TRACE_EVENT(TRACE_MOTOR_STOP, 0);
+	m_motor_state.speed = 0;
+	m_motor_state.dir = BREAK;
+#if USE_MOTOR_RAMP
+	m_ramp_velocity = 0;
+#endif
+	apply_speed(0);
+	apply_direction(BREAK);
+}
+
+/**
+ * @brief sets a signed duty cycle (-255 to 255, 0 brakes) immediately, bypassing the ramp - for closed loop control from an isr
+ */
+void motor::set_duty_cycle(int16_t const duty_cycle) {
+	uint8_t const speed = (uint8_t)((duty_cycle < 0) ? (0 - duty_cycle) : duty_cycle);
+	E_MOTOR_DIRECTION const dir = (duty_cycle > 0) ? FORWARD : ((duty_cycle < 0) ? BACKWARD : BREAK);
+#if USE_MOTOR_RAMP
+	// the ramp continues from here when the open loop control takes over again
+	m_ramp_velocity = duty_cycle * (1 << RAMP_FRACTIONAL_BITS);
+	E_MOTOR_DIRECTION const applied_dir = m_ramp_state.dir;
+#else
+	E_MOTOR_DIRECTION const applied_dir = m_motor_state.dir;
+#endif
 	m_motor_state.speed = speed;
-	OCR0A = m_motor_state.speed;
-	OCR0B = m_motor_state.speed;
+	m_motor_state.dir = dir;
+	apply_speed(speed);
+	// the output compare pins are only reconnected when the direction changes
+	if(dir != applied_dir) apply_direction(dir);
+}
+
+/**
+ * @brief returns the signed duty cycle which is applied to the h bridge (-255 to 255, 0 brakes)
+ */
+int16_t motor::get_duty_cycle() {
+#if USE_MOTOR_RAMP
+	uint8_t const speed = m_ramp_state.speed;
+	E_MOTOR_DIRECTION const dir = m_ramp_state.dir;
+#else
+	uint8_t const speed = m_motor_state.speed;
+	E_MOTOR_DIRECTION const dir = m_motor_state.dir;
+#endif
+	if(dir == FORWARD) return speed;
+	else if(dir == BACKWARD) return 0 - (int16_t)(speed);
+	return 0;
 }
 
 /**
@@ -88,3 +180,79 @@ void motor::disable() {
 void motor::enable() {
 	INH_PORT |= INH;
 }
+
+/**
+ * @brief drives the h bridge in the given direction
+ */
+void apply_direction(E_MOTOR_DIRECTION const dir) {
+#if USE_MOTOR_RAMP
+	m_ramp_state.dir = dir;
+#endif
+	if(dir == FORWARD) DRIVE_FORWARD();
+	else if(dir == BACKWARD) DRIVE_BACKWARD();
+	else if(dir == BREAK) DRIVE_BREAK();
+}
+
+/**
+ * @brief sets the pwm duty cycle of the h bridge
+ */
+void apply_speed(uint8_t const speed) {
+#if USE_MOTOR_RAMP
+	m_ramp_state.speed = speed;
+#endif
+	OCR0A = speed;
+	OCR0B = speed;
+}
+
+#if USE_MOTOR_RAMP
+/**
+ * @brief timer 0 overflow interrupt service routine - moves the velocity one step towards the setpoint
+ * the magnitude grows by at most RAMP_ACCELERATION_STEP and shrinks by at most RAMP_DECELERATION_STEP per tick, a reversal decelerates to zero first
+ */
+ISR(TIMER0_OVF_vect) {
+	PROFILE_ISR(PROFILED_ISR_TIMER0_OVF);
+	int16_t const target = get_ramp_target();
+	int16_t velocity = m_ramp_velocity;
+	if(velocity == target) return;
+	
+	if(velocity > 0 && target < velocity) {
+		// forward and slowing down - stop at zero, the reversal continues with the next tick
+		velocity = (velocity > RAMP_DECELERATION_STEP) ? (velocity - RAMP_DECELERATION_STEP) : 0;
+		if(velocity < target) velocity = target;
+	} else if(velocity < 0 && target > velocity) {
+		// backward and slowing down
+		velocity = (velocity < -RAMP_DECELERATION_STEP) ? (velocity + RAMP_DECELERATION_STEP) : 0;
+		if(velocity > target) velocity = target;
+	} else if(target > velocity) {
+		// speeding up forward (from zero or a lower forward velocity)
+		velocity = (target - velocity > motor::RAMP_ACCELERATION_STEP) ? (velocity + motor::RAMP_ACCELERATION_STEP) : target;
+	} else {
+		// speeding up backward
+		velocity = (velocity - target > motor::RAMP_ACCELERATION_STEP) ? (velocity - motor::RAMP_ACCELERATION_STEP) : target;
+	}
+	m_ramp_velocity = velocity;
+	
+	// the h bridge is braked while the velocity passes zero, the output compare pins are only reconnected when the direction changes
+	E_MOTOR_DIRECTION dir = BREAK;
+	if(velocity > 0) {
+		dir = FORWARD;
+		apply_speed((uint8_t)(velocity >> motor::RAMP_FRACTIONAL_BITS));
+	} else if(velocity < 0) {
+		dir = BACKWARD;
+		apply_speed((uint8_t)((0 - velocity) >> motor::RAMP_FRACTIONAL_BITS));
+	} else {
+		apply_speed(0);
+	}
+	if(dir != m_ramp_state.dir) apply_direction(dir);
+}
+
+/**
+ * @brief the setpoint of the ramp as signed velocity in Q8.7 format
+ */
+int16_t get_ramp_target() {
+	int16_t const speed = (int16_t)(m_motor_state.speed) << motor::RAMP_FRACTIONAL_BITS;
+	if(m_motor_state.dir == FORWARD) return speed;
+	else if(m_motor_state.dir == BACKWARD) return 0 - speed;
+	return 0;
+}
+#endif
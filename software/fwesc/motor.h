@@ -9,11 +9,19 @@
 #define MOTOR_H_
 
 #include <stdint.h>
+#include "defines.h"
 
 typedef enum {FORWARD = 0, BACKWARD = 1, BREAK = 2} E_MOTOR_DIRECTION;
 
 class motor {
 public:
+	// the ramp velocity is the signed duty cycle in Q8.7 format, so that +/- 255 fits into an int16_t
+	static uint8_t const RAMP_FRACTIONAL_BITS = 7;
+	static int16_t const RAMP_VELOCITY_MAX = (int16_t)(255) << RAMP_FRACTIONAL_BITS;
+	// timer 0 overflows every 2 * 255 * 64 / 16 MHz = 2040 us in phase correct mode with prescaler 64, the ramp takes one step per overflow
+	static uint32_t const RAMP_TICK_US = 2040;
+	static int16_t const RAMP_ACCELERATION_STEP = (int16_t)(((uint32_t)(RAMP_VELOCITY_MAX) * RAMP_TICK_US) / ((uint32_t)(MOTOR_RAMP_ACCELERATION_MS) * 1000));
+
 	/** 
 	* @brief initializes this module
 	 */
@@ -28,6 +36,26 @@ public:
 	* @brief sets the speed of the motor - 255 is full speed, 0 is stop
 	*/
 	static void set_speed(uint8_t const speed);
+
+	/**
+	* @brief sets speed and direction of the motor as one setpoint, so that the ramp never heads for the new speed in the old direction - can be called from the isrs and the main context
+	*/
+	static void set_setpoint(uint8_t const speed, E_MOTOR_DIRECTION const dir);
+	
+	/**
+	 * @brief stops the motor immediately (bypassing the ramp) and brakes it - must be called with interrupts disabled, e.g. from an isr
+	 */
+	static void stop();
+	
+	/**
+	 * @brief sets a signed duty cycle (-255 to 255, 0 brakes) immediately, bypassing the ramp - for closed loop control from an isr
+	 */
+	static void set_duty_cycle(int16_t const duty_cycle);
+	
+	/**
+	 * @brief returns the signed duty cycle which is applied to the h bridge (-255 to 255, 0 brakes)
+	 */
+	static int16_t get_duty_cycle();
 	
 	/**
 	 * @brief disables the h bridge in case of e.g. over current
@@ -0,0 +1,256 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module measures the execution times of the isrs and the utilization of the main loop with timer 1 (ISR_PROFILING) and dumps them over the uart
+ * @file profiler.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "profiler.h"
+#include "uart.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* GLOBAL CONSTANTS */
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+static uint16_t const CYCLES_PER_TIMER1_STEP = 8;
+#else
+static uint16_t const CYCLES_PER_TIMER1_STEP = 64;
+#endif
+// the overhead of the instrumentation is averaged over several runs since it is below the resolution of timer 1
+static uint8_t const CALIBRATION_RUNS = 64;
+// header, one line per isr, load, main loop and overhead
+static uint8_t const DUMP_LINES = PROFILED_ISR_COUNT + 3;
+// without the line end
+static uint8_t const LINE_LENGTH_MAX = 48;
+static char const * const ISR_NAMES[PROFILED_ISR_COUNT] = {"INT0", "INT1", "ADC", "TIMER0_OVF", "TIMER1", "TIMER2_COMPA", "USART_RX", "USART_UDRE"};
+
+/* TYPEDEFS */
+typedef struct {
+	uint32_t elapsed; // timer 1 steps since the last reset
+	uint32_t idle; // sleeping without the isrs which have woken up the cpu
+	uint16_t longest_pass; // longest time between two sleeps, i.e. the main loop pass including its isrs
+} s_load;
+
+/* GLOBAL VARIABLES */
+static volatile s_isr_profile m_isr_profile[PROFILED_ISR_COUNT];
+static volatile uint32_t m_isr_steps = 0;
+// the main loop values are only accessed with interrupts disabled
+static s_load m_load = {0, 0, 0};
+static uint16_t m_last_timestamp = 0;
+static uint16_t m_sleep_timestamp = 0;
+static uint32_t m_isr_steps_at_sleep = 0;
+static uint16_t m_overhead_cycles = 0;
+static uint8_t m_dump_line = 0; // next line of a pending dump + 1, 0 = no dump pending
+
+/* PROTOTYPES */
+void advance_elapsed(uint16_t const now);
+uint8_t format_line(uint8_t const line, char *buffer);
+uint8_t append_string(char *buffer, uint8_t length, char const *string);
+uint8_t append_decimal(char *buffer, uint8_t length, uint32_t value);
+uint8_t append_permille(char *buffer, uint8_t length, uint32_t part, uint32_t total);
+
+/* FUNCTIONS */
+
+/**
+ * @brief initializes the profiler and measures its own overhead - the uart has to be initialized before
+ */
+void profiler::init() {
+	cli();
+	uint16_t const start = TCNT1;
+	for(uint8_t i = 0; i < CALIBRATION_RUNS; i++) {
+		PROFILE_ISR(PROFILED_ISR_INT0);
+	}
+	uint16_t const duration = TCNT1 - start;
+	m_overhead_cycles = (uint16_t)(((uint32_t)(duration) * CYCLES_PER_TIMER1_STEP) / CALIBRATION_RUNS);
+	sei();
+	profiler::reset();
+}
+
+/**
+ * @brief records one execution of an isr - only to be called within isr context
+ */
+void profiler::record(E_PROFILED_ISR const isr, uint16_t const duration) {
+	volatile s_isr_profile *profile = &m_isr_profile[isr];
+	if(profile->count == 0 || duration < profile->min) profile->min = duration;
+	if(duration > profile->max) profile->max = duration;
+	profile->sum += duration;
+	profile->count++;
+	m_isr_steps += duration;
+}
+
+/**
+ * @brief marks the begin of a sleep of the main loop - to be called with interrupts disabled
+ */
+void profiler::sleep_begin() {
+	uint16_t const now = TCNT1;
+	uint16_t const pass = now - m_last_timestamp;
+	if(pass > m_load.longest_pass) m_load.longest_pass = pass;
+	advance_elapsed(now);
+	m_sleep_timestamp = now;
+	m_isr_steps_at_sleep = m_isr_steps;
+}
+
+/**
+ * @brief marks the end of a sleep of the main loop - to be called with interrupts disabled
+ */
+void profiler::sleep_end() {
+	uint16_t const now = TCNT1;
+	advance_elapsed(now);
+	uint16_t const slept = now - m_sleep_timestamp;
+	uint32_t const isr_steps = m_isr_steps - m_isr_steps_at_sleep;
+	if(slept > isr_steps) m_load.idle += slept - isr_steps;
+}
+
+/**
+ * @brief evaluates a command received over the uart - 'p' dumps the statistics, 'r' resets them
+ */
+void profiler::handle_command(uint8_t const command) {
+	if(command == 'p' && m_dump_line == 0) m_dump_line = 1;
+	else if(command == 'r') profiler::reset();
+}
+
+/**
+ * @brief continues a pending dump without blocking
+ */
+void profiler::poll() {
+	// one line per call, only when it fits into the transmit buffer completely
+	if(m_dump_line == 0 || uart::get_tx_free() < LINE_LENGTH_MAX + 2) return;
+	char line[LINE_LENGTH_MAX + 2];
+	uint8_t const length = format_line(m_dump_line - 1, line);
+	uart::write((uint8_t const *)(line), length);
+	m_dump_line = (m_dump_line < DUMP_LINES) ? (m_dump_line + 1) : 0;
+}
+
+/**
+ * @brief returns true while a dump is sent
+ */
+bool profiler::is_dumping() {
+	return m_dump_line != 0;
+}
+
+/**
+ * @brief returns a consistent copy of the statistics of one isr
+ */
+void profiler::get_isr_profile(E_PROFILED_ISR const isr, s_isr_profile *profile) {
+	cli();
+	profile->count = m_isr_profile[isr].count;
+	profile->sum = m_isr_profile[isr].sum;
+	profile->min = m_isr_profile[isr].min;
+	profile->max = m_isr_profile[isr].max;
+	sei();
+}
+
+/**
+ * @brief clears all statistics
+ */
+void profiler::reset() {
+	cli();
+	for(uint8_t i = 0; i < PROFILED_ISR_COUNT; i++) {
+		m_isr_profile[i].count = 0;
+		m_isr_profile[i].sum = 0;
+		m_isr_profile[i].min = 0;
+		m_isr_profile[i].max = 0;
+	}
+	m_isr_steps = 0;
+	m_isr_steps_at_sleep = 0;
+	m_load.elapsed = 0;
+	m_load.idle = 0;
+	m_load.longest_pass = 0;
+	m_last_timestamp = TCNT1;
+	m_sleep_timestamp = m_last_timestamp;
+	sei();
+}
+
+/**
+ * @brief accumulates the elapsed time, it has to be called at least once per timer 1 period
+ */
+void advance_elapsed(uint16_t const now) {
+	m_load.elapsed += (uint16_t)(now - m_last_timestamp);
+	m_last_timestamp = now;
+}
+
+/**
+ * @brief formats one line of the dump, all times are in cpu cycles with the resolution of timer 1
+ * @return length of the line including the line end, at most LINE_LENGTH_MAX + 2
+ */
+uint8_t format_line(uint8_t const line, char *buffer) {
+	uint8_t length = 0;
+	if(line == 0) {
+		length = append_string(buffer, length, "isr count min avg max [cycles]");
+	} else if(line <= PROFILED_ISR_COUNT) {
+		s_isr_profile profile;
+		profiler::get_isr_profile((E_PROFILED_ISR)(line - 1), &profile);
+		uint32_t const avg = (profile.count > 0) ? (profile.sum / profile.count) : 0;
+		length = append_string(buffer, length, ISR_NAMES[line - 1]);
+		length = append_string(buffer, length, " ");
+		length = append_decimal(buffer, length, profile.count);
+		length = append_string(buffer, length, " ");
+		length = append_decimal(buffer, length, (uint32_t)(profile.min) * CYCLES_PER_TIMER1_STEP);
+		length = append_string(buffer, length, " ");
+		length = append_decimal(buffer, length, avg * CYCLES_PER_TIMER1_STEP);
+		length = append_string(buffer, length, " ");
+		length = append_decimal(buffer, length, (uint32_t)(profile.max) * CYCLES_PER_TIMER1_STEP);
+	} else {
+		cli();
+		s_load const load = m_load;
+		uint32_t const isr_steps = m_isr_steps;
+		sei();
+		if(line == PROFILED_ISR_COUNT + 1) {
+			// the isrs which wake up the cpu are accounted as isr time, not as idle time
+			uint32_t const busy = load.idle + isr_steps;
+			uint32_t const main_loop = (load.elapsed > busy) ? (load.elapsed - busy) : 0;
+			length = append_string(buffer, length, "load isr ");
+			length = append_permille(buffer, length, isr_steps, load.elapsed);
+			length = append_string(buffer, length, " main ");
+			length = append_permille(buffer, length, main_loop, load.elapsed);
+			length = append_string(buffer, length, " idle ");
+			length = append_permille(buffer, length, load.idle, load.elapsed);
+			length = append_string(buffer, length, " %");
+		} else {
+			length = append_string(buffer, length, "longest pass ");
+			length = append_decimal(buffer, length, (uint32_t)(load.longest_pass) * CYCLES_PER_TIMER1_STEP);
+			length = append_string(buffer, length, " overhead ");
+			length = append_decimal(buffer, length, m_overhead_cycles);
+		}
+	}
+	buffer[length++] = '\r';
+	buffer[length++] = '\n';
+	return length;
+}
+
+/**
+ * @brief appends a string to the line buffer, the line is truncated at LINE_LENGTH_MAX
+ */
+uint8_t append_string(char *buffer, uint8_t length, char const *string) {
+	while(*string != 0 && length < LINE_LENGTH_MAX) buffer[length++] = *string++;
+	return length;
+}
+
+/**
+ * @brief appends the decimal representation of value to the line buffer
+ */
+uint8_t append_decimal(char *buffer, uint8_t length, uint32_t value) {
+	char digits[10];
+	uint8_t count = 0;
+	do {
+		digits[count++] = (char)('0' + (value % 10));
+		value /= 10;
+	} while(value != 0);
+	while(count > 0 && length < LINE_LENGTH_MAX) buffer[length++] = digits[--count];
+	return length;
+}
+
+/**
+ * @brief appends part / total as percentage with one decimal to the line buffer
+ */
+uint8_t append_permille(char *buffer, uint8_t length, uint32_t part, uint32_t total) {
+	// scale down so that part * 1000 fits into 32 bit
+	while(total > 0x3FFFFFUL) {
+		total >>= 1;
+		part >>= 1;
+	}
+	uint32_t const permille = (total > 0) ? ((part * 1000) / total) : 0;
+	length = append_decimal(buffer, length, permille / 10);
+	length = append_string(buffer, length, ".");
+	return append_decimal(buffer, length, permille % 10);
+}
@@ -0,0 +1,104 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module measures the execution times of the isrs and the utilization of the main loop with timer 1 (ISR_PROFILING) and dumps them over the uart
+ * @file profiler.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "defines.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+
+typedef enum {
+	PROFILED_ISR_INT0 = 0,
+	PROFILED_ISR_INT1,
+	PROFILED_ISR_ADC,
+	PROFILED_ISR_TIMER0_OVF,
+	PROFILED_ISR_TIMER1, // compare match a (failsafe) or overflow
+	PROFILED_ISR_TIMER2_COMPA,
+	PROFILED_ISR_USART_RX,
+	PROFILED_ISR_USART_UDRE,
+	PROFILED_ISR_COUNT
+} E_PROFILED_ISR;
+
+typedef struct {
+	uint32_t count;
+	uint32_t sum; // timer 1 steps
+	uint16_t min;
+	uint16_t max;
+} s_isr_profile;
+
+class profiler {
+public:
+	/**
+	 * @brief initializes the profiler and measures its own overhead - the uart has to be initialized before
+	 */
+	static void init();
+
+	/**
+	 * @brief records one execution of an isr - only to be called within isr context
+	 */
+	static void record(E_PROFILED_ISR const isr, uint16_t const duration);
+
+	/**
+	 * @brief marks the begin and the end of a sleep of the main loop - to be called with interrupts disabled
+	 */
+	static void sleep_begin();
+	static void sleep_end();
+
+	/**
+	 * @brief evaluates a command received over the uart - 'p' dumps the statistics, 'r' resets them
+	 */
+	static void handle_command(uint8_t const command);
+
+	/**
+	 * @brief continues a pending dump without blocking
+	 */
+	static void poll();
+
+	/**
+	 * @brief returns true while a dump is sent
+	 */
+	static bool is_dumping();
+
+	/**
+	 * @brief returns a consistent copy of the statistics of one isr
+	 */
+	static void get_isr_profile(E_PROFILED_ISR const isr, s_isr_profile *profile);
+
+	/**
+	 * @brief clears all statistics
+	 */
+	static void reset();
+
+private:
+	/**
+	 * @brief Constructor
+	 */
+	profiler() { }
+};
+
+#if ISR_PROFILING
+/**
+ * @brief measures the time from its construction to the end of the enclosing scope, i.e. also isrs which return early
+ */
+class isr_profiling_scope {
+public:
+	isr_profiling_scope(E_PROFILED_ISR const isr) : m_isr(isr), m_start(TCNT1) { }
+	~isr_profiling_scope() { profiler::record(m_isr, TCNT1 - m_start); }
+private:
+	E_PROFILED_ISR const m_isr;
+	uint16_t const m_start;
+};
+
+// first statement of a profiled isr
+#define PROFILE_ISR(isr) isr_profiling_scope isr_profiling_scope_instance(isr)
+#else
+#define PROFILE_ISR(isr) do { } while(0)
+#endif
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,91 @@
+/** 
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module provides a fixed rate tick for the main loop and lets the cpu sleep in idle mode in between
+ * @file scheduler.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "scheduler.h"
+#include "profiler.h"
+#include "trace.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+/* GLOBAL CONSTANTS */
+// prescaler = 64
+// fTimer = fCPU / 64 = 16 MHz / 64 = 250 kHz
+// tTick = (OCR2A + 1) / fTimer = 250 / 250 kHz = 1 ms
+static uint8_t const TIMER2_COMPARE_VALUE = 249;
+
+/* GLOBAL VARIABLES */
+static volatile uint8_t m_pending_ticks = 0;
+static uint16_t m_overrun_count = 0;
+
+/* FUNCTIONS */
+
+/**
+ * @brief initializes the scheduler - timer 2 generates a tick every 1 ms
+ */
+void scheduler::init() {
+	// clear timer on compare match mode
+	TCCR2A = (1<<WGM21);
+	OCR2A = TIMER2_COMPARE_VALUE;
+	TCNT2 = 0;
+	// enable the compare match interrupt
+	TIMSK2 = (1<<OCIE2A);
+	// the other peripherals keep running in idle mode
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	// start the timer with prescaler 64
+	TCCR2B = (1<<CS22);
+}
+
+/** 
+ * @brief sleeps in idle mode until the next tick
+ */
+uint8_t scheduler::wait_for_tick() {
+	cli();
+	while(m_pending_ticks == 0) {
+		// the instruction following sei is always executed before an interrupt, so no tick can get lost between the check and sleep_cpu
+#if ISR_PROFILING
+		profiler::sleep_begin();
+#endif
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+#if ISR_PROFILING
+		profiler::sleep_end();
+#endif
+	}
+	uint8_t const ticks = m_pending_ticks;
+	m_pending_ticks = 0;
+	sei();
+	
+	if(ticks > 1) {
+		uint16_t const overrun_count = m_overrun_count + (ticks - 1);
+		// saturate instead of wrapping around
+		m_overrun_count = (overrun_count < m_overrun_count) ? 0xFFFF : overrun_count;
+	}
+	return ticks;
+}
+
+/** 
+ * @brief returns the number of ticks which have been missed by the main loop since init
+ */
+uint16_t scheduler::get_overrun_count() {
+	return m_overrun_count;
+}
+
+/** 
+ * @brief timer 2 compare match a interrupt service routine
+ */
+ISR(TIMER2_COMPA_vect) {
+	PROFILE_ISR(PROFILED_ISR_TIMER2_COMPA);
+	// the counter saturates, the overrun count is a lower bound when the main loop stalls for more than 255 ms
+	if(m_pending_ticks < 0xFF) m_pending_ticks++;
+#if EVENT_TRACE
+	trace::tick();
+#endif
+}
@@ -0,0 +1,39 @@
+/** 
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module provides a fixed rate tick for the main loop and lets the cpu sleep in idle mode in between
+ * @file scheduler.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+class scheduler {
+public:
+	/**
+	 * @brief initializes the scheduler - timer 2 generates a tick every 1 ms
+	 */
+	static void init();
+	
+	/** 
+	 * @brief sleeps in idle mode until the next tick
+	 * @return number of ticks elapsed since the last call, more than 1 means the main loop has overrun its period
+	 */
+	static uint8_t wait_for_tick();
+	
+	/** 
+	 * @brief returns the number of ticks which have been missed by the main loop since init
+	 */
+	static uint16_t get_overrun_count();
+	
+private:
+	/** 
+	 * @brief Constructor
+	 */
+	scheduler() { }
+	
+};
+
+#endif /* SCHEDULER_H_ */
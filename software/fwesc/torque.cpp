@@ -0,0 +1,205 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module implements the closed loop control of the motor current (torque) with a fallback to the open loop control of the duty cycle
+ * @file torque.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "torque.h"
+#include "motor.h"
+#include "adc.h"
+#include "defines.h"
+
+/* GLOBAL CONSTANT SECTION */
+static int16_t const DUTY_CYCLE_MAX = 255;
+static int32_t const CURRENT_MAX = (int32_t)(TORQUE_CURRENT_MAX_A) * adc::CURRENT_SENSE_1_A;
+// gains in Q8 format - duty cycle steps per adc step of the error and per adc step of the error and sample
+static int16_t const KP = 16;
+static int16_t const KI = 6;
+// the integral part is kept in Q7 format, so that +/- 255 fits into an int16_t
+static uint8_t const INTEGRAL_FRACTIONAL_BITS = 7;
+static int16_t const INTEGRAL_MAX = DUTY_CYCLE_MAX << INTEGRAL_FRACTIONAL_BITS;
+// the adc samples the input 1.5 adc clocks = 12 us = 3 timer 0 steps after the start of the conversion
+static uint8_t const SAMPLE_DELAY_TIMER_STEPS = 3;
+// a motor driven with full duty cycle draws at least its no load current, less means a broken current measurement
+static uint16_t const PLAUSIBLE_CURRENT = adc::CURRENT_SENSE_1_A / 2;
+static uint8_t const IMPLAUSIBLE_SAMPLES_MAX = 250;
+// the adc converts a sample in 13 adc clocks = 104 us at 125 kHz - the duty cycle changes at most as fast as the ramp accelerates
+static uint32_t const SAMPLE_US = 104;
+static int16_t const OUTPUT_STEP = (int16_t)(((uint32_t)(motor::RAMP_ACCELERATION_STEP) * SAMPLE_US) / motor::RAMP_TICK_US);
+
+/* TYPEDEF SECTION */
+typedef struct {
+	E_TORQUE_MODE mode;
+	bool is_active; // false after stop() until the next throttle
+	bool is_braking; // the ramp decelerates the motor, see update()
+	int16_t duty_cycle; // applied to the h bridge
+	int16_t output; // duty cycle in Q8.7 format, it follows the target output with at most OUTPUT_STEP per sample
+	int16_t target_output; // in Q8.7 format, updated by the pi controller with every usable sample
+	int16_t integral;
+	uint8_t implausible_samples;
+} s_torque_data;
+
+/* GLOBAL VARIABLE SECTION */
+static volatile s_torque_data m_torque_data = {
+#if USE_TORQUE_CONTROL
+	TORQUE_CLOSED_LOOP,
+#else
+	TORQUE_OPEN_LOOP,
+#endif
+	false, false, 0, 0, 0, 0, 0};
+// the current setpoint is written by the main context into the slot which is not read by the isr, then the slots are swapped with a single byte write
+static volatile int16_t m_target_current[2] = {0, 0};
+static volatile uint8_t m_target_current_slot = 0;
+
+/* PROTOTYPE SECTION */
+void apply_open_loop(int16_t const throttle);
+void fall_back_to_open_loop();
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief sets the throttle (-255 to 255) - it is the setpoint of the motor current in closed loop mode and the duty cycle in open loop mode
+ */
+void torque::set_throttle(int16_t const throttle) {
+	if(m_torque_data.mode == TORQUE_OPEN_LOOP) {
+		apply_open_loop(throttle);
+		return;
+	}
+	uint8_t const slot = m_target_current_slot ^ 1;
+	m_target_current[slot] = (int16_t)(((int32_t)(throttle) * CURRENT_MAX) / DUTY_CYCLE_MAX);
+	m_target_current_slot = slot;
+	m_torque_data.is_active = true;
+}
+
+/**
+ * @brief stops the closed loop control until the next throttle is set - only to be called within isr context
+ */
+void torque::stop() {
+	m_torque_data.is_active = false;
+	m_torque_data.is_braking = false;
+	m_torque_data.duty_cycle = 0;
+	m_torque_data.output = 0;
+	m_torque_data.target_output = 0;
+	m_torque_data.integral = 0;
+	m_torque_data.implausible_samples = 0;
+}
+
+/**
+ * @brief performs one step of the current control - to be called by the adc isr for every sample
+ */
+void torque::update(bool const is_forward_sensor, uint16_t const current, uint8_t const pwm_phase) {
+	if(m_torque_data.mode != TORQUE_CLOSED_LOOP || !m_torque_data.is_active) return;
+
+	int16_t const target_current = m_target_current[m_target_current_slot];
+	int16_t duty_cycle = m_torque_data.duty_cycle;
+	if((duty_cycle > 0 && target_current < 0) || (duty_cycle < 0 && target_current > 0) || m_torque_data.is_braking) {
+		// a braking current flows backwards through the high side switch and is not seen by the current sensors -
+		// the ramp decelerates the motor to zero duty cycle and the closed loop control starts over from there
+		if(!m_torque_data.is_braking) {
+			m_torque_data.is_braking = true;
+			motor::set_setpoint(0, BREAK);
+		}
+		duty_cycle = motor::get_duty_cycle();
+		m_torque_data.duty_cycle = duty_cycle;
+		m_torque_data.output = 0;
+		m_torque_data.target_output = 0;
+		if(duty_cycle != 0) return;
+		m_torque_data.is_braking = false;
+		m_torque_data.integral = 0;
+	}
+
+	// the current sensors only see the current through the high side switch of their half bridge, i.e. during the on time of the pwm
+	uint8_t const on_time = (uint8_t)((duty_cycle < 0) ? (0 - duty_cycle) : duty_cycle);
+	bool is_sampled = true;
+	int16_t measured_current = 0;
+	if(on_time <= SAMPLE_DELAY_TIMER_STEPS) {
+		// braked or too short on time to sample it, the current is small enough to be taken as zero
+		measured_current = 0;
+	} else if(is_forward_sensor != (duty_cycle > 0)) {
+		// sensor of the passive half bridge
+		is_sampled = false;
+	} else if(on_time != DUTY_CYCLE_MAX && (uint16_t)(pwm_phase) + SAMPLE_DELAY_TIMER_STEPS >= on_time) {
+		// the output is high while timer 0 is below the compare value - the sample has been taken during the off time
+		is_sampled = false;
+	} else {
+		measured_current = (duty_cycle > 0) ? (int16_t)(current) : (0 - (int16_t)(current));
+	}
+
+	int16_t output = m_torque_data.output;
+	if(is_sampled) {
+		// pi controller
+		int16_t const error = target_current - measured_current;
+		int16_t const proportional = (int16_t)(((int32_t)(error) * KP) >> 8);
+		int16_t integral = m_torque_data.integral;
+		int16_t target_output = proportional + (integral >> INTEGRAL_FRACTIONAL_BITS);
+		if(target_output > DUTY_CYCLE_MAX) target_output = DUTY_CYCLE_MAX;
+		if(target_output < -DUTY_CYCLE_MAX) target_output = -DUTY_CYCLE_MAX;
+		// anti windup - the integral part is frozen while the output is saturated or lags behind in the direction of the error
+		bool const is_saturated = (target_output == DUTY_CYCLE_MAX && error > 0) || (target_output == -DUTY_CYCLE_MAX && error < 0);
+		int16_t const target = target_output * (1 << motor::RAMP_FRACTIONAL_BITS);
+		bool const is_lagging = (error > 0) ? (target - output > OUTPUT_STEP) : (output - target > OUTPUT_STEP);
+		// above the maximum current (e.g. the back emf adds to the supply after a reversal) the integral part is frozen too and the output is pulled back
+		bool const is_overcurrent = (measured_current > CURRENT_MAX) || (measured_current < -CURRENT_MAX);
+		if(!is_saturated && !is_lagging && !is_overcurrent) {
+			int32_t const next_integral = (int32_t)(integral) + (((int32_t)(error) * KI) >> (8 - INTEGRAL_FRACTIONAL_BITS));
+			if(next_integral > INTEGRAL_MAX) integral = INTEGRAL_MAX;
+			else if(next_integral < -INTEGRAL_MAX) integral = -INTEGRAL_MAX;
+			else integral = (int16_t)(next_integral);
+			m_torque_data.integral = integral;
+		}
+		m_torque_data.target_output = is_overcurrent ? 0 : target;
+
+		// plausibility check of the current measurement - a motor driven with full duty cycle draws current
+		if(is_saturated && on_time == DUTY_CYCLE_MAX && current < PLAUSIBLE_CURRENT) {
+			if(++m_torque_data.implausible_samples >= IMPLAUSIBLE_SAMPLES_MAX) {
+				fall_back_to_open_loop();
+				return;
+			}
+		} else {
+			m_torque_data.implausible_samples = 0;
+		}
+	}
+
+	// the output follows the target output with the acceleration of the ramp, also with the samples which can not be used by the controller
+	int16_t const target_output = m_torque_data.target_output;
+	if(target_output - output > OUTPUT_STEP) output += OUTPUT_STEP;
+	else if(output - target_output > OUTPUT_STEP) output -= OUTPUT_STEP;
+	else output = target_output;
+	m_torque_data.output = output;
+	// the magnitude is scaled back to the duty cycle like the ramp velocity and the sign is applied afterwards
+	duty_cycle = (output < 0) ? (0 - ((0 - output) >> motor::RAMP_FRACTIONAL_BITS)) : (output >> motor::RAMP_FRACTIONAL_BITS);
+	if(duty_cycle == m_torque_data.duty_cycle) return;
+	m_torque_data.duty_cycle = duty_cycle;
+	motor::set_duty_cycle(duty_cycle);
+}
+
+/**
+ * @brief returns the active mode, the module falls back to open loop when the current measurement is implausible
+ */
+E_TORQUE_MODE torque::get_mode() {
+	return m_torque_data.mode;
+}
+
+/**
+ * @brief sets the duty cycle from the throttle like the control module without torque control
+ */
+void apply_open_loop(int16_t const throttle) {
+	if(throttle > 0) {
+		motor::set_setpoint((uint8_t)(throttle), FORWARD);
+	} else if(throttle < 0) {
+		motor::set_setpoint((uint8_t)(0 - throttle), BACKWARD);
+	} else {
+		motor::set_setpoint(0, BREAK);
+	}
+}
+
+/**
+ * @brief switches permanently to the open loop control - only to be called within isr context
+ */
+void fall_back_to_open_loop() {
+	m_torque_data.mode = TORQUE_OPEN_LOOP;
+	m_torque_data.is_active = false;
+	m_torque_data.integral = 0;
+	// the last duty cycle is kept until the next throttle is applied in open loop, the ramp takes over from there
+}
@@ -0,0 +1,48 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module implements the closed loop control of the motor current (torque) with a fallback to the open loop control of the duty cycle
+ * @file torque.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef TORQUE_H_
+#define TORQUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {TORQUE_CLOSED_LOOP = 0, TORQUE_OPEN_LOOP = 1} E_TORQUE_MODE;
+
+class torque {
+public:
+	/**
+	 * @brief sets the throttle (-255 to 255) - it is the setpoint of the motor current in closed loop mode and the duty cycle in open loop mode
+	 */
+	static void set_throttle(int16_t const throttle);
+
+	/**
+	 * @brief stops the closed loop control until the next throttle is set - only to be called within isr context
+	 */
+	static void stop();
+
+	/**
+	 * @brief performs one step of the current control - to be called by the adc isr for every sample
+	 * @param is_forward_sensor true if the sample is from the current sensor of the half bridge driving forward
+	 * @param current sampled current in adc steps (adc::CURRENT_SENSE_1_A per A)
+	 * @param pwm_phase timer 0 value at the start of the conversion
+	 */
+	static void update(bool const is_forward_sensor, uint16_t const current, uint8_t const pwm_phase);
+
+	/**
+	 * @brief returns the active mode, the module falls back to open loop when the current measurement is implausible
+	 */
+	static E_TORQUE_MODE get_mode();
+
+private:
+	/**
+	 * @brief Constructor
+	 */
+	torque() { }
+};
+
+#endif /* TORQUE_H_ */
@@ -0,0 +1,150 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module records timestamped events of the isrs and the motor module in a ring buffer in ram (EVENT_TRACE) and dumps it binary over the uart
+ * @file trace.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "trace.h"
+#include "uart.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if EVENT_TRACE
+
+#if (TRACE_BUFFER_RECORDS & (TRACE_BUFFER_RECORDS - 1)) != 0 || TRACE_BUFFER_RECORDS > 128
+	#error "TRACE_BUFFER_RECORDS has to be a power of 2 up to 128"
+#endif
+
+/* GLOBAL CONSTANTS */
+static uint8_t const RECORD_MASK = TRACE_BUFFER_RECORDS - 1;
+// the records follow each other within less than a timer 1 period, otherwise an idle record tells the decoder the elapsed ms
+#if USE_HIGH_RESOLUTION_PULSE_CAPTURE
+static uint16_t const IDLE_PERIOD_MS = 30; // timer 1 overflows every 32.768 ms
+#else
+static uint16_t const IDLE_PERIOD_MS = 250; // timer 1 overflows every 262.144 ms
+#endif
+static uint8_t const EVENT_SHIFT = 12;
+
+/* TYPEDEFS */
+typedef struct {
+	uint16_t timestamp; // timer 1
+	uint16_t event_data; // event << 12 | data
+} s_trace_record;
+
+/* GLOBAL VARIABLES */
+// the records are only accessed with interrupts disabled or while the recording is paused for a dump
+static s_trace_record m_records[TRACE_BUFFER_RECORDS];
+static uint8_t m_head = 0; // next record to write
+static uint8_t m_count = 0;
+static uint16_t m_ms_since_record = 0;
+static volatile bool m_is_dumping = false;
+static uint8_t m_dump_header[TRACE_DUMP_HEADER_SIZE];
+static uint8_t m_dump_first = 0; // oldest record of the dump
+static uint16_t m_dump_position = 0; // bytes of the dump which have been queued
+static uint16_t m_dump_size = 0;
+
+/* PROTOTYPES */
+void append(E_TRACE_EVENT const event, uint16_t const data);
+
+/* FUNCTIONS */
+
+/**
+ * @brief records an event with the current timer 1 value - can be called from the isrs and the main context
+ */
+void trace::write(E_TRACE_EVENT const event, uint16_t const data) {
+	uint8_t const sreg = SREG;
+	cli();
+	if(!m_is_dumping) append(event, (data > TRACE_DATA_MAX) ? TRACE_DATA_MAX : data);
+	SREG = sreg;
+}
+
+/**
+ * @brief keeps the timestamps unambiguous across the timer 1 overflows - to be called every ms from the scheduler isr
+ */
+void trace::tick() {
+	if(m_ms_since_record < TRACE_DATA_MAX) m_ms_since_record++;
+	if(m_is_dumping || m_ms_since_record < IDLE_PERIOD_MS) return;
+	s_trace_record *newest = &m_records[(m_head - 1) & RECORD_MASK];
+	if(m_count > 0 && (newest->event_data >> EVENT_SHIFT) == TRACE_IDLE && (newest->event_data & TRACE_DATA_MAX) + m_ms_since_record <= TRACE_DATA_MAX) {
+		// consecutive idle records are merged, so that a pause does not overwrite the events before it
+		newest->timestamp = TCNT1;
+		newest->event_data += m_ms_since_record;
+		m_ms_since_record = 0;
+	} else {
+		append(TRACE_IDLE, m_ms_since_record);
+	}
+}
+
+/**
+ * @brief starts a dump of the ring buffer on 't' - the recording is paused until the dump has been sent
+ */
+void trace::handle_command(uint8_t const command) {
+	if(command != 't' || m_is_dumping) return;
+	cli();
+	m_is_dumping = true;
+	uint8_t const count = m_count;
+	m_dump_first = (m_head - count) & RECORD_MASK;
+	sei();
+	m_dump_header[0] = 'F';
+	m_dump_header[1] = 'W';
+	m_dump_header[2] = 'T';
+	m_dump_header[3] = 'R';
+	m_dump_header[4] = TRACE_DUMP_VERSION;
+	m_dump_header[5] = USE_HIGH_RESOLUTION_PULSE_CAPTURE ? TRACE_FLAG_HIGH_RESOLUTION : 0;
+	m_dump_header[6] = count;
+	m_dump_header[7] = 0;
+	m_dump_position = 0;
+	m_dump_size = TRACE_DUMP_HEADER_SIZE + (uint16_t)(count) * TRACE_RECORD_SIZE;
+}
+
+/**
+ * @brief continues a pending dump without blocking
+ */
+void trace::poll() {
+	if(!m_is_dumping) return;
+	while(m_dump_position < m_dump_size) {
+		uint8_t const *data = 0;
+		uint8_t length = 0;
+		if(m_dump_position < TRACE_DUMP_HEADER_SIZE) {
+			data = &m_dump_header[m_dump_position];
+			length = TRACE_DUMP_HEADER_SIZE - m_dump_position;
+		} else {
+			// the records are sent as they are stored, the avr is little endian
+			uint16_t const offset = m_dump_position - TRACE_DUMP_HEADER_SIZE;
+			uint8_t const index = (m_dump_first + offset / TRACE_RECORD_SIZE) & RECORD_MASK;
+			uint8_t const byte = offset % TRACE_RECORD_SIZE;
+			data = (uint8_t const *)(&m_records[index]) + byte;
+			length = TRACE_RECORD_SIZE - byte;
+		}
+		uint8_t const queued = uart::write(data, length);
+		m_dump_position += queued;
+		if(queued < length) return;
+	}
+	// the recording continues, the events in between are lost
+	cli();
+	m_is_dumping = false;
+	append(TRACE_DUMP, m_ms_since_record);
+	sei();
+}
+
+/**
+ * @brief returns true while a dump is sent
+ */
+bool trace::is_dumping() {
+	return m_is_dumping;
+}
+
+/**
+ * @brief appends a record and overwrites the oldest one when the buffer is full - to be called with interrupts disabled
+ */
+void append(E_TRACE_EVENT const event, uint16_t const data) {
+	s_trace_record *record = &m_records[m_head];
+	record->timestamp = TCNT1;
+	record->event_data = ((uint16_t)(event) << EVENT_SHIFT) | data;
+	m_head = (m_head + 1) & RECORD_MASK;
+	if(m_count < TRACE_BUFFER_RECORDS) m_count++;
+	m_ms_since_record = 0;
+}
+
+#endif
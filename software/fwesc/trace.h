@@ -0,0 +1,81 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module records timestamped events of the isrs and the motor module in a ring buffer in ram (EVENT_TRACE) and dumps it binary over the uart
+ * @file trace.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "defines.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// the event is stored in the upper 4 bits of the second word of a record, the data in the lower 12 bits
+typedef enum {
+	TRACE_PULSE_CH1 = 0, // pulse width in us (4095 = longer)
+	TRACE_PULSE_CH2,
+	TRACE_CHANNEL_LOST, // bit 0 = ch1, bit 1 = ch2
+	TRACE_OVERCURRENT, // h bridge disabled, adc value of the current
+	TRACE_OVERCURRENT_CLEARED, // h bridge enabled again, adc value of the current
+	TRACE_SET_SPEED, // new speed (setpoint of the ramp with USE_MOTOR_RAMP)
+	TRACE_SET_DIRECTION, // new E_MOTOR_DIRECTION
+	TRACE_MOTOR_STOP,
+	TRACE_IDLE, // no event for a while, ms since the previous record - keeps the 16 bit timestamps unambiguous
+	TRACE_DUMP, // the events have been dropped during a dump, ms since the previous record
+	TRACE_EVENT_COUNT
+} E_TRACE_EVENT;
+
+/* dump format, all values little endian:
+ * header: 'F' 'W' 'T' 'R', version, flags, number of records (uint16_t)
+ * record: timer 1 timestamp (uint16_t), event << 12 | data (uint16_t), oldest record first
+ */
+#define TRACE_DUMP_VERSION (1)
+#define TRACE_DUMP_HEADER_SIZE (8)
+#define TRACE_RECORD_SIZE (4)
+// the timestamps have a resolution of 0.5 us instead of 4 us (USE_HIGH_RESOLUTION_PULSE_CAPTURE)
+#define TRACE_FLAG_HIGH_RESOLUTION (1<<0)
+#define TRACE_DATA_MAX (0x0FFF)
+
+class trace {
+public:
+	/**
+	 * @brief records an event with the current timer 1 value - can be called from the isrs and the main context
+	 */
+	static void write(E_TRACE_EVENT const event, uint16_t const data);
+
+	/**
+	 * @brief keeps the timestamps unambiguous across the timer 1 overflows - to be called every ms from the scheduler isr
+	 */
+	static void tick();
+
+	/**
+	 * @brief starts a dump of the ring buffer on 't' - the recording is paused until the dump has been sent
+	 */
+	static void handle_command(uint8_t const command);
+
+	/**
+	 * @brief continues a pending dump without blocking
+	 */
+	static void poll();
+
+	/**
+	 * @brief returns true while a dump is sent
+	 */
+	static bool is_dumping();
+
+private:
+	/**
+	 * @brief Constructor
+	 */
+	trace() { }
+};
+
+#if EVENT_TRACE
+#define TRACE_EVENT(event, data) trace::write(event, data)
+#else
+#define TRACE_EVENT(event, data) do { } while(0)
+#endif
+
+#endif /* TRACE_H_ */
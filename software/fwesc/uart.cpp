@@ -0,0 +1,105 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module implements an interrupt driven access to the usart 0 (115200 baud, 8n1) with a receive and a transmit ring buffer
+ * @file uart.cpp
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#include "uart.h"
+#include "profiler.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* GLOBAL CONSTANTS */
+// double speed mode: baud = fCPU / (8 * (UBRR0 + 1)) = 16 MHz / (8 * 17) = 117647 baud (+2.1 %)
+static uint16_t const UBRR_115200_BAUD = 16;
+// the buffer sizes have to be powers of 2, one slot stays empty to tell a full from an empty buffer
+static uint8_t const TX_BUFFER_SIZE = 64;
+static uint8_t const RX_BUFFER_SIZE = 16;
+
+/* GLOBAL VARIABLES */
+// the head of a buffer is only written by the producer, the tail only by the consumer
+static uint8_t m_tx_buffer[TX_BUFFER_SIZE];
+static volatile uint8_t m_tx_head = 0;
+static volatile uint8_t m_tx_tail = 0;
+static uint8_t m_rx_buffer[RX_BUFFER_SIZE];
+static volatile uint8_t m_rx_head = 0;
+static volatile uint8_t m_rx_tail = 0;
+
+/* FUNCTIONS */
+
+/**
+ * @brief initializes the usart 0 with 115200 baud, 8 data bits, no parity and 1 stop bit
+ */
+void uart::init() {
+	UBRR0 = UBRR_115200_BAUD;
+	UCSR0A = (1<<U2X0);
+	// 8 data bits, no parity, 1 stop bit
+	UCSR0C = (1<<UCSZ01) | (1<<UCSZ00);
+	// enable receiver, transmitter and the receive complete interrupt, the data register empty interrupt is enabled by write
+	UCSR0B = (1<<RXCIE0) | (1<<RXEN0) | (1<<TXEN0);
+}
+
+/**
+ * @brief queues data for transmission without blocking
+ */
+uint8_t uart::write(uint8_t const *data, uint8_t const length) {
+	uint8_t head = m_tx_head;
+	uint8_t i = 0;
+	for(; i < length; i++) {
+		uint8_t const next_head = (head + 1) & (TX_BUFFER_SIZE - 1);
+		if(next_head == m_tx_tail) break;
+		m_tx_buffer[head] = data[i];
+		head = next_head;
+	}
+	m_tx_head = head;
+	// the isr disables itself when the buffer has been emptied
+	if(i > 0) UCSR0B |= (1<<UDRIE0);
+	return i;
+}
+
+/**
+ * @brief returns the number of bytes which can be queued for transmission
+ */
+uint8_t uart::get_tx_free() {
+	return (m_tx_tail - m_tx_head - 1) & (TX_BUFFER_SIZE - 1);
+}
+
+/**
+ * @brief reads one received byte
+ */
+bool uart::read(uint8_t *data) {
+	uint8_t const tail = m_rx_tail;
+	if(tail == m_rx_head) return false;
+	*data = m_rx_buffer[tail];
+	m_rx_tail = (tail + 1) & (RX_BUFFER_SIZE - 1);
+	return true;
+}
+
+/**
+ * @brief usart 0 receive complete interrupt service routine - a byte which does not fit into the buffer is dropped
+ */
+ISR(USART_RX_vect) {
+	PROFILE_ISR(PROFILED_ISR_USART_RX);
+	uint8_t const data = UDR0;
+	uint8_t const head = m_rx_head;
+	uint8_t const next_head = (head + 1) & (RX_BUFFER_SIZE - 1);
+	if(next_head != m_rx_tail) {
+		m_rx_buffer[head] = data;
+		m_rx_head = next_head;
+	}
+}
+
+/**
+ * @brief usart 0 data register empty interrupt service routine - sends the next queued byte
+ */
+ISR(USART_UDRE_vect) {
+	PROFILE_ISR(PROFILED_ISR_USART_UDRE);
+	uint8_t const tail = m_tx_tail;
+	if(tail == m_tx_head) {
+		UCSR0B &= ~(1<<UDRIE0);
+		return;
+	}
+	UDR0 = m_tx_buffer[tail];
+	m_tx_tail = (tail + 1) & (TX_BUFFER_SIZE - 1);
+}
@@ -0,0 +1,45 @@
+/**
+ * @author Alexander Entinger, MSc / LXRobotics
+ * @brief this module implements an interrupt driven access to the usart 0 (115200 baud, 8n1) with a receive and a transmit ring buffer
+ * @file uart.h
+ * @license CC BY-NC-SA 3.0 ( http://creativecommons.org/licenses/by-nc-sa/3.0/ )
+ */
+
+#ifndef UART_H_
+#define UART_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+class uart {
+public:
+	/**
+	 * @brief initializes the usart 0 with 115200 baud, 8 data bits, no parity and 1 stop bit
+	 */
+	static void init();
+
+	/**
+	 * @brief queues data for transmission without blocking
+	 * @return number of queued bytes, less than length if the transmit buffer is full
+	 */
+	static uint8_t write(uint8_t const *data, uint8_t const length);
+
+	/**
+	 * @brief returns the number of bytes which can be queued for transmission
+	 */
+	static uint8_t get_tx_free();
+
+	/**
+	 * @brief reads one received byte
+	 * @return false if no byte has been received
+	 */
+	static bool read(uint8_t *data);
+
+private:
+	/**
+	 * @brief Constructor
+	 */
+	uart() { }
+};
+
+#endif /* UART_H_ */
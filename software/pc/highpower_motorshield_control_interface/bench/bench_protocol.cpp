@@ -0,0 +1,272 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief measures the frame rate of protocol version 1 and 2 at the negotiable baud rates and the recovery time after a lost byte against serial_motor_driver_sim
+ * @file bench_protocol.cpp
+ * @license MPL 2.0
+ *
+ * build: g++ -O2 -I.. bench_protocol.cpp ../lxr_hp_protocol.cpp -o bench_protocol
+ * usage: serial_motor_driver_sim -p -L /tmp/hp_sim & bench_protocol /tmp/hp_sim [run_ms]
+ *        -p paces the simulated uart to the baud rate the sketch has negotiated
+ */
+
+#include "lxr_hp_protocol.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* GLOBAL CONSTANT SECTION */
+static unsigned char const id = 128;
+static size_t const frames_in_flight = 4;
+static int const reply_timeout_ms = 100;
+// the control loop which sends the frames during the recovery measurement
+static unsigned long const recovery_period_us = 10000;
+static unsigned long const recovery_limit_us = 2000000;
+// longer than SERIAL_TIMEOUT_MS of serial_motor_driver.ino, after which it returns to protocol version 1 at 115200 baud
+static unsigned long const device_timeout_us = 300000;
+
+/* FUNCTION SECTION */
+
+static unsigned long now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long>(ts.tv_sec) * 1000000UL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief the pc side of the serial line with a timeout for every reply, without the retransmits of lxr_hp_motor_control
+ */
+class serial_link {
+public:
+	serial_link(char const *dev_node) : m_fd(open(dev_node, O_RDWR | O_NOCTTY)), m_version(lxr_hp_protocol::protocol_version_1), m_seq(0), m_rx_size(0), m_last_read(0) {
+		if(m_fd < 0) {
+			std::perror(dev_node);
+			std::exit(EXIT_FAILURE);
+		}
+		struct termios tio;
+		tcgetattr(m_fd, &tio);
+		cfmakeraw(&tio);
+		tcsetattr(m_fd, TCSANOW, &tio);
+		set_baud_rate(E_BAUD_115200);
+	}
+
+	/**
+	 * @brief negotiates the protocol version and the baud rate, the device has to be in its initial state
+	 */
+	bool connect(unsigned char const version, E_BAUD_RATE const baud_rate) {
+		if(version == lxr_hp_protocol::protocol_version_1) return true;
+		unsigned char msg[lxr_hp_protocol::msg_size];
+		lxr_hp_protocol::build_protocol_message(msg, id, version);
+		send(msg, sizeof(msg), false);
+		if(receive() != NO_ERROR) return false;
+		m_version = version;
+		if(baud_rate == E_BAUD_115200) return true;
+		lxr_hp_protocol::build_baud_rate_message(msg, id, baud_rate);
+		send(msg, sizeof(msg), false);
+		if(receive() != NO_ERROR) return false;
+		set_baud_rate(baud_rate);
+		return true;
+	}
+
+	/**
+	 * @brief stays silent until the device has returned to protocol version 1 at 115200 baud
+	 */
+	void disconnect() {
+		usleep(device_timeout_us);
+		tcflush(m_fd, TCIOFLUSH);
+		m_version = lxr_hp_protocol::protocol_version_1;
+		m_rx_size = 0;
+		set_baud_rate(E_BAUD_115200);
+	}
+
+	/**
+	 * @brief sends a setpoint, optionally without one byte in the middle of the frame
+	 */
+	void send_setpoint(unsigned char const speed, bool const is_byte_lost) {
+		unsigned char msg[lxr_hp_protocol::msg_size];
+		lxr_hp_protocol::build_message(msg, id, E_FWD, speed);
+		send(msg, sizeof(msg), is_byte_lost);
+	}
+
+	/**
+	 * @brief receives the next reply
+	 * @return NO_ERROR, the error code of the reply or TIMEOUT if no reply has arrived within the timeout
+	 */
+	size_t receive() {
+		if(m_version == lxr_hp_protocol::protocol_version_1) {
+			unsigned char reply[lxr_hp_protocol::reply_size];
+			for(size_t received = 0; received < sizeof(reply); received += m_last_read) {
+				if(!read_some(reply + received, sizeof(reply) - received)) return TIMEOUT;
+			}
+			return lxr_hp_protocol::evaluate_reply(reply, id);
+		}
+		for(;;) {
+			// the frames are split at their delimiter
+			unsigned char *delimiter = std::find(m_rx, m_rx + m_rx_size, lxr_hp_protocol::frame_delimiter);
+			if(delimiter != m_rx + m_rx_size) {
+				size_t const frame_size = delimiter - m_rx;
+				unsigned char seq = 0;
+				size_t const msg_size = (frame_size > 0) ? lxr_hp_protocol::decode_frame(m_rx, frame_size, seq) : 0;
+				size_t const err_code = (msg_size == lxr_hp_protocol::reply_size) ? lxr_hp_protocol::evaluate_reply(m_rx + 1, id) : CS_WRONG;
+				std::copy(delimiter + 1, m_rx + m_rx_size, m_rx);
+				m_rx_size -= frame_size + 1;
+				if(frame_size > 0) return err_code;
+				continue;
+			}
+			if(m_rx_size == sizeof(m_rx)) m_rx_size = 0;
+			if(!read_some(m_rx + m_rx_size, sizeof(m_rx) - m_rx_size)) return TIMEOUT;
+			m_rx_size += m_last_read;
+		}
+	}
+
+private:
+	int m_fd;
+	unsigned char m_version;
+	unsigned char m_seq;
+	unsigned char m_rx[256];
+	size_t m_rx_size;
+	size_t m_last_read;
+
+	void set_baud_rate(E_BAUD_RATE const baud_rate) {
+		static speed_t const speeds[] = {B115200, B500000, B1000000};
+		struct termios tio;
+		tcgetattr(m_fd, &tio);
+		cfsetspeed(&tio, speeds[baud_rate]);
+		tcsetattr(m_fd, TCSANOW, &tio);
+	}
+
+	void send(unsigned char const *msg, size_t const msg_size, bool const is_byte_lost) {
+		unsigned char frame[lxr_hp_protocol::max_frame_size];
+		size_t frame_size = msg_size;
+		if(m_version == lxr_hp_protocol::protocol_version_1) {
+			std::copy(msg, msg + msg_size, frame);
+		} else {
+			frame_size = lxr_hp_protocol::encode_frame(frame, m_seq++, msg, msg_size);
+		}
+		if(is_byte_lost) {
+			std::copy(frame + frame_size / 2 + 1, frame + frame_size, frame + frame_size / 2);
+			frame_size--;
+		}
+		if(write(m_fd, frame, frame_size) != static_cast<ssize_t>(frame_size)) std::perror("write");
+	}
+
+	bool read_some(unsigned char *buf, size_t const size) {
+		struct pollfd pfd = {m_fd, POLLIN, 0};
+		if(poll(&pfd, 1, reply_timeout_ms) <= 0) return false;
+		ssize_t const n = read(m_fd, buf, size);
+		m_last_read = (n > 0) ? static_cast<size_t>(n) : 0;
+		return n > 0;
+	}
+};
+
+/**
+ * @brief sends a frame after every reply and prints the round trips per second and the mean round trip time
+ */
+static void bench_round_trips(serial_link &l, unsigned long const run_ms) {
+	unsigned long round_trips = 0;
+	unsigned long const start = now_us();
+	while(now_us() - start < run_ms * 1000) {
+		l.send_setpoint(static_cast<unsigned char>(round_trips), false);
+		size_t const err_code = l.receive();
+		if(err_code != NO_ERROR) {
+			std::printf(" reply failed (%zu)\n", err_code);
+			return;
+		}
+		round_trips++;
+	}
+	unsigned long const duration = now_us() - start;
+	std::printf(" %7.0f round trips/s (%6.1f us each)", round_trips * 1e6 / duration, static_cast<double>(duration) / round_trips);
+}
+
+/**
+ * @brief keeps frames_in_flight frames in flight and prints the frames per second
+ */
+static void bench_pipelined(serial_link &l, unsigned long const run_ms) {
+	unsigned long frames = 0;
+	for(size_t i = 0; i < frames_in_flight; i++) l.send_setpoint(static_cast<unsigned char>(i), false);
+	unsigned long const start = now_us();
+	while(now_us() - start < run_ms * 1000) {
+		size_t const err_code = l.receive();
+		if(err_code != NO_ERROR) {
+			std::printf(" reply failed (%zu)\n", err_code);
+			return;
+		}
+		frames++;
+		l.send_setpoint(static_cast<unsigned char>(frames), false);
+	}
+	unsigned long const duration = now_us() - start;
+	for(size_t i = 0; i < frames_in_flight; i++) l.receive();
+	std::printf(" %7.0f frames/s with %zu in flight\n", frames * 1e6 / duration, frames_in_flight);
+}
+
+/**
+ * @brief drops one byte of a frame while a frame is sent every recovery_period_us and prints the time until the next valid reply
+ */
+static void bench_recovery(serial_link &l) {
+	unsigned long const start = now_us();
+	unsigned long next = start;
+	unsigned long failed = 0;
+	for(unsigned long frame = 0; now_us() - start < recovery_limit_us; frame++) {
+		l.send_setpoint(static_cast<unsigned char>(frame), frame == 0);
+		// a missing reply counts as failed as well
+		if(l.receive() == NO_ERROR) {
+			std::printf(" recovered after %6.1f ms, %lu replies failed\n", (now_us() - start) / 1000.0, failed);
+			return;
+		}
+		failed++;
+		next += recovery_period_us;
+		if(now_us() < next) usleep(next - now_us());
+	}
+	std::printf(" not recovered within %lu ms, %lu replies failed\n", recovery_limit_us / 1000, failed);
+}
+
+int main(int argc, char **argv) {
+
+	if(argc < 2) {
+		std::fprintf(stderr, "usage: %s <device node of serial_motor_driver_sim -p> [run_ms]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	unsigned long const run_ms = (argc > 2) ? std::strtoul(argv[2], 0, 10) : 1000;
+
+	struct {
+		char const *name;
+		unsigned char version;
+		E_BAUD_RATE baud_rate;
+	} const configs[] = {
+		{"v1 @  115200", lxr_hp_protocol::protocol_version_1, E_BAUD_115200},
+		{"v2 @  115200", lxr_hp_protocol::protocol_version_2, E_BAUD_115200},
+		{"v2 @  500000", lxr_hp_protocol::protocol_version_2, E_BAUD_500000},
+		{"v2 @ 1000000", lxr_hp_protocol::protocol_version_2, E_BAUD_1000000},
+	};
+
+	serial_link l(argv[1]);
+	// a previous client might have left the device at protocol version 2
+	l.disconnect();
+	for(size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+		std::printf("%s frame rate:", configs[i].name);
+		if(!l.connect(configs[i].version, configs[i].baud_rate)) {
+			std::printf(" negotiation failed\n");
+			return EXIT_FAILURE;
+		}
+		bench_round_trips(l, run_ms);
+		bench_pipelined(l, run_ms);
+		l.disconnect();
+	}
+	for(size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+		std::printf("%s lost byte:", configs[i].name);
+		l.connect(configs[i].version, configs[i].baud_rate);
+		bench_recovery(l);
+		l.disconnect();
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief measures the cpu usage and the setpoint latency of many lxr_hp_motor_control instances with threads of their own and on a shared lxr_hp_reactor - pseudo terminal pairs replace the arduinos
+ * @file bench_reactor_scaling.cpp
+ * @license MPL 2.0
+ *
+ * build: g++ -O2 -I.. bench_reactor_scaling.cpp ../lxr_hp_motor_control.cpp ../lxr_hp_reactor.cpp ../serial.cpp ../lxr_hp_protocol.cpp -o bench_reactor_scaling -lboost_thread -lboost_system -lutil -pthread
+ * usage: bench_reactor_scaling [run_ms]
+ *
+ * every configuration runs in a process of its own, the devices of all ports are served by one further process,
+ * so that the cpu usage of the configuration only contains lxr_hp_motor_control and the thread setting the speeds
+ */
+
+#include "lxr_hp_motor_control.h"
+#include "lxr_hp_reactor.h"
+
+#include <boost/atomic.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* GLOBAL CONSTANT SECTION */
+static size_t const histogram_buckets = 40;
+static size_t const port_counts[] = {1, 4, 16, 64};
+// 0 = two threads of its own per instance
+static size_t const reactor_thread_counts[] = {0, 1, 2};
+// every port gets a new speed with this period
+static unsigned long const setpoint_period_us = 10000;
+// the instances wait two seconds before they negotiate the protocol
+static unsigned long const start_up_ms = 2500;
+static unsigned char const id = 128;
+
+/* TYPEDEF SECTION */
+// bucket n counts the setpoints which took [2^n, 2^(n+1)) ns from set_speed until the device received them
+typedef struct {
+	unsigned long samples;
+	unsigned long max_ns;
+	unsigned long histogram[histogram_buckets];
+} s_latency;
+
+// shared by the configuration process and the device process
+typedef struct {
+	// time at which a speed has been set, the device takes it when it receives the speed for the first time
+	boost::atomic<unsigned long> set_ns[256];
+	unsigned long frames;
+	s_latency latency;
+} s_port;
+
+/* FUNCTION SECTION */
+
+static unsigned long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long>(ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+}
+
+static void add_sample(s_latency &latency, unsigned long const duration) {
+	size_t bucket = 0;
+	while(bucket < histogram_buckets - 1 && (duration >> (bucket + 1)) != 0) bucket++;
+	latency.histogram[bucket]++;
+	if(duration > latency.max_ns) latency.max_ns = duration;
+	latency.samples++;
+}
+
+/**
+ * @brief returns the upper bound of the bucket which contains the given fraction of the samples
+ */
+static unsigned long percentile_ns(s_latency const &latency, double const fraction) {
+	unsigned long const limit = static_cast<unsigned long>(latency.samples * fraction);
+	unsigned long sum = 0;
+	for(size_t bucket = 0; bucket < histogram_buckets; bucket++) {
+		sum += latency.histogram[bucket];
+		if(sum >= limit) return 2UL << bucket;
+	}
+	return latency.max_ns;
+}
+
+/**
+ * @brief answers the setpoint frames of all ports like serial_motor_driver.ino and records their latency, the handshake of protocol version 2 is rejected
+ */
+static void device_func(std::vector<int> const &master_fds, s_port *ports) {
+	std::vector<struct pollfd> pfds(master_fds.size());
+	std::vector<unsigned char> msgs(master_fds.size() * lxr_hp_protocol::msg_size);
+	std::vector<size_t> received(master_fds.size(), 0);
+	for(size_t i = 0; i < master_fds.size(); i++) {
+		pfds[i].fd = master_fds[i];
+		pfds[i].events = POLLIN;
+	}
+	for(;;) {
+		if(poll(&pfds[0], pfds.size(), -1) <= 0) continue;
+		for(size_t i = 0; i < pfds.size(); i++) {
+			if(!(pfds[i].revents & POLLIN)) continue;
+			unsigned char buf[64];
+			ssize_t const n = read(pfds[i].fd, buf, sizeof(buf));
+			unsigned char *msg = &msgs[i * lxr_hp_protocol::msg_size];
+			for(ssize_t k = 0; k < n; k++) {
+				msg[received[i]++] = buf[k];
+				if(received[i] < lxr_hp_protocol::msg_size) continue;
+				received[i] = 0;
+				ports[i].frames++;
+				bool const is_setpoint = (msg[1] == E_FWD || msg[1] == E_BWD);
+				if(is_setpoint) {
+					unsigned long const set_ns = ports[i].set_ns[msg[2]].exchange(0);
+					if(set_ns != 0) add_sample(ports[i].latency, now_ns() - set_ns);
+				}
+				unsigned char const status = is_setpoint ? 1 : 0;
+				unsigned char const reply[lxr_hp_protocol::reply_size] = {msg[0], status, static_cast<unsigned char>(msg[0] ^ status)};
+				if(write(pfds[i].fd, reply, sizeof(reply)) != sizeof(reply)) _exit(EXIT_FAILURE);
+			}
+		}
+	}
+}
+
+static size_t thread_count() {
+	FILE *status = std::fopen("/proc/self/status", "r");
+	char line[128];
+	size_t threads = 0;
+	while(status != 0 && std::fgets(line, sizeof(line), status) != 0) {
+		if(std::sscanf(line, "Threads: %zu", &threads) == 1) break;
+	}
+	if(status != 0) std::fclose(status);
+	return threads;
+}
+
+static unsigned long cpu_us() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000UL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+ * @brief runs one configuration, to be called in a process of its own which is ended afterwards
+ * @param reactor_threads 0 = the instances run threads of their own
+ */
+static void run(size_t const port_count, size_t const reactor_threads, unsigned long const run_ms) {
+	s_port *ports = static_cast<s_port *>(mmap(0, port_count * sizeof(s_port), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+	if(ports == MAP_FAILED) {
+		std::perror("mmap");
+		_exit(EXIT_FAILURE);
+	}
+	for(size_t i = 0; i < port_count; i++) new (&ports[i]) s_port();
+
+	std::vector<int> master_fds(port_count);
+	std::vector<std::string> slave_names(port_count);
+	for(size_t i = 0; i < port_count; i++) {
+		int slave_fd = -1;
+		char slave_name[64] = {0};
+		if(openpty(&master_fds[i], &slave_fd, slave_name, 0, 0) != 0) {
+			std::perror("openpty");
+			_exit(EXIT_FAILURE);
+		}
+		struct termios tio;
+		tcgetattr(master_fds[i], &tio);
+		cfmakeraw(&tio);
+		tcsetattr(master_fds[i], TCSANOW, &tio);
+		slave_names[i] = slave_name;
+	}
+
+	pid_t const device = fork();
+	if(device == 0) device_func(master_fds, ports);
+
+	// the instances are not destroyed, the process ends with the configuration
+	lxr_hp_reactor *reactor = (reactor_threads > 0) ? new lxr_hp_reactor(reactor_threads) : 0;
+	std::vector<lxr_hp_motor_control *> mcs(port_count);
+	for(size_t i = 0; i < port_count; i++) {
+		mcs[i] = (reactor != 0) ? new lxr_hp_motor_control(*reactor, slave_names[i], id, E_PIPELINED) : new lxr_hp_motor_control(slave_names[i], id, E_PIPELINED);
+	}
+	usleep(start_up_ms * 1000);
+
+	unsigned long frames_before = 0;
+	for(size_t i = 0; i < port_count; i++) frames_before += ports[i].frames;
+	unsigned long const cpu_before = cpu_us();
+	unsigned long const start = now_ns();
+	unsigned long next = start;
+	unsigned char speed = 0;
+	while(now_ns() - start < run_ms * 1000000UL) {
+		speed = static_cast<unsigned char>(speed % 255 + 1);
+		for(size_t i = 0; i < port_count; i++) {
+			ports[i].set_ns[speed].store(now_ns());
+			mcs[i]->set_speed(speed);
+		}
+		next += setpoint_period_us * 1000;
+		unsigned long const now = now_ns();
+		if(next > now) usleep((next - now) / 1000);
+	}
+	unsigned long const duration = now_ns() - start;
+	unsigned long const cpu = cpu_us() - cpu_before;
+	size_t const threads = thread_count();
+
+	kill(device, SIGKILL);
+	waitpid(device, 0, 0);
+
+	s_latency total = {};
+	unsigned long frames = 0;
+	unsigned long worst_port_p99 = 0;
+	for(size_t i = 0; i < port_count; i++) {
+		frames += ports[i].frames;
+		total.samples += ports[i].latency.samples;
+		if(ports[i].latency.max_ns > total.max_ns) total.max_ns = ports[i].latency.max_ns;
+		for(size_t bucket = 0; bucket < histogram_buckets; bucket++) total.histogram[bucket] += ports[i].latency.histogram[bucket];
+		worst_port_p99 = std::max(worst_port_p99, percentile_ns(ports[i].latency, 0.99));
+	}
+	frames -= frames_before;
+
+	char mode[64];
+	if(reactor_threads > 0) {
+		std::snprintf(mode, sizeof(mode), "reactor %zu thread%s", reactor_threads, (reactor_threads > 1) ? "s" : "");
+	} else {
+		std::snprintf(mode, sizeof(mode), "own threads");
+	}
+	std::printf("%2zu ports %-17s %3zu threads, cpu %5.1f %%, %6.0f frames/s, latency p50 < %7lu ns, p99 < %8lu ns, worst port p99 < %8lu ns, max %8lu ns\n",
+		port_count, mode, threads, cpu * 100.0 / (duration / 1000), frames * 1e9 / duration,
+		percentile_ns(total, 0.5), percentile_ns(total, 0.99), worst_port_p99, total.max_ns);
+	std::fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+
+	unsigned long const run_ms = (argc > 1) ? std::strtoul(argv[1], 0, 10) : 3000;
+
+	for(size_t p = 0; p < sizeof(port_counts) / sizeof(port_counts[0]); p++) {
+		for(size_t r = 0; r < sizeof(reactor_thread_counts) / sizeof(reactor_thread_counts[0]); r++) {
+			pid_t const configuration = fork();
+			if(configuration == 0) {
+				run(port_counts[p], reactor_thread_counts[r], run_ms);
+				_exit(EXIT_SUCCESS);
+			}
+			waitpid(configuration, 0, 0);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief counts the heap allocations of the serial com loop - a pseudo terminal pair replaces the arduino
+ * @file bench_serial_alloc.cpp
+ * @license MPL 2.0
+ *
+ * build: g++ -O2 -I.. bench_serial_alloc.cpp ../serial.cpp ../lxr_hp_protocol.cpp -o bench_serial_alloc -lboost_thread -lboost_system -lutil -pthread
+ */
+
+#include "serial.h"
+#include "lxr_hp_protocol.h"
+
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* GLOBAL VARIABLE SECTION */
+static boost::atomic<unsigned long> m_allocation_cnt(0);
+
+/* ALLOCATION COUNTING */
+
+void *operator new(std::size_t size) {
+	m_allocation_cnt++;
+	void *p = std::malloc(size ? size : 1);
+	if(p == 0) throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size) {
+	m_allocation_cnt++;
+	void *p = std::malloc(size ? size : 1);
+	if(p == 0) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw() { std::free(p); }
+void operator delete[](void *p) throw() { std::free(p); }
+void operator delete(void *p, std::size_t) throw() { std::free(p); }
+void operator delete[](void *p, std::size_t) throw() { std::free(p); }
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief answers every command frame on the master side of the pty with an ok reply, like serial_motor_driver.ino
+ */
+static void device_func(int const master_fd) {
+	unsigned char msg[lxr_hp_protocol::msg_size];
+	size_t received = 0;
+	for(;;) {
+		ssize_t const n = read(master_fd, msg + received, sizeof(msg) - received);
+		if(n <= 0) return;
+		received += n;
+		if(received < sizeof(msg)) continue;
+		received = 0;
+		unsigned char const reply[lxr_hp_protocol::reply_size] = {msg[0], 1, static_cast<unsigned char>(msg[0] ^ 1)};
+		if(write(master_fd, reply, sizeof(reply)) != sizeof(reply)) return;
+	}
+}
+
+/**
+ * @brief performs one command/reply exchange with the caller supplied buffer api
+ */
+static size_t exchange(serial &s) {
+	unsigned char msg[lxr_hp_protocol::msg_size];
+	unsigned char reply[lxr_hp_protocol::reply_size];
+	lxr_hp_protocol::build_message(msg, 128, E_FWD, 100);
+	s.writeToSerial(msg, sizeof(msg));
+	s.readFromSerial(reply, sizeof(reply));
+	return lxr_hp_protocol::evaluate_reply(reply, 128);
+}
+
+/**
+ * @brief performs one command/reply exchange with the allocating legacy api
+ */
+static size_t exchange_legacy(serial &s) {
+	unsigned char msg[lxr_hp_protocol::msg_size];
+	lxr_hp_protocol::build_message(msg, 128, E_FWD, 100);
+	s.writeToSerial(msg, sizeof(msg));
+	boost::shared_ptr<unsigned char> reply = s.readFromSerial(lxr_hp_protocol::reply_size);
+	return lxr_hp_protocol::evaluate_reply(reply.get(), 128);
+}
+
+int main(int argc, char **argv) {
+
+	unsigned long const frames = (argc > 1) ? std::strtoul(argv[1], 0, 10) : 10000;
+
+	int master_fd = -1, slave_fd = -1;
+	char slave_name[64] = {0};
+	if(openpty(&master_fd, &slave_fd, slave_name, 0, 0) != 0) {
+		std::perror("openpty");
+		return EXIT_FAILURE;
+	}
+	struct termios tio;
+	tcgetattr(master_fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(master_fd, TCSANOW, &tio);
+
+	serial s(slave_name, 115200);
+	boost::thread device(boost::bind(&device_func, master_fd));
+
+	size_t errors = 0;
+
+	// warm up, lazily initialized internals of boost::asio are allowed to allocate here
+	for(unsigned long i = 0; i < 100; i++) errors |= exchange(s);
+
+	unsigned long const before = m_allocation_cnt;
+	for(unsigned long i = 0; i < frames; i++) errors |= exchange(s);
+	unsigned long const caller_buffer_allocs = m_allocation_cnt - before;
+
+	unsigned long const before_legacy = m_allocation_cnt;
+	for(unsigned long i = 0; i < frames; i++) errors |= exchange_legacy(s);
+	unsigned long const legacy_allocs = m_allocation_cnt - before_legacy;
+
+	std::printf("%lu frames per api\n", frames);
+	std::printf("caller supplied buffer: %10lu allocations (%.3f per frame)\n", caller_buffer_allocs, static_cast<double>(caller_buffer_allocs) / frames);
+	std::printf("shared_ptr legacy api : %10lu allocations (%.3f per frame)\n", legacy_allocs, static_cast<double>(legacy_allocs) / frames);
+	if(errors != NO_ERROR) std::printf("protocol errors: 0x%zx\n", errors);
+
+	std::fflush(stdout);
+	close(slave_fd);
+	_exit((caller_buffer_allocs == 0 && errors == NO_ERROR) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,206 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief measures the latency of the setters of lxr_hp_motor_control with several setter threads while the com threads are running - a pseudo terminal pair replaces the arduino
+ * @file bench_setpoint_contention.cpp
+ * @license MPL 2.0
+ *
+ * build: g++ -O2 -I.. bench_setpoint_contention.cpp ../lxr_hp_motor_control.cpp ../lxr_hp_reactor.cpp ../serial.cpp ../lxr_hp_protocol.cpp -o bench_setpoint_contention -lboost_thread -lboost_system -lutil -pthread
+ */
+
+#include "lxr_hp_motor_control.h"
+
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <pty.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* GLOBAL CONSTANT SECTION */
+static size_t const histogram_buckets = 40;
+static size_t const thread_counts[] = {1, 2, 4, 8};
+
+/* TYPEDEF SECTION */
+// bucket n counts the calls which took [2^n, 2^(n+1)) ns
+typedef struct {
+	unsigned long calls;
+	unsigned long max_ns;
+	unsigned long histogram[histogram_buckets];
+} s_latency;
+
+/* GLOBAL VARIABLE SECTION */
+static boost::atomic<bool> m_is_running(false);
+static boost::atomic<unsigned long> m_frames_received(0);
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief the previous locking scheme of lxr_hp_motor_control - every setter and every frame of the com thread take the same mutex
+ */
+class mutex_setpoint {
+public:
+	mutex_setpoint(std::string const &devNode) : m_serial(devNode, 115200), m_speed(0), m_direction(E_FWD), m_setpoint_changed(false) { }
+
+	void set_velocity(int const velocity) {
+		{
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			E_MOTOR_DIRECTION const dir = (velocity < 0) ? E_BWD : E_FWD;
+			unsigned char const speed = static_cast<unsigned char>((velocity < 0) ? -velocity : velocity);
+			if(m_speed != speed || m_direction != dir) m_setpoint_changed = true;
+			m_speed = speed;
+			m_direction = dir;
+		}
+		m_com_cond.notify_one();
+	}
+
+	/**
+	 * @brief sends a frame whenever the setpoint has changed and waits for its reply
+	 */
+	void com_thread_func() {
+		for(;;) {
+			unsigned char msg_buf[lxr_hp_protocol::msg_size] = {0};
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				while(!m_setpoint_changed) m_com_cond.wait(lock);
+				lxr_hp_protocol::build_message(msg_buf, 128, m_direction, m_speed);
+				m_setpoint_changed = false;
+			}
+			m_serial.writeToSerial(msg_buf, sizeof(msg_buf));
+			unsigned char reply[lxr_hp_protocol::reply_size] = {0};
+			m_serial.readFromSerial(reply, sizeof(reply));
+		}
+	}
+
+private:
+	serial m_serial;
+	unsigned char m_speed;
+	E_MOTOR_DIRECTION m_direction;
+	bool m_setpoint_changed;
+	boost::mutex m_mutex;
+	boost::condition_variable m_com_cond;
+};
+
+/**
+ * @brief answers every setpoint frame on the master side of the pty with an ok reply, like serial_motor_driver.ino - the handshake of protocol version 2 is rejected
+ */
+static void device_func(int const master_fd) {
+	unsigned char msg[lxr_hp_protocol::msg_size];
+	size_t received = 0;
+	for(;;) {
+		ssize_t const n = read(master_fd, msg + received, sizeof(msg) - received);
+		if(n <= 0) return;
+		received += n;
+		if(received < sizeof(msg)) continue;
+		received = 0;
+		m_frames_received++;
+		unsigned char const status = (msg[1] == E_FWD || msg[1] == E_BWD) ? 1 : 0;
+		unsigned char const reply[lxr_hp_protocol::reply_size] = {msg[0], status, static_cast<unsigned char>(msg[0] ^ status)};
+		if(write(master_fd, reply, sizeof(reply)) != sizeof(reply)) return;
+	}
+}
+
+static unsigned long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long>(ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+}
+
+/**
+ * @brief calls set_velocity with alternating values until the run ends and records the latency of every call
+ */
+template <typename T>
+static void setter_func(T *target, s_latency *latency, int const offset) {
+	while(!m_is_running) boost::this_thread::yield();
+	int velocity = offset;
+	while(m_is_running) {
+		velocity = (velocity >= 255) ? -255 : (velocity + 1);
+		unsigned long const start = now_ns();
+		target->set_velocity(velocity);
+		unsigned long const duration = now_ns() - start;
+		size_t bucket = 0;
+		while(bucket < histogram_buckets - 1 && (duration >> (bucket + 1)) != 0) bucket++;
+		latency->histogram[bucket]++;
+		if(duration > latency->max_ns) latency->max_ns = duration;
+		latency->calls++;
+	}
+}
+
+/**
+ * @brief returns the upper bound of the bucket which contains the given fraction of the calls
+ */
+static unsigned long percentile_ns(s_latency const &latency, double const fraction) {
+	unsigned long const limit = static_cast<unsigned long>(latency.calls * fraction);
+	unsigned long sum = 0;
+	for(size_t bucket = 0; bucket < histogram_buckets; bucket++) {
+		sum += latency.histogram[bucket];
+		if(sum >= limit) return 2UL << bucket;
+	}
+	return latency.max_ns;
+}
+
+/**
+ * @brief runs the given number of setter threads against the target for run_ms and prints the merged latency
+ */
+template <typename T>
+static void run(char const *name, T &target, size_t const threads, unsigned long const run_ms) {
+	s_latency latency[8] = {};
+	boost::thread_group setters;
+	for(size_t i = 0; i < threads; i++) setters.create_thread(boost::bind(&setter_func<T>, &target, &latency[i], static_cast<int>(i * 64)));
+	unsigned long const frames_before = m_frames_received;
+	m_is_running = true;
+	boost::this_thread::sleep(boost::posix_time::milliseconds(run_ms));
+	m_is_running = false;
+	setters.join_all();
+	unsigned long const frames = m_frames_received - frames_before;
+
+	s_latency total = {};
+	for(size_t i = 0; i < threads; i++) {
+		total.calls += latency[i].calls;
+		if(latency[i].max_ns > total.max_ns) total.max_ns = latency[i].max_ns;
+		for(size_t bucket = 0; bucket < histogram_buckets; bucket++) total.histogram[bucket] += latency[i].histogram[bucket];
+	}
+	std::printf("%-8s %zu setter threads: %6.2f M calls/s, latency p50 < %5lu ns, p99 < %6lu ns, p99.99 < %8lu ns, max %8lu ns, %5lu frames/s\n",
+		name, threads, total.calls / (run_ms * 1000.0), percentile_ns(total, 0.5), percentile_ns(total, 0.99), percentile_ns(total, 0.9999), total.max_ns, frames * 1000 / run_ms);
+}
+
+int main(int argc, char **argv) {
+
+	unsigned long const run_ms = (argc > 1) ? std::strtoul(argv[1], 0, 10) : 1000;
+
+	// one device for the reference and one for lxr_hp_motor_control
+	char slave_names[2][64] = {{0}};
+	for(size_t i = 0; i < 2; i++) {
+		int master_fd = -1, slave_fd = -1;
+		if(openpty(&master_fd, &slave_fd, slave_names[i], 0, 0) != 0) {
+			std::perror("openpty");
+			return EXIT_FAILURE;
+		}
+		struct termios tio;
+		tcgetattr(master_fd, &tio);
+		cfmakeraw(&tio);
+		tcsetattr(master_fd, TCSANOW, &tio);
+		boost::thread device(boost::bind(&device_func, master_fd));
+		device.detach();
+	}
+
+	mutex_setpoint reference(slave_names[0]);
+	boost::thread reference_com(boost::bind(&mutex_setpoint::com_thread_func, &reference));
+	for(size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) run("mutex", reference, thread_counts[i], run_ms);
+
+	lxr_hp_motor_control mc(slave_names[1], 128, E_PIPELINED);
+	// the com threads start sending after two seconds
+	boost::this_thread::sleep(boost::posix_time::milliseconds(2500));
+	for(size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) run("atomic", mc, thread_counts[i], run_ms);
+
+	// the com threads block in their reads, the process is ended without destroying them
+	std::fflush(stdout);
+	_exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,219 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief this module multiplexes several serial_motor_driver.ino devices with different ids over one serial port
+ * @file lxr_hp_motor_bus.cpp
+ * @license MPL 2.0
+ */
+
+#include "lxr_hp_motor_bus.h"
+#include <boost/bind.hpp>
+
+// definitions of the class constants, required since they are bound to const references by boost::posix_time
+size_t const lxr_hp_motor_bus::m_baudrate;
+size_t const lxr_hp_motor_bus::m_keep_alive_ms;
+size_t const lxr_hp_motor_bus::m_reply_timeout_ms;
+
+/**
+ * @brief sets the speed of the motor
+ */
+void lxr_hp_motor_bus::motor_handle::set_speed(unsigned char const speed) {
+	{
+		boost::lock_guard<boost::mutex> lock(m_bus->m_mutex);
+		s_motor &motor = m_bus->m_motors[m_index];
+		if(motor.speed != speed) motor.setpoint_changed = true;
+		motor.speed = speed;
+	}
+	m_bus->m_bus_cond.notify_one();
+}
+
+/**
+ * @brief sets the direction of the motor
+ */
+void lxr_hp_motor_bus::motor_handle::set_direction(E_MOTOR_DIRECTION const dir) {
+	{
+		boost::lock_guard<boost::mutex> lock(m_bus->m_mutex);
+		s_motor &motor = m_bus->m_motors[m_index];
+		if(motor.direction != dir) motor.setpoint_changed = true;
+		motor.direction = dir;
+	}
+	m_bus->m_bus_cond.notify_one();
+}
+
+/**
+ * @brief register a function which is to be called in case of an error concerning this motor
+ */
+void lxr_hp_motor_bus::motor_handle::register_error_callback(error_callback cb) {
+	boost::lock_guard<boost::mutex> lock(m_bus->m_mutex);
+	if(cb != 0) m_bus->m_motors[m_index].error_cb_func = cb;
+}
+
+/**
+ * @brief returns the id of the motor
+ */
+unsigned char lxr_hp_motor_bus::motor_handle::id() const {
+	boost::lock_guard<boost::mutex> lock(m_bus->m_mutex);
+	return m_bus->m_motors[m_index].id;
+}
+
+/**
+ * @brief Constructor
+ * @param devNode string of the device node where the bus is connected with the pc
+ * @param scheduling selects which motor is served next
+ */
+lxr_hp_motor_bus::lxr_hp_motor_bus(std::string const &devNode, E_BUS_SCHEDULING const scheduling) : m_serial(devNode, m_baudrate), m_scheduling(scheduling), m_next_motor(0) {
+	m_bus_thread = boost::thread(boost::bind(&lxr_hp_motor_bus::bus_thread_func, this));
+}
+
+/**
+ * @brief Destructor
+ */
+lxr_hp_motor_bus::~lxr_hp_motor_bus() {
+	// the bus thread is interrupted while waiting for the next frame to become due or after the pending reply has been received
+	m_bus_thread.interrupt();
+	m_bus_thread.join();
+}
+
+/**
+ * @brief registers a motor with the bus
+ * @param id the id which is programmed in the arduino, value of the define SERIAL_MOTOR_DRIVER_ID in serial_motor_driver.ino
+ * @param priority only used with E_PRIORITY scheduling, higher values are served first
+ * @return handle for accessing the motor
+ */
+lxr_hp_motor_bus::motor_handle lxr_hp_motor_bus::register_motor(unsigned char const id, unsigned char const priority) {
+	size_t index = 0;
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		for(; index < m_motors.size(); index++) {
+			if(m_motors[index].id == id) break;
+		}
+		if(index == m_motors.size()) {
+			s_motor const motor = {id, priority, 0, E_FWD, true, boost::system_time(), 0};
+			m_motors.push_back(motor);
+		} else {
+			m_motors[index].priority = priority;
+		}
+	}
+	m_bus_cond.notify_one();
+	return motor_handle(*this, index);
+}
+
+/**
+ * @brief this is the function executed by the bus thread
+ */
+void lxr_hp_motor_bus::bus_thread_func() {
+
+	sleep(2); // delay two seconds to allow serial device to be fully initialized
+
+	for(;;) {
+		unsigned char msg_buf[lxr_hp_protocol::msg_size] = {0};
+		size_t index = 0;
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			for(;;) {
+				boost::system_time const now = boost::get_system_time();
+				index = select_next_motor(now);
+				if(index < m_motors.size()) break;
+				if(m_motors.empty()) m_bus_cond.wait(lock);
+				else m_bus_cond.timed_wait(lock, next_keep_alive());
+			}
+			s_motor &motor = m_motors[index];
+			lxr_hp_protocol::build_message(msg_buf, motor.id, motor.direction, motor.speed);
+			motor.setpoint_changed = false;
+			motor.last_sent = boost::get_system_time();
+			m_next_motor = (index + 1) % m_motors.size();
+		}
+
+		// send the message and wait for the reply of the addressed device before the bus is used again
+		m_serial.writeToSerial(msg_buf, lxr_hp_protocol::msg_size);
+		boost::posix_time::ptime const deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(m_reply_timeout_ms);
+		while(m_serial.bytesAvailable() < lxr_hp_protocol::reply_size && m_serial.fillRxBuffer(deadline)) { }
+
+		if(m_serial.bytesAvailable() >= lxr_hp_protocol::reply_size) {
+			unsigned char reply[lxr_hp_protocol::reply_size] = {0};
+			m_serial.readFromSerial(reply, lxr_hp_protocol::reply_size);
+			route_reply(reply, index);
+		} else {
+			// the part of a reply which has arrived too late would be taken as the start of the next one
+			m_serial.discardRxBuffer();
+			error_callback cb = 0;
+			{
+				boost::lock_guard<boost::mutex> lock(m_mutex);
+				cb = m_motors[index].error_cb_func;
+			}
+			if(cb != 0) cb(TIMEOUT);
+		}
+
+		boost::this_thread::interruption_point();
+	}
+}
+
+/**
+ * @brief selects the motor which is served next - m_mutex has to be held by the caller
+ * @return index of the motor or m_motors.size() if no motor is due
+ */
+size_t lxr_hp_motor_bus::select_next_motor(boost::system_time const &now) const {
+	size_t const motor_cnt = m_motors.size();
+
+	// motors whose keep alive period has expired are served first, otherwise a motor whose setpoint changes faster than
+	// the round trip of the bus would keep the others silent until their sketches stop after SERIAL_TIMEOUT_MS
+	for(size_t i = 0; i < motor_cnt; i++) {
+		size_t const index = (m_next_motor + i) % motor_cnt;
+		if(now >= m_motors[index].last_sent + boost::posix_time::milliseconds(m_keep_alive_ms)) return index;
+	}
+
+	// then the motors with a changed setpoint, the search starts after the motor served last
+	size_t selected = motor_cnt;
+	for(size_t i = 0; i < motor_cnt; i++) {
+		size_t const index = (m_next_motor + i) % motor_cnt;
+		if(!m_motors[index].setpoint_changed) continue;
+		if(m_scheduling == E_ROUND_ROBIN) return index;
+		if(selected == motor_cnt || m_motors[index].priority > m_motors[selected].priority) selected = index;
+	}
+	if(selected < motor_cnt) return selected;
+
+	return motor_cnt;
+}
+
+/**
+ * @brief returns the point in time when the next keep alive frame is due - m_mutex has to be held by the caller
+ */
+boost::system_time lxr_hp_motor_bus::next_keep_alive() const {
+	boost::system_time oldest = m_motors.front().last_sent;
+	for(size_t i = 1; i < m_motors.size(); i++) {
+		if(m_motors[i].last_sent < oldest) oldest = m_motors[i].last_sent;
+	}
+	return oldest + boost::posix_time::milliseconds(m_keep_alive_ms);
+}
+
+/**
+ * @brief routes a reply to the motor with the id contained in the reply
+ */
+void lxr_hp_motor_bus::route_reply(unsigned char const *reply, size_t const sent_to_index) {
+	size_t err_code = NO_ERROR;
+	error_callback cb = 0;
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		// a reply carrying an unknown id is accounted to the motor the frame was sent to
+		size_t index = sent_to_index;
+		unsigned char const id = lxr_hp_protocol::reply_id(reply);
+		for(size_t i = 0; i < m_motors.size(); i++) {
+			if(m_motors[i].id == id) { index = i; break; }
+		}
+		err_code = lxr_hp_protocol::evaluate_reply(reply, m_motors[index].id);
+		// a reply from a different motor means the addressed one did not answer
+		if(index != sent_to_index) {
+			err_code |= ID_WRONG;
+			index = sent_to_index;
+		}
+		cb = m_motors[index].error_cb_func;
+	}
+
+	// in case of error call the registered error callback function
+	if(err_code != NO_ERROR) {
+		if(cb != 0) cb(err_code);
+	}
+}
@@ -0,0 +1,133 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief this module multiplexes several serial_motor_driver.ino devices with different ids over one serial port
+ * @file lxr_hp_motor_bus.h
+ * @license MPL 2.0
+ */
+
+#ifndef LXR_HP_MOTOR_BUS_H_
+#define LXR_HP_MOTOR_BUS_H_
+
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "serial.h"
+#include "lxr_hp_protocol.h"
+
+// typedef for the scheduling of the frames on the bus, a motor whose keep alive period has expired is always served before changed setpoints
+// E_ROUND_ROBIN: motors with a changed setpoint are served in the order of their registration
+// E_PRIORITY: the motor with the highest priority and a changed setpoint is served first
+typedef enum {E_ROUND_ROBIN = 0, E_PRIORITY = 1} E_BUS_SCHEDULING;
+
+class lxr_hp_motor_bus {
+public:
+	/**
+	 * @brief handle to one motor registered with the bus
+	 */
+	class motor_handle {
+	public:
+		/**
+		 * @brief sets the speed of the motor
+		 */
+		void set_speed(unsigned char const speed);
+
+		/**
+		 * @brief sets the direction of the motor
+		 */
+		void set_direction(E_MOTOR_DIRECTION const dir);
+
+		/**
+		 * @brief register a function which is to be called in case of an error concerning this motor
+		 */
+		void register_error_callback(error_callback cb);
+
+		/**
+		 * @brief returns the id of the motor
+		 */
+		unsigned char id() const;
+
+	private:
+		friend class lxr_hp_motor_bus;
+
+		motor_handle(lxr_hp_motor_bus &bus, size_t const index) : m_bus(&bus), m_index(index) { }
+
+		lxr_hp_motor_bus *m_bus;
+		size_t m_index;
+	};
+
+	/**
+	 * @brief Constructor
+	 * @param devNode string of the device node where the bus is connected with the pc
+	 * @param scheduling selects which motor is served next
+	 */
+	lxr_hp_motor_bus(std::string const &devNode, E_BUS_SCHEDULING const scheduling = E_ROUND_ROBIN);
+
+	/**
+	 * @brief Destructor
+	 */
+	~lxr_hp_motor_bus();
+
+	/**
+	 * @brief registers a motor with the bus
+	 * @param id the id which is programmed in the arduino, value of the define SERIAL_MOTOR_DRIVER_ID in serial_motor_driver.ino
+	 * @param priority only used with E_PRIORITY scheduling, higher values are served first
+	 * @return handle for accessing the motor
+	 */
+	motor_handle register_motor(unsigned char const id, unsigned char const priority = 0);
+
+protected:
+	static size_t const m_baudrate = 115200;
+	static size_t const m_keep_alive_ms = 100;
+	// a motor which does not answer within this time is reported with TIMEOUT, the bus then serves the next one
+	static size_t const m_reply_timeout_ms = 50;
+
+private:
+	typedef struct {
+		unsigned char id;
+		unsigned char priority;
+		unsigned char speed;
+		E_MOTOR_DIRECTION direction;
+		bool setpoint_changed;
+		boost::system_time last_sent;
+		error_callback error_cb_func;
+	} s_motor;
+
+	serial m_serial;
+
+	E_BUS_SCHEDULING m_scheduling;
+	std::vector<s_motor> m_motors;
+	size_t m_next_motor;
+
+	boost::mutex m_mutex;
+	boost::condition_variable m_bus_cond;
+
+	boost::thread m_bus_thread;
+
+	/**
+	 * @brief this is the function executed by the bus thread
+	 */
+	void bus_thread_func();
+
+	/**
+	 * @brief selects the motor which is served next - m_mutex has to be held by the caller
+	 * @return index of the motor or m_motors.size() if no motor is due
+	 */
+	size_t select_next_motor(boost::system_time const &now) const;
+
+	/**
+	 * @brief returns the point in time when the next keep alive frame is due - m_mutex has to be held by the caller
+	 */
+	boost::system_time next_keep_alive() const;
+
+	/**
+	 * @brief routes a reply to the motor with the id contained in the reply
+	 */
+	void route_reply(unsigned char const *reply, size_t const sent_to_index);
+};
+
+#endif /* LXR_HP_MOTOR_BUS_H_ */
@@ -13,45 +13,183 @@
 #include <boost/bind.hpp>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+
+// definitions of the class constants, required since they are bound to const references by boost::posix_time
+size_t const lxr_hp_motor_control::m_baudrate;
+size_t const lxr_hp_motor_control::m_com_thread_sleep_ms;
+size_t const lxr_hp_motor_control::m_max_frames_in_flight;
+size_t const lxr_hp_motor_control::m_telemetry_queue_size;
+size_t const lxr_hp_motor_control::m_trajectory_queue_size;
+size_t const lxr_hp_motor_control::m_max_upload_retransmits;
+size_t const lxr_hp_motor_control::m_default_reply_timeout_ms;
+size_t const lxr_hp_motor_control::m_max_timeout_retransmits;
+size_t const lxr_hp_motor_control::m_device_timeout_ms;
+size_t const lxr_hp_motor_control::m_start_up_delay_ms;
+
+static unsigned int const max_speed = 255;
+
+/**
+ * @brief packs speed and direction into one setpoint word
+ */
+static unsigned short pack_setpoint(E_MOTOR_DIRECTION const dir, unsigned char const speed) {
+	return static_cast<unsigned short>((static_cast<unsigned int>(dir) << 8) | speed);
+}
+
+/**
+ * @brief Constructor of the statistics, all counters start at zero
+ */
+lxr_hp_motor_control::s_atomic_statistics::s_atomic_statistics() : frames(0), replies(0), lost(0), timeouts(0), retransmits(0), max_rtt_us(0) {
+	for(size_t bucket = 0; bucket < rtt_histogram_buckets; bucket++) rtt_histogram[bucket].store(0);
+}
 
 /**
  * @brief Constructor
  * @param devNode string of the device node where the arduino is connected with the pc
  * @param id the id which is programmed in the connected arduino, value of the define SERIAL_MOTOR_DRIVER_ID in serial_motor_driver.ino
+ * @param com_mode selects how frames are scheduled on the serial line
+ * @param baud_rate the baud rate which is negotiated with protocol version 2
  */
-lxr_hp_motor_control::lxr_hp_motor_control(std::string const &devNode, unsigned char const id) : m_serial(devNode, m_baudrate), m_id(id), m_speed(0), m_direction(E_FWD), m_error_flag(false), m_com_thread(boost::bind(&lxr_hp_motor_control::com_thread_func, this)), m_error_cb_func(0) {
+lxr_hp_motor_control::lxr_hp_motor_control(std::string const &devNode, unsigned char const id, E_COM_MODE const com_mode, E_BAUD_RATE const baud_rate) : m_serial(devNode, m_baudrate), m_id(id), m_baud_rate(baud_rate), m_negotiation_step(E_NEGOTIATE_VERSION), m_is_handshake_rejected(false), m_protocol_version(lxr_hp_protocol::protocol_version_1), m_tx_seq(0), m_rx_seq(0), m_setpoint(pack_setpoint(E_FWD, 0)), m_error_flag(false), m_com_mode(com_mode), m_setpoint_changed(false), m_frames_in_flight(0), m_tx_frame_record(0), m_rx_frame_record(0), m_reply_timeout_ms(m_default_reply_timeout_ms), m_consecutive_timeouts(0), m_is_retransmit_due(false), m_telemetry_period_ms(0), m_telemetry_cmd_pending(false), m_is_trajectory_active(false), m_trajectory_generation(0), m_is_trajectory_frame_in_flight(false), m_trajectory_upload_count(0), m_trajectory_upload_generation(0), m_trajectory_device_free(lxr_hp_protocol::trajectory_buffer_size), m_upload_frame_size(0), m_upload_seq(0), m_upload_retransmits(0), m_is_upload_retransmit_pending(false), m_com_event(0), m_is_renegotiation_due(false), m_rx_event(0), m_is_reactor(false), m_strand(m_serial.getIoService()), m_timer(m_serial.getIoService()), m_is_timer_expired(false), m_reply_timer(m_serial.getIoService()), m_is_write_pending(false), m_is_shutting_down(false), m_is_pump_posted(false), m_pending_handlers(0), m_shutdown_event(0), m_error_cb_func(0) {
+	if(m_com_mode == E_PIPELINED) {
+		// the transmit thread starts the receive thread once the protocol has been negotiated
+		m_com_thread = boost::thread(boost::bind(&lxr_hp_motor_control::tx_thread_func, this));
+	} else {
+		m_com_thread = boost::thread(boost::bind(&lxr_hp_motor_control::com_thread_func, this));
+	}
+}
 
+/**
+ * @brief Constructor for an instance whose frames are sent and received by the threads of a shared reactor without blocking
+ * the error callback is then called from the threads of the reactor, the instance must not be destroyed from within the callback
+ * @param reactor has to outlive the instance
+ */
+lxr_hp_motor_control::lxr_hp_motor_control(lxr_hp_reactor &reactor, std::string const &devNode, unsigned char const id, E_COM_MODE const com_mode, E_BAUD_RATE const baud_rate) : m_serial(reactor.get_io_service(), devNode, m_baudrate), m_id(id), m_baud_rate(baud_rate), m_negotiation_step(E_NEGOTIATE_VERSION), m_is_handshake_rejected(false), m_protocol_version(lxr_hp_protocol::protocol_version_1), m_tx_seq(0), m_rx_seq(0), m_setpoint(pack_setpoint(E_FWD, 0)), m_error_flag(false), m_com_mode(com_mode), m_setpoint_changed(false), m_frames_in_flight(0), m_tx_frame_record(0), m_rx_frame_record(0), m_reply_timeout_ms(m_default_reply_timeout_ms), m_consecutive_timeouts(0), m_is_retransmit_due(false), m_telemetry_period_ms(0), m_telemetry_cmd_pending(false), m_is_trajectory_active(false), m_trajectory_generation(0), m_is_trajectory_frame_in_flight(false), m_trajectory_upload_count(0), m_trajectory_upload_generation(0), m_trajectory_device_free(lxr_hp_protocol::trajectory_buffer_size), m_upload_frame_size(0), m_upload_seq(0), m_upload_retransmits(0), m_is_upload_retransmit_pending(false), m_com_event(0), m_is_renegotiation_due(false), m_rx_event(0), m_is_reactor(true), m_strand(m_serial.getIoService()), m_timer(m_serial.getIoService()), m_is_timer_expired(false), m_reply_timer(m_serial.getIoService()), m_is_write_pending(false), m_is_shutting_down(false), m_is_pump_posted(false), m_pending_handlers(0), m_shutdown_event(0), m_error_cb_func(0) {
+	// the negotiation starts once the timer has expired, the replies are received from the start
+	start_timer(m_start_up_delay_ms);
+	start_read();
 }
 
 /**
  * @brief Destructor
  */
 lxr_hp_motor_control::~lxr_hp_motor_control() {
-
+	if(m_is_reactor) {
+		// the handlers access the members, the instance is only destroyed once none of them is pending any more
+		m_pending_handlers++;
+		m_strand.post(boost::bind(&lxr_hp_motor_control::on_shutdown, this));
+		m_shutdown_event.wait();
+	} else {
+		// the threads wait on the semaphores which must not be destroyed while they are in use, their reads end at the reply deadline at the latest
+		m_com_thread.interrupt();
+		m_com_event.post();
+		m_com_thread.join();
+		// the transmit thread starts the receive thread, which has therefore either been started or will never be
+		if(m_rx_thread.joinable()) {
+			m_rx_thread.interrupt();
+			m_rx_event.post();
+			m_rx_thread.join();
+		}
+	}
 }
 
 /**
- * @brief sets the speed of the motor
+ * @brief sets the speed of the motor - lock free, never blocks behind the communication threads
+ * the setters end a running trajectory, its points which have not been executed yet are discarded
  */
 void lxr_hp_motor_control::set_speed(unsigned char const speed) {
-	boost::lock_guard<boost::mutex> lock(m_mutex);
-	m_speed = speed;
+	// the direction is kept, the loop only repeats if another thread has changed the setpoint in the meantime
+	unsigned short previous = m_setpoint.load(boost::memory_order_relaxed);
+	unsigned short setpoint = 0;
+	do {
+		setpoint = static_cast<unsigned short>((previous & 0xFF00) | speed);
+	} while(!m_setpoint.compare_exchange_weak(previous, setpoint));
+	notify_setpoint(previous, setpoint);
 }
 
 /**
- * @brief sets the direction of the motor
+ * @brief sets the direction of the motor - lock free, never blocks behind the communication threads
  */
 void lxr_hp_motor_control::set_direction(E_MOTOR_DIRECTION const dir) {
-	boost::lock_guard<boost::mutex> lock(m_mutex);
-	m_direction = dir;
+	unsigned short previous = m_setpoint.load(boost::memory_order_relaxed);
+	unsigned short setpoint = 0;
+	do {
+		setpoint = pack_setpoint(dir, static_cast<unsigned char>(previous & 0xFF));
+	} while(!m_setpoint.compare_exchange_weak(previous, setpoint));
+	notify_setpoint(previous, setpoint);
+}
+
+/**
+ * @brief sets speed and direction together, so that they are never sent mismatched - wait free
+ * @param velocity -255 (full speed backward) to 255 (full speed forward), values beyond are limited
+ */
+void lxr_hp_motor_control::set_velocity(int const velocity) {
+	int const limited = std::max(-static_cast<int>(max_speed), std::min(static_cast<int>(max_speed), velocity));
+	unsigned short const setpoint = (limited < 0) ? pack_setpoint(E_BWD, static_cast<unsigned char>(-limited)) : pack_setpoint(E_FWD, static_cast<unsigned char>(limited));
+	notify_setpoint(m_setpoint.exchange(setpoint), setpoint);
 }
 
 /**
- * @brief register a function which is to be called in case of an error
+ * @brief register a function which is to be called in case of an error - wait free
  */
 void lxr_hp_motor_control::register_error_callback(error_callback cb) {
-	boost::lock_guard<boost::mutex> lock(m_mutex);
-	if(cb != 0) m_error_cb_func = cb;
+	if(cb != 0) m_error_cb_func.store(cb);
+}
+
+/**
+ * @brief configures the current telemetry stream of the device - wait free
+ * @param period_ms period of the telemetry samples (minimum 5 ms), 0 turns the stream off
+ */
+void lxr_hp_motor_control::enable_telemetry(unsigned char const period_ms) {
+	m_telemetry_period_ms.store(period_ms);
+	if(!m_telemetry_cmd_pending.exchange(true)) notify_com_thread();
+}
+
+/**
+ * @brief queues points of a trajectory which the device executes on its own timer, the points are uploaded while the trajectory buffer of the device has space
+ * lock free, but must only be called by one producer thread at a time and not concurrently with the setters
+ * @return the number of queued points, less than count if the queue is full
+ */
+size_t lxr_hp_motor_control::push_trajectory(s_trajectory_point const *points, size_t const count) {
+	unsigned int const generation = m_trajectory_generation.load();
+	size_t queued = 0;
+	for(; queued < count; queued++) {
+		s_queued_trajectory_point const queued_point = {points[queued], generation};
+		if(!m_trajectory_queue.push(queued_point)) break;
+	}
+	if(queued > 0) {
+		m_is_trajectory_active.store(true);
+		notify_com_thread();
+	}
+	return queued;
+}
+
+/**
+ * @brief fetches the oldest received telemetry sample - lock free, but must only be called by one consumer thread at a time
+ * @return false if no sample is available
+ */
+bool lxr_hp_motor_control::pop_telemetry(s_telemetry_sample &sample) {
+	return m_telemetry_queue.pop(sample);
+}
+
+/**
+ * @brief sets the time a frame may wait for its reply before it is sent again, TIMEOUT is reported once the retransmits are exhausted - wait free
+ */
+void lxr_hp_motor_control::set_reply_timeout(size_t const timeout_ms) {
+	m_reply_timeout_ms.store(timeout_ms);
+}
+
+/**
+ * @brief copies the statistics of the serial communication - wait free, the counters are copied one after another
+ */
+void lxr_hp_motor_control::get_statistics(s_com_statistics &statistics) const {
+	statistics.frames = m_statistics.frames.load();
+	statistics.replies = m_statistics.replies.load();
+	statistics.lost = m_statistics.lost.load();
+	statistics.timeouts = m_statistics.timeouts.load();
+	statistics.retransmits = m_statistics.retransmits.load();
+	statistics.max_rtt_us = m_statistics.max_rtt_us.load();
+	for(size_t bucket = 0; bucket < rtt_histogram_buckets; bucket++) statistics.rtt_histogram[bucket] = m_statistics.rtt_histogram[bucket].load();
 }
 
 /**
@@ -63,59 +201,756 @@ std::string lxr_hp_motor_control::convert_to_string(size_t const err_code) {
 	if(err_code & ID_WRONG) ss << "Wrong ID received" << std::endl;
 	if(err_code & STATUS_WRONG) ss << "Error status received" << std::endl;
 	if(err_code & CS_WRONG) ss << "Checksum error" << std::endl;
+	if(err_code & SEQ_WRONG) ss << "Frame lost" << std::endl;
+	if(err_code & TIMEOUT) ss << "Reply timeout" << std::endl;
 
 	return ss.str();
 }
 
-#define STATUS_ERROR                (0)
-#define STATUS_OK                   (1)
+/**
+ * @brief returns the upper bound of the histogram bucket which contains the given fraction of the round trip times
+ */
+unsigned long lxr_hp_motor_control::rtt_percentile_us(s_com_statistics const &statistics, double const fraction) {
+	unsigned long replies = 0;
+	for(size_t bucket = 0; bucket < rtt_histogram_buckets; bucket++) replies += statistics.rtt_histogram[bucket];
+	unsigned long const limit = static_cast<unsigned long>(replies * fraction);
+	unsigned long sum = 0;
+	for(size_t bucket = 0; bucket < rtt_histogram_buckets; bucket++) {
+		sum += statistics.rtt_histogram[bucket];
+		if(sum >= limit) return 2UL << bucket;
+	}
+	return statistics.max_rtt_us;
+}
+
+static size_t const max_msg_size = lxr_hp_protocol::max_msg_size;
+static size_t const max_frame_size = lxr_hp_protocol::max_frame_size;
+static size_t const max_reply_size = lxr_hp_protocol::max_reply_size;
 
 /**
  * @brief this is the function executed by the communication thread
  */
 void lxr_hp_motor_control::com_thread_func() {
 
-	sleep(2); // delay two seconds to allow serial device to be fully initialized
+	boost::this_thread::sleep(boost::posix_time::milliseconds(m_start_up_delay_ms)); // delay to allow serial device to be fully initialized
+
+	negotiate_protocol();
 
 	for(;;) {
+		boost::this_thread::interruption_point();
+
 		// build the message for sending down
-		size_t const msg_size = 4;
-		unsigned char msg_buf[4] = {0};
+		unsigned char frame_buf[max_frame_size] = {0};
+		size_t const frame_size = build_next_frame(frame_buf, m_is_trajectory_active.load());
 
-		enum {E_MSG_ID = 0, E_MSG_DIR = 1, E_MSG_SPEED = 2, E_MSG_CS = 3};
+		//for(size_t i=0; i<frame_size; i++) std::cout << std::hex << "frame_buf[" << i << "] = 0x" << static_cast<size_t>(frame_buf[i]) << std::endl;
 
-		msg_buf[E_MSG_ID] = m_id;
-		{
-			boost::lock_guard<boost::mutex> lock(m_mutex);
-			msg_buf[E_MSG_DIR] = static_cast<unsigned char>(m_direction);
-			msg_buf[E_MSG_SPEED] = m_speed;
+		// send the message
+		m_frames_in_flight++;
+		m_serial.writeToSerial(frame_buf, frame_size);
+
+		// receive the reply
+		unsigned char reply[max_reply_size] = {0};
+		size_t lost_frames = 0;
+		size_t frame_err_code = NO_ERROR;
+		if(receive_reply(reply, lost_frames, frame_err_code, reply_deadline())) {
+			// evaluate the reply
+			evaluate_reply(reply, frame_err_code, true);
+			complete_frames(lost_frames);
+		} else if(handle_reply_timeout()) {
+			restart_negotiation();
+			wait_for_device_timeout();
+			negotiate_protocol();
 		}
-		msg_buf[E_MSG_CS] = msg_buf[E_MSG_ID] ^ msg_buf[E_MSG_DIR] ^ msg_buf[E_MSG_SPEED];
 
-		//for(size_t i=0; i<msg_size; i++) std::cout << std::hex << "msg_buf[" << i << "] = 0x" << static_cast<size_t>(msg_buf[i]) << std::endl;
+		//for(size_t i=0; i<reply_size; i++) std::cout << std::hex << "reply[" << i << "] = 0x" << static_cast<size_t>(reply[i]) << std::endl;
 
-		// send the message
-		m_serial.writeToSerial(msg_buf, msg_size);
+		// the remaining points of a trajectory are uploaded without a pause as long as the device has space for them, a frame without reply is sent again right away
+		if(!is_trajectory_upload_due() && !m_is_retransmit_due.load()) boost::this_thread::sleep(boost::posix_time::milliseconds(m_com_thread_sleep_ms));
+	}
+}
 
-		// receive the reply
-		size_t const reply_size = 3;
-		boost::shared_ptr<unsigned char> reply = m_serial.readFromSerial(reply_size);
+/**
+ * @brief this is the function executed by the transmit thread in pipelined mode
+ */
+void lxr_hp_motor_control::tx_thread_func() {
+
+	boost::this_thread::sleep(boost::posix_time::milliseconds(m_start_up_delay_ms)); // delay to allow serial device to be fully initialized
+
+	negotiate_protocol();
+	m_rx_thread = boost::thread(boost::bind(&lxr_hp_motor_control::rx_thread_func, this));
+
+	for(;;) {
+		// wait until a setpoint has changed and a slot is free - if nothing changes within m_com_thread_sleep_ms
+		// the current setpoint is repeated to keep the emergency stop timeout of the arduino from expiring
+		// while a trajectory is active or an upload waits for its reply the frames are sent one at a time, so that the reply to an upload is known
+		// before the next frame is built - a setter may end the trajectory while its upload is in flight, the upload state then stays with the receive thread
+		boost::posix_time::ptime keep_alive = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(m_com_thread_sleep_ms);
+		bool is_trajectory_active = false;
+		for(;;) {
+			// the receive thread waits until the protocol has been negotiated again
+			if(m_is_renegotiation_due.load()) {
+				restart_negotiation();
+				wait_for_device_timeout();
+				negotiate_protocol();
+				m_is_renegotiation_due.store(false);
+				m_rx_event.post();
+			}
+			is_trajectory_active = m_is_trajectory_active.load();
+			size_t const max_frames_in_flight = (is_trajectory_active || m_is_trajectory_frame_in_flight.load()) ? 1 : m_max_frames_in_flight;
+			bool const is_slot_free = m_frames_in_flight < max_frames_in_flight;
+			if(is_slot_free && (m_setpoint_changed || m_telemetry_cmd_pending || m_is_retransmit_due || (is_trajectory_active && is_trajectory_upload_due()))) break;
+			// a post can be left over from a change which has already been sent, the conditions are checked again
+			bool const is_notified = m_com_event.timed_wait(keep_alive);
+			boost::this_thread::interruption_point();
+			if(!is_notified) {
+				if(m_frames_in_flight < max_frames_in_flight) break;
+				keep_alive = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(m_com_thread_sleep_ms);
+			}
+		}
+		unsigned char frame_buf[max_frame_size] = {0};
+		size_t const frame_size = build_next_frame(frame_buf, is_trajectory_active);
+		m_frames_in_flight++;
+
+		// send the message, the reply is collected by the receive thread
+		m_serial.writeToSerial(frame_buf, frame_size);
+	}
+}
+
+/**
+ * @brief this is the function executed by the receive thread in pipelined mode
+ */
+void lxr_hp_motor_control::rx_thread_func() {
+	for(;;) {
+		boost::this_thread::interruption_point();
+
+		// the arduino processes the frames in the order of their arrival, therefore every reply belongs to the oldest frame in flight
+		// without a frame in flight the telemetry is received for one reply timeout, a frame sent in the meantime is therefore overdue after two at the latest
+		bool const is_frame_in_flight = m_frames_in_flight.load() > 0;
+		boost::posix_time::ptime const deadline = is_frame_in_flight ? reply_deadline() : boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(m_reply_timeout_ms.load());
+		unsigned char reply[max_reply_size] = {0};
+		size_t lost_frames = 0;
+		size_t frame_err_code = NO_ERROR;
+		if(!receive_reply(reply, lost_frames, frame_err_code, deadline)) {
+			if(is_frame_in_flight && handle_reply_timeout()) {
+				m_is_renegotiation_due.store(true);
+				notify_com_thread();
+				m_rx_event.wait();
+			}
+			notify_com_thread();
+			continue;
+		}
+
+		// the reply to an upload has to be evaluated before the transmit thread may send the next one
+		evaluate_reply(reply, frame_err_code | ((lost_frames > 0) ? SEQ_WRONG : NO_ERROR), true);
+
+		// only this thread decrements the counter
+		complete_frames(lost_frames);
+		notify_com_thread();
+	}
+}
+
+/**
+ * @brief switches the device to protocol version 2 and the baud rate - a device without support for it is kept at protocol version 1
+ */
+void lxr_hp_motor_control::negotiate_protocol() {
+	while(m_negotiation_step != E_NEGOTIATED) {
+		unsigned char frame_buf[max_frame_size] = {0};
+		size_t const frame_size = build_negotiation_frame(frame_buf);
+		if(evaluate_negotiation_reply(exchange(frame_buf, frame_size))) wait_for_device_timeout();
+	}
+}
+
+/**
+ * @brief threads only: stays silent until the device has returned to its defaults, the bytes received in the meantime are dropped
+ */
+void lxr_hp_motor_control::wait_for_device_timeout() {
+	boost::posix_time::ptime const end = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(m_device_timeout_ms);
+	do {
+		boost::this_thread::interruption_point();
+		m_serial.discardRxBuffer();
+	} while(m_serial.fillRxBuffer(end));
+	m_serial.discardRxBuffer();
+}
+
+/**
+ * @brief returns to protocol version 1 at 115200 baud like the device does without a valid frame, the frames in flight are dropped
+ * the caller has to wait m_device_timeout_ms before the negotiation is started
+ */
+void lxr_hp_motor_control::restart_negotiation() {
+	m_rx_frame_record = (m_rx_frame_record + m_frames_in_flight.load()) % m_max_frames_in_flight;
+	m_frames_in_flight.store(0);
+	m_rx_seq = m_tx_seq;
+	m_protocol_version = lxr_hp_protocol::protocol_version_1;
+	m_serial.setBaudRate(lxr_hp_protocol::baud_rate_value(E_BAUD_115200));
+	m_negotiation_step = E_NEGOTIATE_VERSION;
+	m_consecutive_timeouts = 0;
+	m_is_retransmit_due.store(false);
+	// the emergency stop of the device has cleared its trajectory buffer, the next upload queries the free space
+	m_is_trajectory_frame_in_flight.store(false);
+	m_is_upload_retransmit_pending = false;
+	m_upload_retransmits = 0;
+	m_trajectory_device_free = 0;
+}
+
+/**
+ * @brief builds the frame of the current negotiation step
+ * @return the size of the frame
+ */
+size_t lxr_hp_motor_control::build_negotiation_frame(unsigned char *frame_buf) {
+	unsigned char msg_buf[lxr_hp_protocol::msg_size] = {0};
+	if(m_negotiation_step == E_NEGOTIATE_VERSION) {
+		// the handshake is a frame of protocol version 1, a device which does not know it replies with an error
+		lxr_hp_protocol::build_protocol_message(msg_buf, m_id, lxr_hp_protocol::protocol_version_2);
+		std::copy(msg_buf, msg_buf + sizeof(msg_buf), frame_buf);
+		record_frame(false);
+		return sizeof(msg_buf);
+	}
+	// the device switches once its reply has been sent
+	lxr_hp_protocol::build_baud_rate_message(msg_buf, m_id, m_baud_rate);
+	record_frame(false);
+	return lxr_hp_protocol::encode_frame(frame_buf, m_tx_seq++, msg_buf, sizeof(msg_buf));
+}
+
+/**
+ * @brief advances the negotiation according to the result of the current step
+ * @return true if the device has to return to its defaults before the negotiation is started again
+ */
+bool lxr_hp_motor_control::evaluate_negotiation_reply(size_t const err_code) {
+	// a step without reply is repeated, a device which has not answered any of the repetitions might be starting up or disconnected
+	if(err_code == TIMEOUT && m_is_retransmit_due.exchange(false)) return false;
+	m_consecutive_timeouts = 0;
+
+	if(m_negotiation_step == E_NEGOTIATE_VERSION) {
+		// only a valid error reply shows that the device does not know the handshake, a garbled one might stem from a device which is still at protocol version 2
+		if(err_code != NO_ERROR && err_code != STATUS_WRONG) return true;
+		m_is_handshake_rejected = !m_is_handshake_rejected && err_code == STATUS_WRONG;
+		if(m_is_handshake_rejected) return true;
+		if(err_code == NO_ERROR) m_protocol_version = lxr_hp_protocol::protocol_version_2;
+		m_negotiation_step = (err_code == NO_ERROR && m_baud_rate != E_BAUD_115200) ? E_NEGOTIATE_BAUD_RATE : E_NEGOTIATED;
+		return false;
+	}
+	if(err_code == NO_ERROR) {
+		m_serial.setBaudRate(lxr_hp_protocol::baud_rate_value(m_baud_rate));
+		m_negotiation_step = E_NEGOTIATED;
+		return false;
+	}
+	// whether the device has switched or not, without a valid frame it returns to protocol version 1 at 115200 baud
+	m_protocol_version = lxr_hp_protocol::protocol_version_1;
+	m_baud_rate = E_BAUD_115200;
+	m_negotiation_step = E_NEGOTIATE_VERSION;
+	return true;
+}
+
+/**
+ * @brief sends a frame and receives its reply, only used while the thread receiving the replies is not running
+ * @return NO_ERROR, TIMEOUT or the error code of the reply
+ */
+size_t lxr_hp_motor_control::exchange(unsigned char const *frame_buf, size_t const frame_size) {
+	m_frames_in_flight++;
+	m_serial.writeToSerial(frame_buf, frame_size);
+	unsigned char reply[max_reply_size] = {0};
+	size_t lost_frames = 0;
+	size_t frame_err_code = NO_ERROR;
+	if(!receive_reply(reply, lost_frames, frame_err_code, reply_deadline())) {
+		handle_reply_timeout();
+		return TIMEOUT;
+	}
+	complete_frames(lost_frames);
+	return (frame_err_code != NO_ERROR) ? frame_err_code : lxr_hp_protocol::evaluate_reply(reply, m_id);
+}
+
+/**
+ * @brief marks the setpoint as changed if it differs from the previous one or ends a trajectory and wakes up the transmit thread
+ */
+void lxr_hp_motor_control::notify_setpoint(unsigned short const previous, unsigned short const setpoint) {
+	// the setpoint frame also clears the trajectory buffer of the device, it has to be sent even if the setpoint is unchanged
+	bool const is_trajectory_ended = m_is_trajectory_active.load(boost::memory_order_relaxed) && m_is_trajectory_active.exchange(false);
+	if(is_trajectory_ended) m_trajectory_generation++;
+	if(previous == setpoint && !is_trajectory_ended) return;
+	// only the first change after the last frame has to wake up the transmit thread
+	if(!m_setpoint_changed.exchange(true)) notify_com_thread();
+}
+
+/**
+ * @brief wakes up the transmit thread in pipelined mode
+ */
+void lxr_hp_motor_control::notify_com_thread() {
+	if(m_com_mode != E_PIPELINED) return;
+	if(m_is_reactor) {
+		post_pump();
+	} else {
+		m_com_event.post();
+	}
+}
+
+/**
+ * @brief reactor mode: sends the next frame if one is due and the previous write has completed
+ */
+void lxr_hp_motor_control::pump() {
+	if(m_is_write_pending) return;
+
+	size_t frame_size = 0;
+	if(m_negotiation_step != E_NEGOTIATED) {
+		// one frame at a time once the start up delay or the timeout of the device has expired
+		if(!m_is_timer_expired || m_frames_in_flight.load() > 0) return;
+		frame_size = build_negotiation_frame(m_tx_frame);
+	} else {
+		// the same conditions as those of the threads, a frame is due when the timer has expired in both modes
+		bool const is_trajectory_active = m_is_trajectory_active.load();
+		size_t const max_frames_in_flight = (m_com_mode == E_PIPELINED && !is_trajectory_active && !m_is_trajectory_frame_in_flight.load()) ? m_max_frames_in_flight : 1;
+		if(m_frames_in_flight.load() >= max_frames_in_flight) return;
+		bool is_due = m_is_timer_expired || m_is_retransmit_due.load() || (is_trajectory_active && is_trajectory_upload_due());
+		if(m_com_mode == E_PIPELINED) is_due = is_due || m_setpoint_changed.load() || m_telemetry_cmd_pending.load();
+		if(!is_due) return;
+		frame_size = build_next_frame(m_tx_frame, is_trajectory_active);
+
+		// E_STOP_AND_WAIT restarts the timer with the reply, E_PIPELINED repeats the setpoint if nothing has been sent until the timer expires
+		if(m_com_mode == E_PIPELINED) {
+			start_timer(m_com_thread_sleep_ms);
+		} else {
+			m_is_timer_expired = false;
+		}
+	}
+
+	m_frames_in_flight++;
+	start_reply_timer();
+	m_is_write_pending = true;
+	m_pending_handlers++;
+	m_serial.asyncWriteToSerial(m_tx_frame, frame_size, m_strand.wrap(boost::bind(&lxr_hp_motor_control::on_write, this, boost::asio::placeholders::error)));
+}
+
+/**
+ * @brief reactor mode: queues a pump handler in the strand, can be called from any thread
+ */
+void lxr_hp_motor_control::post_pump() {
+	if(m_is_pump_posted.exchange(true)) return;
+	m_pending_handlers++;
+	m_strand.post(boost::bind(&lxr_hp_motor_control::on_pump, this));
+}
+
+/**
+ * @brief reactor mode: (re)starts the timer, m_is_timer_expired is set when it expires
+ */
+void lxr_hp_motor_control::start_timer(size_t const timeout_ms) {
+	m_is_timer_expired = false;
+	// a pending wait is aborted
+	m_timer.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+	m_pending_handlers++;
+	m_timer.async_wait(m_strand.wrap(boost::bind(&lxr_hp_motor_control::on_timer, this, boost::asio::placeholders::error)));
+}
+
+/**
+ * @brief reactor mode: (re)starts the reply timer for the oldest frame in flight
+ */
+void lxr_hp_motor_control::start_reply_timer() {
+	if(m_frames_in_flight.load() == 0) return;
+	// the wait for the oldest frame is already pending unless that frame has changed
+	boost::posix_time::ptime const deadline = reply_deadline();
+	if(m_reply_timer.expires_at() == deadline) return;
+	m_reply_timer.expires_at(deadline);
+	m_pending_handlers++;
+	m_reply_timer.async_wait(m_strand.wrap(boost::bind(&lxr_hp_motor_control::on_reply_timer, this, boost::asio::placeholders::error)));
+}
+
+/**
+ * @brief reactor mode: requests more bytes from the serial port
+ */
+void lxr_hp_motor_control::start_read() {
+	m_pending_handlers++;
+	m_serial.asyncFillRxBuffer(m_strand.wrap(boost::bind(&lxr_hp_motor_control::on_read, this, boost::asio::placeholders::error)));
+}
+
+/**
+ * @brief reactor mode: bookkeeping at the start of every handler
+ * @return false if the instance is shutting down, the handler must then return without accessing any member
+ */
+bool lxr_hp_motor_control::complete_handler() {
+	bool const is_shutting_down = m_is_shutting_down;
+	// the destructor may return as soon as the semaphore has been posted
+	if(--m_pending_handlers == 0 && is_shutting_down) m_shutdown_event.post();
+	return !is_shutting_down;
+}
+
+/**
+ * @brief reactor mode: starts the negotiation after the start up delay, a keep alive frame or the next frame of E_STOP_AND_WAIT
+ */
+void lxr_hp_motor_control::on_timer(boost::system::error_code const &error) {
+	if(!complete_handler()) return;
+	// the handler of a wait which has been restarted might have been queued already
+	if(error || m_timer.expires_at() > boost::asio::deadline_timer::traits_type::now()) return;
+	m_is_timer_expired = true;
+	pump();
+}
+
+/**
+ * @brief reactor mode: handles the timeout of the oldest frame in flight
+ */
+void lxr_hp_motor_control::on_reply_timer(boost::system::error_code const &error) {
+	if(!complete_handler()) return;
+	// the wait might belong to a frame which has been answered in the meantime
+	if(error || m_frames_in_flight.load() == 0 || reply_deadline() > boost::asio::deadline_timer::traits_type::now()) return;
+
+	bool const is_negotiated = m_negotiation_step == E_NEGOTIATED;
+	if(handle_reply_timeout()) {
+		restart_negotiation();
+		start_timer(m_device_timeout_ms);
+	} else if(!is_negotiated) {
+		if(evaluate_negotiation_reply(TIMEOUT)) start_timer(m_device_timeout_ms);
+	} else if(m_com_mode == E_STOP_AND_WAIT) {
+		start_timer(m_com_thread_sleep_ms);
+	}
+	start_reply_timer();
+	pump();
+}
+
+/**
+ * @brief reactor mode: the next frame may be written
+ */
+void lxr_hp_motor_control::on_write(boost::system::error_code const &error) {
+	if(!complete_handler()) return;
+	m_is_write_pending = false;
+	// the serial port has failed, like with the threads no further frame is sent
+	if(error) return;
+	pump();
+}
+
+/**
+ * @brief reactor mode: evaluates the replies which have been received completely and requests more bytes
+ */
+void lxr_hp_motor_control::on_read(boost::system::error_code const &error) {
+	if(!complete_handler()) return;
+	// the serial port has failed, like with the threads no further reply is received - the frames in flight time out
+	if(error) return;
+
+	// the bytes received while the device returns to its defaults are dropped, like with the threads
+	if(m_negotiation_step != E_NEGOTIATED && !m_is_timer_expired) m_serial.discardRxBuffer();
+
+	for(;;) {
+		unsigned char reply[max_reply_size] = {0};
+		size_t lost_frames = 0;
+		size_t frame_err_code = NO_ERROR;
+		if(!receive_reply(reply, lost_frames, frame_err_code, boost::posix_time::ptime())) break;
+
+		if(m_negotiation_step != E_NEGOTIATED) {
+			complete_frames(lost_frames);
+			size_t const err_code = (frame_err_code != NO_ERROR) ? frame_err_code : lxr_hp_protocol::evaluate_reply(reply, m_id);
+			if(evaluate_negotiation_reply(err_code)) start_timer(m_device_timeout_ms);
+			continue;
+		}
+
+		// the same evaluation as in the receive thread
+		evaluate_reply(reply, frame_err_code | ((lost_frames > 0) ? SEQ_WRONG : NO_ERROR), true);
+		complete_frames(lost_frames);
+		if(m_com_mode == E_STOP_AND_WAIT) start_timer(m_com_thread_sleep_ms);
+	}
+
+	start_reply_timer();
+	pump();
+	start_read();
+}
+
+/**
+ * @brief reactor mode: handler posted by the setters
+ */
+void lxr_hp_motor_control::on_pump() {
+	m_is_pump_posted.store(false);
+	if(!complete_handler()) return;
+	pump();
+}
+
+/**
+ * @brief reactor mode: aborts the pending operations, posted by the destructor
+ */
+void lxr_hp_motor_control::on_shutdown() {
+	m_is_shutting_down = true;
+	boost::system::error_code error;
+	m_timer.cancel(error);
+	m_reply_timer.cancel(error);
+	m_serial.close();
+	complete_handler();
+}
+
+/**
+ * @brief returns true if points are waiting for an upload and the device has space for them - only called by the thread sending the frames while no frame is in flight
+ */
+bool lxr_hp_motor_control::is_trajectory_upload_due() {
+	if(!m_is_trajectory_active.load()) return false;
+	return m_is_upload_retransmit_pending || (m_trajectory_device_free > 0 && (m_trajectory_upload_count > 0 || m_trajectory_queue.read_available() > 0));
+}
 
-		enum {E_REP_ID = 0, E_REP_STATUS = 1, E_REP_CS = 2};
+/**
+ * @brief builds the next frame to be sent, a pending telemetry command goes before the trajectory upload or the setpoint - only called by the thread sending the frames
+ * @param is_trajectory_active snapshot of m_is_trajectory_active, the upload is only built if it is set and no other frame is in flight
+ * @return the size of the frame
+ */
+size_t lxr_hp_motor_control::build_next_message(unsigned char *msg_buf, bool const is_trajectory_active) {
+	if(m_telemetry_cmd_pending.exchange(false)) {
+		lxr_hp_protocol::build_telemetry_message(msg_buf, m_id, m_telemetry_period_ms.load());
+		record_frame(true);
+		return lxr_hp_protocol::msg_size;
+	}
+
+	unsigned int const generation = m_trajectory_generation.load();
+	if(is_trajectory_active && generation == m_trajectory_upload_generation) {
+		// the points which have not been accepted by the previous upload go first, points of an ended trajectory are dropped
+		s_queued_trajectory_point queued_point;
+		while(m_trajectory_upload_count < lxr_hp_protocol::trajectory_max_points && m_trajectory_queue.pop(queued_point)) {
+			if(queued_point.generation == generation) m_trajectory_upload[m_trajectory_upload_count++] = queued_point.point;
+		}
+		// without space on the device the upload only queries the free space and keeps the device from stopping
+		size_t const count = std::min(m_trajectory_upload_count, m_trajectory_device_free);
+		m_is_trajectory_frame_in_flight.store(true);
+		record_frame(false);
+		return lxr_hp_protocol::build_trajectory_message(msg_buf, m_id, m_trajectory_upload, count);
+	}
 
-		// evaluate the reply
-		size_t err_code = NO_ERROR;
-		if(reply.get()[E_REP_ID] != m_id) err_code |= ID_WRONG;
-		if(reply.get()[E_REP_STATUS] != STATUS_OK) err_code |= STATUS_ERROR;
-		if((reply.get()[E_REP_ID] ^ reply.get()[E_REP_STATUS]) != reply.get()[E_REP_CS]) err_code |= CS_WRONG;
+	if(generation != m_trajectory_upload_generation) {
+		// a setter has ended the trajectory, the setpoint frame clears the trajectory buffer of the device
+		m_trajectory_upload_generation = generation;
+		m_trajectory_upload_count = 0;
+		m_trajectory_device_free = lxr_hp_protocol::trajectory_buffer_size;
+	}
+	// the flag is cleared before the setpoint is read, a change in between is sent with the next frame
+	m_setpoint_changed.store(false);
+	unsigned short const setpoint = m_setpoint.load();
+	lxr_hp_protocol::build_message(msg_buf, m_id, static_cast<E_MOTOR_DIRECTION>(setpoint >> 8), static_cast<unsigned char>(setpoint & 0xFF));
+	record_frame(false);
+	return lxr_hp_protocol::msg_size;
+}
 
-		// in case of error call the registered error callback function
-		if(err_code != NO_ERROR) {
-			if(m_error_cb_func != 0) m_error_cb_func(err_code);
+/**
+ * @brief builds the next frame in the negotiated protocol version, a pending repetition of an upload goes first
+ * @param frame_buf buffer of lxr_hp_protocol::max_frame_size bytes
+ * @return the size of the frame
+ */
+size_t lxr_hp_motor_control::build_next_frame(unsigned char *frame_buf, bool const is_trajectory_active) {
+	m_is_retransmit_due.store(false);
+	if(m_is_upload_retransmit_pending) {
+		m_is_upload_retransmit_pending = false;
+		// the repetition is dropped if a setter has ended the trajectory in the meantime
+		if(is_trajectory_active && m_trajectory_generation.load() == m_trajectory_upload_generation) {
+			std::copy(m_upload_frame, m_upload_frame + m_upload_frame_size, frame_buf);
+			// no other frame is in flight, so the receive side does not use the sequence number until the repetition has been sent
+			m_rx_seq = m_upload_seq;
+			m_is_trajectory_frame_in_flight.store(true);
+			record_frame(false);
+			return m_upload_frame_size;
 		}
+		m_upload_retransmits = 0;
+	}
+
+	unsigned char msg_buf[max_msg_size] = {0};
+	size_t const msg_size = build_next_message(msg_buf, is_trajectory_active);
+	if(m_protocol_version == lxr_hp_protocol::protocol_version_1) {
+		std::copy(msg_buf, msg_buf + msg_size, frame_buf);
+		return msg_size;
+	}
+
+	unsigned char const seq = m_tx_seq++;
+	size_t const frame_size = lxr_hp_protocol::encode_frame(frame_buf, seq, msg_buf, msg_size);
+	if(m_is_trajectory_frame_in_flight.load()) {
+		std::copy(frame_buf, frame_buf + frame_size, m_upload_frame);
+		m_upload_frame_size = frame_size;
+		m_upload_seq = seq;
+	}
+	return frame_size;
+}
 
-		//for(size_t i=0; i<reply_size; i++) std::cout << std::hex << "reply[" << i << "] = 0x" << static_cast<size_t>(reply.get()[i]) << std::endl;
+/**
+ * @brief records the send time of the frame which is put in flight next - only called by the thread sending the frames
+ */
+void lxr_hp_motor_control::record_frame(bool const is_telemetry_cmd) {
+	s_frame_record &record = m_frame_records[m_tx_frame_record];
+	record.sent = boost::posix_time::microsec_clock::universal_time();
+	record.is_telemetry_cmd = is_telemetry_cmd;
+	m_tx_frame_record = (m_tx_frame_record + 1) % m_max_frames_in_flight;
+	m_statistics.frames++;
+}
+
+/**
+ * @brief returns the point in time when the reply to the oldest frame in flight is overdue
+ */
+boost::posix_time::ptime lxr_hp_motor_control::reply_deadline() const {
+	return m_frame_records[m_rx_frame_record].sent + boost::posix_time::milliseconds(m_reply_timeout_ms.load());
+}
+
+/**
+ * @brief drops the oldest frame in flight and lost_frames before it after their reply has been evaluated and records the round trip time
+ */
+void lxr_hp_motor_control::complete_frames(size_t const lost_frames) {
+	size_t const frames = std::min(lost_frames + 1, m_frames_in_flight.load());
+	if(frames == 0) return;
+	size_t const answered = (m_rx_frame_record + frames - 1) % m_max_frames_in_flight;
+	long const rtt_us = (boost::posix_time::microsec_clock::universal_time() - m_frame_records[answered].sent).total_microseconds();
+	unsigned long const rtt = (rtt_us > 0) ? static_cast<unsigned long>(rtt_us) : 0;
+	size_t bucket = 0;
+	while(bucket < rtt_histogram_buckets - 1 && (rtt >> (bucket + 1)) != 0) bucket++;
+	m_statistics.rtt_histogram[bucket]++;
+	if(rtt > m_statistics.max_rtt_us.load()) m_statistics.max_rtt_us.store(rtt);
+	m_statistics.replies++;
+	m_statistics.lost += frames - 1;
+	m_consecutive_timeouts = 0;
+
+	// the records are released before the counter, the thread sending the frames reuses them afterwards
+	m_rx_frame_record = (m_rx_frame_record + frames) % m_max_frames_in_flight;
+	m_frames_in_flight -= frames;
+}
+
+/**
+ * @brief drops the oldest frame in flight whose reply is overdue and schedules its retransmit, TIMEOUT is reported once the retransmits are exhausted
+ * @return true if the retransmits are exhausted at protocol version 2, the device has then returned to its defaults and the protocol has to be negotiated again
+ */
+bool lxr_hp_motor_control::handle_reply_timeout() {
+	bool const is_telemetry_cmd = m_frame_records[m_rx_frame_record].is_telemetry_cmd;
+	m_statistics.timeouts++;
+	// the frame has not been answered, the next reply carries the sequence number of the following frame
+	if(m_protocol_version == lxr_hp_protocol::protocol_version_2) m_rx_seq++;
+
+	// a setpoint frame is repeated with the current setpoint, the frames are sent with their regular period once the retransmits are exhausted
+	bool const is_retransmitted = m_consecutive_timeouts < m_max_timeout_retransmits;
+	if(is_retransmitted) {
+		m_consecutive_timeouts++;
+		m_statistics.retransmits++;
+		if(is_telemetry_cmd) m_telemetry_cmd_pending.store(true);
+		m_is_retransmit_due.store(true);
+	}
+
+	bool const is_negotiated = m_negotiation_step == E_NEGOTIATED;
+	if(is_negotiated) {
+		// an upload is evaluated like one with a corrupted reply
+		unsigned char const reply[max_reply_size] = {0};
+		evaluate_reply(reply, TIMEOUT, !is_retransmitted);
+	} else if(!is_retransmitted) {
+		error_callback const cb = m_error_cb_func.load();
+		if(cb != 0) cb(TIMEOUT);
+	}
+
+	m_rx_frame_record = (m_rx_frame_record + 1) % m_max_frames_in_flight;
+	m_frames_in_flight--;
+	return !is_retransmitted && is_negotiated && m_protocol_version == lxr_hp_protocol::protocol_version_2;
+}
+
+/**
+ * @brief returns true if a complete frame has been received, reading it does then not block
+ */
+bool lxr_hp_motor_control::is_frame_available() {
+	if(m_protocol_version == lxr_hp_protocol::protocol_version_2) return m_serial.isFrameAvailable(lxr_hp_protocol::frame_delimiter);
+
+	unsigned int const available = m_serial.bytesAvailable();
+	if(available < lxr_hp_protocol::reply_header_size) return false;
+	unsigned char header[lxr_hp_protocol::reply_header_size] = {0};
+	m_serial.peekFromSerial(header, sizeof(header));
+	return available >= lxr_hp_protocol::reply_frame_size(header);
+}
+
+/**
+ * @brief receives the reply to the oldest frame in flight, telemetry frames received in the meantime are put into the telemetry queue
+ * with protocol version 2 replies to frames which are no longer in flight are dropped
+ * @param reply buffer of lxr_hp_protocol::max_reply_size bytes
+ * @param lost_frames number of frames in flight before the one the reply belongs to, they have not been answered
+ * @param frame_err_code NO_ERROR or CS_WRONG if a corrupted frame has been received in place of the reply
+ * @param deadline the threads wait for the reply until then, the reactor returns as soon as no complete frame is left
+ * @return false if the reply has not been received completely until the deadline or, in reactor mode, yet
+ */
+bool lxr_hp_motor_control::receive_reply(unsigned char *reply, size_t &lost_frames, size_t &frame_err_code, boost::posix_time::ptime const &deadline) {
+	lost_frames = 0;
+	frame_err_code = NO_ERROR;
+	for(;;) {
+		// the reactor receives the bytes of the frames it has not received completely yet with its next read, the threads wait for them until the deadline
+		if(!is_frame_available()) {
+			if(m_is_reactor || !m_serial.fillRxBuffer(deadline)) return false;
+			continue;
+		}
+
+		unsigned char frame[max_frame_size] = {0};
+		unsigned char const *msg = frame;
+		size_t frame_size = 0;
+		unsigned char seq = 0;
+		if(m_protocol_version == lxr_hp_protocol::protocol_version_1) {
+			m_serial.readFromSerial(frame, lxr_hp_protocol::reply_header_size);
+			frame_size = lxr_hp_protocol::reply_frame_size(frame);
+			m_serial.readFromSerial(frame + lxr_hp_protocol::reply_header_size, frame_size - lxr_hp_protocol::reply_header_size);
+		} else {
+			// a corrupted frame ends at the next delimiter at the latest, the following frame is received correctly again
+			size_t const encoded_size = m_serial.readFrameFromSerial(frame, max_frame_size, lxr_hp_protocol::frame_delimiter);
+			if(encoded_size == 0) continue;
+			if(encoded_size <= max_frame_size) frame_size = lxr_hp_protocol::decode_frame(frame, encoded_size, seq);
+			msg = frame + 1;
+			if(frame_size == 0 || frame_size != lxr_hp_protocol::reply_frame_size(msg)) {
+				// it is taken as the reply to the oldest frame in flight, which is then answered by nothing else
+				if(m_frames_in_flight.load() == 0) {
+					error_callback const cb = m_error_cb_func.load();
+					if(cb != 0) cb(CS_WRONG);
+					continue;
+				}
+				m_rx_seq++;
+				frame_err_code = CS_WRONG;
+				return true;
+			}
+		}
+
+		if(!lxr_hp_protocol::is_telemetry(msg)) {
+			// a late reply to a frame which has timed out is dropped
+			if(m_frames_in_flight.load() == 0) continue;
+			if(m_protocol_version == lxr_hp_protocol::protocol_version_2) {
+				// the device does not know the sequence number of a corrupted frame, its error reply belongs to the oldest frame in flight
+				size_t const distance = lxr_hp_protocol::is_error_reply(msg) ? 0 : static_cast<unsigned char>(seq - m_rx_seq);
+				if(distance >= m_frames_in_flight.load()) continue;
+				lost_frames = distance;
+				m_rx_seq = static_cast<unsigned char>(m_rx_seq + distance + 1);
+			}
+			std::copy(msg, msg + frame_size, reply);
+			return true;
+		}
+
+		s_telemetry_sample sample;
+		size_t const err_code = lxr_hp_protocol::decode_telemetry(msg, m_id, sample);
+		error_callback const cb = m_error_cb_func.load();
+		if(err_code == NO_ERROR) {
+			m_telemetry_queue.push(sample);
+		} else if(cb != 0) {
+			cb(err_code);
+		}
+	}
+}
+
+/**
+ * @brief evaluates a reply frame, drops the points accepted by an upload and calls the error callback in case of an error
+ * @param frame_err_code error detected while receiving the reply
+ * @param is_reported false if the error callback is not to be called, e.g. for a timeout whose frame is sent again
+ */
+void lxr_hp_motor_control::evaluate_reply(unsigned char const *reply, size_t const frame_err_code, bool const is_reported) {
+	size_t err_code = frame_err_code;
+	if(m_is_trajectory_frame_in_flight.load()) {
+		size_t accepted = 0;
+		size_t free_points = 0;
+		// without a valid reply the upload is retransmitted or the points are sent again
+		size_t reply_err_code = frame_err_code & (CS_WRONG | TIMEOUT);
+		if(reply_err_code == NO_ERROR) {
+			reply_err_code = lxr_hp_protocol::is_trajectory_reply(reply) ? lxr_hp_protocol::decode_trajectory_reply(reply, m_id, accepted, free_points) : (lxr_hp_protocol::evaluate_reply(reply, m_id) | STATUS_WRONG);
+		}
+		err_code |= reply_err_code;
+		if(reply_err_code != NO_ERROR && m_protocol_version == lxr_hp_protocol::protocol_version_2 && m_upload_retransmits < m_max_upload_retransmits) {
+			// the device might have applied the upload, the repetition carries the same sequence number and is answered with the same reply
+			m_upload_retransmits++;
+			m_is_upload_retransmit_pending = true;
+		} else {
+			// otherwise the points are sent again once the next upload has queried the free space
+			if(reply_err_code != NO_ERROR) accepted = free_points = 0;
+			accepted = std::min(accepted, m_trajectory_upload_count);
+			std::copy(m_trajectory_upload + accepted, m_trajectory_upload + m_trajectory_upload_count, m_trajectory_upload);
+			m_trajectory_upload_count -= accepted;
+			m_trajectory_device_free = free_points;
+			m_upload_retransmits = 0;
+		}
+		m_is_trajectory_frame_in_flight.store(false);
+	} else if(!(frame_err_code & (CS_WRONG | TIMEOUT))) {
+		err_code |= lxr_hp_protocol::evaluate_reply(reply, m_id);
+	}
 
-		boost::this_thread::sleep(boost::posix_time::milliseconds(m_com_thread_sleep_ms));
+	// in case of error call the registered error callback function
+	if(err_code != NO_ERROR && is_reported) {
+		error_callback const cb = m_error_cb_func.load();
+		if(cb != 0) cb(err_code);
 	}
 }
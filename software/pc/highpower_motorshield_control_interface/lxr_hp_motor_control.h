@@ -16,18 +16,35 @@
 
 #include <string>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
 
 #include "serial.h"
+#include "lxr_hp_protocol.h"
+#include "lxr_hp_reactor.h"
 
-// function pointer for registering an error callback function
-static size_t const NO_ERROR = 0;
-static size_t const ID_WRONG = 1;
-static size_t const STATUS_WRONG = 2;
-static size_t const CS_WRONG = 4;
-typedef void(*error_callback)(size_t const err_code);
+// typedef for the communication mode
+// E_STOP_AND_WAIT: one frame is sent every m_com_thread_sleep_ms, the next frame is sent after the reply has been received
+// E_PIPELINED: a frame is sent as soon as a setpoint changes, up to m_max_frames_in_flight frames may wait for their reply
+// while a trajectory is active both modes upload its points as long as the device has space and only one frame is in flight at a time, also while the upload of an ended trajectory waits for its reply
+// both modes first negotiate protocol version 2 and the baud rate, a device which does not support it is driven with protocol version 1 at 115200 baud
+// both modes run either on two threads of their own per instance or on the shared threads of a lxr_hp_reactor
+// a frame whose reply does not arrive within the reply timeout is sent again, up to m_max_timeout_retransmits times in a row, TIMEOUT is reported once the retransmits are exhausted
+typedef enum {E_STOP_AND_WAIT = 0, E_PIPELINED = 1} E_COM_MODE;
 
-// typedef for motor direction
-typedef enum {E_BWD = 0, E_FWD = 1} E_MOTOR_DIRECTION;
+// statistics of the serial communication, e.g. for sizing the reply timeout against the measured round trip times
+// bucket n of the histogram counts the replies which arrived [2^n, 2^(n+1)) us after their frame had been sent
+static size_t const rtt_histogram_buckets = 24;
+typedef struct {
+	unsigned long frames; // frames sent, including the negotiation and the retransmits
+	unsigned long replies; // replies received, including the corrupted ones
+	unsigned long lost; // protocol version 2: frames without reply whose following frame has been answered
+	unsigned long timeouts; // frames without reply within the reply timeout
+	unsigned long retransmits; // frames sent again after a timeout
+	unsigned long max_rtt_us;
+	unsigned long rtt_histogram[rtt_histogram_buckets];
+} s_com_statistics;
 
 class lxr_hp_motor_control {
 public:
@@ -35,8 +52,17 @@ public:
 	 * @brief Constructor
 	 * @param devNode string of the device node where the arduino is connected with the pc
 	 * @param id the id which is programmed in the connected arduino, value of the define SERIAL_MOTOR_DRIVER_ID in serial_motor_driver.ino
+	 * @param com_mode selects how frames are scheduled on the serial line
+	 * @param baud_rate the baud rate which is negotiated with protocol version 2
 	 */
-	lxr_hp_motor_control(std::string const &devNode, unsigned char const id);
+	lxr_hp_motor_control(std::string const &devNode, unsigned char const id, E_COM_MODE const com_mode = E_STOP_AND_WAIT, E_BAUD_RATE const baud_rate = E_BAUD_1000000);
+
+	/**
+	 * @brief Constructor for an instance whose frames are sent and received by the threads of a shared reactor without blocking
+	 * the error callback is then called from the threads of the reactor, the instance must not be destroyed from within the callback
+	 * @param reactor has to outlive the instance
+	 */
+	lxr_hp_motor_control(lxr_hp_reactor &reactor, std::string const &devNode, unsigned char const id, E_COM_MODE const com_mode = E_STOP_AND_WAIT, E_BAUD_RATE const baud_rate = E_BAUD_1000000);
 
 	/**
 	 * @brief Destructor
@@ -44,48 +70,371 @@ public:
 	~lxr_hp_motor_control();
 
 	/**
-	 * @brief sets the speed of the motor
+	 * @brief sets the speed of the motor - lock free, never blocks behind the communication threads
+	 * the setters end a running trajectory, its points which have not been executed yet are discarded
 	 */
 	void set_speed(unsigned char const speed);
 
 	/**
-	 * @brief sets the direction of the motor
+	 * @brief sets the direction of the motor - lock free, never blocks behind the communication threads
 	 */
 	void set_direction(E_MOTOR_DIRECTION const dir);
 
 	/**
-	 * @brief register a function which is to be called in case of an error
+	 * @brief sets speed and direction together, so that they are never sent mismatched - wait free
+	 * @param velocity -255 (full speed backward) to 255 (full speed forward), values beyond are limited
+	 */
+	void set_velocity(int const velocity);
+
+	/**
+	 * @brief register a function which is to be called in case of an error - wait free
 	 */
 	void register_error_callback(error_callback cb);
 
+	/**
+	 * @brief configures the current telemetry stream of the device - wait free
+	 * @param period_ms period of the telemetry samples (minimum 5 ms), 0 turns the stream off
+	 */
+	void enable_telemetry(unsigned char const period_ms);
+
+	/**
+	 * @brief queues points of a trajectory which the device executes on its own timer, the points are uploaded while the trajectory buffer of the device has space
+	 * lock free, but must only be called by one producer thread at a time and not concurrently with the setters
+	 * @return the number of queued points, less than count if the queue is full
+	 */
+	size_t push_trajectory(s_trajectory_point const *points, size_t const count);
+
+	/**
+	 * @brief fetches the oldest received telemetry sample - lock free, but must only be called by one consumer thread at a time
+	 * @return false if no sample is available
+	 */
+	bool pop_telemetry(s_telemetry_sample &sample);
+
+	/**
+	 * @brief sets the time a frame may wait for its reply before it is sent again, TIMEOUT is reported once the retransmits are exhausted - wait free
+	 */
+	void set_reply_timeout(size_t const timeout_ms);
+
+	/**
+	 * @brief copies the statistics of the serial communication - wait free, the counters are copied one after another
+	 */
+	void get_statistics(s_com_statistics &statistics) const;
+
 	/**
 	 * @brief converts the error code into a string
 	 */
 	static std::string convert_to_string(size_t const err_code);
 
+	/**
+	 * @brief returns the upper bound of the histogram bucket which contains the given fraction of the round trip times
+	 */
+	static unsigned long rtt_percentile_us(s_com_statistics const &statistics, double const fraction);
+
 protected:
 	static size_t const m_baudrate = 115200;
 	static size_t const m_com_thread_sleep_ms = 100;
+	static size_t const m_max_frames_in_flight = 4;
+	static size_t const m_telemetry_queue_size = 256;
+	static size_t const m_trajectory_queue_size = 1024;
+	static size_t const m_max_upload_retransmits = 3;
+	// a reply takes about 1 ms at 115200 baud, the reply timeout can be adjusted with set_reply_timeout
+	static size_t const m_default_reply_timeout_ms = 50;
+	// protocol version 2: once a frame has timed out after this number of retransmits, the device is expected to have returned to its defaults
+	static size_t const m_max_timeout_retransmits = 3;
+	// longer than SERIAL_TIMEOUT_MS of serial_motor_driver.ino, after which it returns to protocol version 1 at 115200 baud
+	static size_t const m_device_timeout_ms = 300;
+	// delay before the negotiation to allow the serial device to be fully initialized
+	static size_t const m_start_up_delay_ms = 2000;
 
 private:
+	// steps of the protocol negotiation, the handshake is sent at protocol version 1 and the baud rate command at protocol version 2
+	typedef enum {E_NEGOTIATE_VERSION = 0, E_NEGOTIATE_BAUD_RATE = 1, E_NEGOTIATED = 2} E_NEGOTIATION_STEP;
+
 	serial m_serial;
 
 	unsigned char m_id;
-	unsigned char m_speed;
-	E_MOTOR_DIRECTION m_direction;
+	// the baud rate to be negotiated, it falls back to E_BAUD_115200 if the switch fails
+	E_BAUD_RATE m_baud_rate;
+	E_NEGOTIATION_STEP m_negotiation_step;
+	// a rejected handshake is repeated once after the device timeout, the first error reply might answer bytes the device has received before the handshake
+	bool m_is_handshake_rejected;
+	// negotiated by the thread sending the frames before the thread receiving the replies is started
+	unsigned char m_protocol_version;
+	// protocol version 2: sequence number of the next frame to be sent and of the oldest frame in flight, each only used by one thread
+	unsigned char m_tx_seq;
+	unsigned char m_rx_seq;
+	// speed in the low byte and direction in the high byte, so that both are published with one atomic store
+	boost::atomic<unsigned short> m_setpoint;
 
 	bool m_error_flag;
 
-	boost::mutex m_mutex;
+	E_COM_MODE m_com_mode;
+	boost::atomic<bool> m_setpoint_changed;
+	boost::atomic<size_t> m_frames_in_flight;
+
+	// the frames in flight in the order they have been sent, written by the thread sending the frames before it increments m_frames_in_flight
+	typedef struct {
+		boost::posix_time::ptime sent;
+		bool is_telemetry_cmd;
+	} s_frame_record;
+	s_frame_record m_frame_records[m_max_frames_in_flight];
+	size_t m_tx_frame_record;
+	// the record of the oldest frame in flight, only used by the thread receiving the replies
+	size_t m_rx_frame_record;
+	boost::atomic<size_t> m_reply_timeout_ms;
+	size_t m_consecutive_timeouts;
+	// set by the thread receiving the replies after a timeout, the next frame is sent without waiting for its period
+	boost::atomic<bool> m_is_retransmit_due;
+
+	// written by the threads or handlers which send and receive the frames, read by get_statistics
+	struct s_atomic_statistics {
+		boost::atomic<unsigned long> frames;
+		boost::atomic<unsigned long> replies;
+		boost::atomic<unsigned long> lost;
+		boost::atomic<unsigned long> timeouts;
+		boost::atomic<unsigned long> retransmits;
+		boost::atomic<unsigned long> max_rtt_us;
+		boost::atomic<unsigned long> rtt_histogram[rtt_histogram_buckets];
+		s_atomic_statistics();
+	} m_statistics;
+
+	boost::atomic<unsigned char> m_telemetry_period_ms;
+	boost::atomic<bool> m_telemetry_cmd_pending;
+	// written by the thread receiving the replies, read by the user - samples are dropped if the queue is full
+	boost::lockfree::spsc_queue<s_telemetry_sample, boost::lockfree::capacity<m_telemetry_queue_size> > m_telemetry_queue;
+
+	// a point is only uploaded if its generation is the current one, the setters start a new generation when they end a trajectory
+	typedef struct {
+		s_trajectory_point point;
+		unsigned int generation;
+	} s_queued_trajectory_point;
+	boost::lockfree::spsc_queue<s_queued_trajectory_point, boost::lockfree::capacity<m_trajectory_queue_size> > m_trajectory_queue;
+	boost::atomic<bool> m_is_trajectory_active;
+	boost::atomic<unsigned int> m_trajectory_generation;
+	// set while an upload waits for its reply, the upload state is then owned by the thread receiving the replies
+	boost::atomic<bool> m_is_trajectory_frame_in_flight;
+	s_trajectory_point m_trajectory_upload[lxr_hp_protocol::trajectory_max_points];
+	size_t m_trajectory_upload_count;
+	unsigned int m_trajectory_upload_generation;
+	size_t m_trajectory_device_free;
+	// protocol version 2: an upload without a valid reply is repeated unchanged, the device answers a repetition of an applied upload with its previous reply
+	unsigned char m_upload_frame[lxr_hp_protocol::max_frame_size];
+	size_t m_upload_frame_size;
+	// the reply to a repetition carries this sequence number, it is only expected again once the repetition is actually sent
+	unsigned char m_upload_seq;
+	size_t m_upload_retransmits;
+	bool m_is_upload_retransmit_pending;
+
+	// wakes up the transmit thread in pipelined mode, posting it never blocks
+	boost::interprocess::interprocess_semaphore m_com_event;
+	// pipelined mode: set by the receive thread once the device has stopped answering, it waits on m_rx_event until the transmit thread has negotiated the protocol again
+	boost::atomic<bool> m_is_renegotiation_due;
+	boost::interprocess::interprocess_semaphore m_rx_event;
 
 	boost::thread m_com_thread;
+	boost::thread m_rx_thread;
 
-	error_callback m_error_cb_func;
+	// reactor mode: the handlers of the instance run in its strand, all members below are only accessed from there
+	bool m_is_reactor;
+	boost::asio::io_service::strand m_strand;
+	// delays the negotiation, paces the frames of E_STOP_AND_WAIT and triggers the keep alive frames of E_PIPELINED
+	boost::asio::deadline_timer m_timer;
+	bool m_is_timer_expired;
+	// expires when the reply to the oldest frame in flight is overdue
+	boost::asio::deadline_timer m_reply_timer;
+	bool m_is_write_pending;
+	unsigned char m_tx_frame[lxr_hp_protocol::max_frame_size];
+	bool m_is_shutting_down;
+	// set while a pump handler posted by the setters waits to be run, further changes are covered by it
+	boost::atomic<bool> m_is_pump_posted;
+	// handlers which have been queued or operations which have been started and not yet completed, the destructor waits until none is left
+	boost::atomic<size_t> m_pending_handlers;
+	boost::interprocess::interprocess_semaphore m_shutdown_event;
+
+	boost::atomic<error_callback> m_error_cb_func;
 
 	/**
 	 * @brief this is the function executed by the communication thread
 	 */
 	void com_thread_func();
+
+	/**
+	 * @brief this is the function executed by the transmit thread in pipelined mode
+	 */
+	void tx_thread_func();
+
+	/**
+	 * @brief this is the function executed by the receive thread in pipelined mode
+	 */
+	void rx_thread_func();
+
+	/**
+	 * @brief switches the device to protocol version 2 and the baud rate - a device without support for it is kept at protocol version 1
+	 */
+	void negotiate_protocol();
+
+	/**
+	 * @brief builds the frame of the current negotiation step
+	 * @return the size of the frame
+	 */
+	size_t build_negotiation_frame(unsigned char *frame_buf);
+
+	/**
+	 * @brief advances the negotiation according to the result of the current step
+	 * @return true if the device has to return to its defaults before the negotiation is started again
+	 */
+	bool evaluate_negotiation_reply(size_t const err_code);
+
+	/**
+	 * @brief threads only: stays silent until the device has returned to its defaults, the bytes received in the meantime are dropped
+	 */
+	void wait_for_device_timeout();
+
+	/**
+	 * @brief returns to protocol version 1 at 115200 baud like the device does without a valid frame, the frames in flight are dropped
+	 * the caller has to wait m_device_timeout_ms before the negotiation is started
+	 */
+	void restart_negotiation();
+
+	/**
+	 * @brief sends a frame and receives its reply, only used while the thread receiving the replies is not running
+	 * @return NO_ERROR, TIMEOUT or the error code of the reply
+	 */
+	size_t exchange(unsigned char const *frame_buf, size_t const frame_size);
+
+	/**
+	 * @brief marks the setpoint as changed if it differs from the previous one or ends a trajectory and wakes up the transmit thread
+	 */
+	void notify_setpoint(unsigned short const previous, unsigned short const setpoint);
+
+	/**
+	 * @brief wakes up the transmit thread in pipelined mode
+	 */
+	void notify_com_thread();
+
+	/**
+	 * @brief reactor mode: sends the next frame if one is due and the previous write has completed
+	 */
+	void pump();
+
+	/**
+	 * @brief reactor mode: queues a pump handler in the strand, can be called from any thread
+	 */
+	void post_pump();
+
+	/**
+	 * @brief reactor mode: (re)starts the timer, m_is_timer_expired is set when it expires
+	 */
+	void start_timer(size_t const timeout_ms);
+
+	/**
+	 * @brief reactor mode: (re)starts the reply timer for the oldest frame in flight
+	 */
+	void start_reply_timer();
+
+	/**
+	 * @brief reactor mode: requests more bytes from the serial port
+	 */
+	void start_read();
+
+	/**
+	 * @brief reactor mode: bookkeeping at the start of every handler
+	 * @return false if the instance is shutting down, the handler must then return without accessing any member
+	 */
+	bool complete_handler();
+
+	/**
+	 * @brief reactor mode: starts the negotiation after the start up delay, a keep alive frame or the next frame of E_STOP_AND_WAIT
+	 */
+	void on_timer(boost::system::error_code const &error);
+
+	/**
+	 * @brief reactor mode: handles the timeout of the oldest frame in flight
+	 */
+	void on_reply_timer(boost::system::error_code const &error);
+
+	/**
+	 * @brief reactor mode: the next frame may be written
+	 */
+	void on_write(boost::system::error_code const &error);
+
+	/**
+	 * @brief reactor mode: evaluates the replies which have been received completely and requests more bytes
+	 */
+	void on_read(boost::system::error_code const &error);
+
+	/**
+	 * @brief reactor mode: handler posted by the setters
+	 */
+	void on_pump();
+
+	/**
+	 * @brief reactor mode: aborts the pending operations, posted by the destructor
+	 */
+	void on_shutdown();
+
+	/**
+	 * @brief returns true if points are waiting for an upload and the device has space for them - only called by the thread sending the frames while no frame is in flight
+	 */
+	bool is_trajectory_upload_due();
+
+	/**
+	 * @brief builds the next frame to be sent, a pending telemetry command goes before the trajectory upload or the setpoint - only called by the thread sending the frames
+	 * @param is_trajectory_active snapshot of m_is_trajectory_active, the upload is only built if it is set and no other frame is in flight
+	 * @return the size of the frame
+	 */
+	size_t build_next_message(unsigned char *msg_buf, bool const is_trajectory_active);
+
+	/**
+	 * @brief builds the next frame in the negotiated protocol version, a pending repetition of an upload goes first
+	 * @param frame_buf buffer of lxr_hp_protocol::max_frame_size bytes
+	 * @return the size of the frame
+	 */
+	size_t build_next_frame(unsigned char *frame_buf, bool const is_trajectory_active);
+
+	/**
+	 * @brief records the send time of the frame which is put in flight next - only called by the thread sending the frames
+	 */
+	void record_frame(bool const is_telemetry_cmd);
+
+	/**
+	 * @brief returns the point in time when the reply to the oldest frame in flight is overdue
+	 */
+	boost::posix_time::ptime reply_deadline() const;
+
+	/**
+	 * @brief drops the oldest frame in flight and lost_frames before it after their reply has been evaluated and records the round trip time
+	 */
+	void complete_frames(size_t const lost_frames);
+
+	/**
+	 * @brief drops the oldest frame in flight whose reply is overdue and schedules its retransmit, TIMEOUT is reported once the retransmits are exhausted
+	 * @return true if the retransmits are exhausted at protocol version 2, the device has then returned to its defaults and the protocol has to be negotiated again
+	 */
+	bool handle_reply_timeout();
+
+	/**
+	 * @brief returns true if a complete frame has been received, reading it does then not block
+	 */
+	bool is_frame_available();
+
+	/**
+	 * @brief receives the reply to the oldest frame in flight, telemetry frames received in the meantime are put into the telemetry queue
+	 * with protocol version 2 replies to frames which are no longer in flight are dropped
+	 * @param reply buffer of lxr_hp_protocol::max_reply_size bytes
+	 * @param lost_frames number of frames in flight before the one the reply belongs to, they have not been answered
+	 * @param frame_err_code NO_ERROR or CS_WRONG if a corrupted frame has been received in place of the reply
+	 * @param deadline the threads wait for the reply until then, the reactor returns as soon as no complete frame is left
+	 * @return false if the reply has not been received completely until the deadline or, in reactor mode, yet
+	 */
+	bool receive_reply(unsigned char *reply, size_t &lost_frames, size_t &frame_err_code, boost::posix_time::ptime const &deadline);
+
+	/**
+	 * @brief evaluates a reply frame, drops the points accepted by an upload and calls the error callback in case of an error
+	 * @param frame_err_code error detected while receiving the reply
+	 * @param is_reported false if the error callback is not to be called, e.g. for a timeout whose frame is sent again
+	 */
+	void evaluate_reply(unsigned char const *reply, size_t const frame_err_code, bool const is_reported);
 };
 
 #endif /* LXR_HP_MOTOR_CONTROL_H_ */
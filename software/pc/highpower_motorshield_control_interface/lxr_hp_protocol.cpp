@@ -0,0 +1,327 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief this module implements the frame format of the serial_motor_driver.ino protocol
+ * @file lxr_hp_protocol.cpp
+ * @license MPL 2.0
+ */
+
+#include "lxr_hp_protocol.h"
+#include <algorithm>
+
+/* PROTOCOL DESIGN */
+/* PC -> ARDUINO
+   1 Byte ID
+   1 Byte DIRECTION
+   1 Byte SPEED
+   1 BYTE CHECKSUM = ID xor DIRETCTION xor SPEED
+ */
+/* PC -> ARDUINO (trajectory upload)
+   1 Byte ID
+   1 Byte MOTOR_CMD_TRAJECTORY
+   1 Byte NUMBER OF POINTS
+   1 Byte CHECKSUM = ID xor MOTOR_CMD_TRAJECTORY xor NUMBER OF POINTS
+   per point: 2 Byte TIME OFFSET in ms (little endian), 1 Byte DIRECTION, 1 Byte SPEED
+   1 Byte CHECKSUM = xor of all point bytes
+ */
+/* ARDUINO -> PC
+   1 Byte ID
+   1 Byte STATUS
+   1 Byte CHECKSUM = ID xor STATUS
+ */
+/* ARDUINO -> PC (reply to a trajectory upload)
+   1 Byte ID
+   1 Byte STATUS_TRAJECTORY
+   1 Byte NUMBER OF ACCEPTED POINTS
+   1 Byte NUMBER OF FREE POINTS
+   1 Byte CHECKSUM = xor of all previous bytes
+ */
+/* ARDUINO -> PC (telemetry)
+   1 Byte ID
+   1 Byte STATUS_TELEMETRY
+   2 Byte TIMESTAMP in ms (little endian)
+   2 Byte CURRENT HALF BRIDGE 1 (little endian)
+   2 Byte CURRENT HALF BRIDGE 2 (little endian)
+   1 Byte SPEED
+   1 Byte DIRECTION
+   1 Byte CHECKSUM = xor of all previous bytes
+ */
+/* PC -> ARDUINO (protocol handshake / baud rate)
+   1 Byte ID
+   1 Byte MOTOR_CMD_PROTOCOL / MOTOR_CMD_BAUD_RATE
+   1 Byte PROTOCOL VERSION / BAUD RATE INDEX
+   1 Byte CHECKSUM = xor of all previous bytes
+ */
+/* PROTOCOL VERSION 2
+   COBS encoding of (1 Byte SEQUENCE NUMBER, one of the messages above, 1 Byte CRC-8 of the previous bytes)
+   1 Byte 0x00 DELIMITER
+ */
+
+#define MOTOR_CMD_TELEMETRY         (2)
+#define MOTOR_CMD_TRAJECTORY        (3)
+#define MOTOR_CMD_PROTOCOL          (4)
+#define MOTOR_CMD_BAUD_RATE         (5)
+#define STATUS_ERROR                (0)
+#define STATUS_OK                   (1)
+#define STATUS_TELEMETRY            (2)
+#define STATUS_TRAJECTORY           (3)
+// CRC-8 polynomial x^8 + x^2 + x + 1
+#define CRC8_POLYNOMIAL             (0x07)
+
+enum {E_MSG_ID = 0, E_MSG_DIR = 1, E_MSG_SPEED = 2, E_MSG_CS = 3};
+enum {E_REP_ID = 0, E_REP_STATUS = 1, E_REP_CS = 2};
+enum {E_TRJ_ID = 0, E_TRJ_STATUS = 1, E_TRJ_ACCEPTED = 2, E_TRJ_FREE = 3, E_TRJ_CS = 4};
+enum {E_TEL_ID = 0, E_TEL_STATUS = 1, E_TEL_TIMESTAMP = 2, E_TEL_CURRENT_1 = 4, E_TEL_CURRENT_2 = 6, E_TEL_SPEED = 8, E_TEL_DIR = 9, E_TEL_CS = 10};
+
+size_t const lxr_hp_protocol::msg_size;
+size_t const lxr_hp_protocol::reply_size;
+size_t const lxr_hp_protocol::reply_header_size;
+size_t const lxr_hp_protocol::telemetry_size;
+size_t const lxr_hp_protocol::trajectory_reply_size;
+size_t const lxr_hp_protocol::max_reply_size;
+size_t const lxr_hp_protocol::trajectory_point_size;
+size_t const lxr_hp_protocol::trajectory_max_points;
+size_t const lxr_hp_protocol::trajectory_buffer_size;
+size_t const lxr_hp_protocol::max_msg_size;
+unsigned char const lxr_hp_protocol::protocol_version_1;
+unsigned char const lxr_hp_protocol::protocol_version_2;
+unsigned char const lxr_hp_protocol::frame_delimiter;
+size_t const lxr_hp_protocol::frame_overhead;
+size_t const lxr_hp_protocol::max_frame_size;
+
+static unsigned int const baud_rates[] = {115200, 500000, 1000000};
+
+/**
+ * @brief reads a little endian 16 bit value
+ */
+static unsigned short read_u16(unsigned char const *buf) {
+	return static_cast<unsigned short>(buf[0] | (buf[1] << 8));
+}
+
+/**
+ * @brief CRC-8 with the polynomial CRC8_POLYNOMIAL and an initial value of 0
+ */
+static unsigned char crc8(unsigned char const *buf, size_t const size) {
+	unsigned char crc = 0;
+	for(size_t i = 0; i < size; i++) {
+		crc ^= buf[i];
+		for(size_t bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? static_cast<unsigned char>((crc << 1) ^ CRC8_POLYNOMIAL) : static_cast<unsigned char>(crc << 1);
+	}
+	return crc;
+}
+
+/**
+ * @brief builds a message consisting of id, command, argument and checksum
+ */
+static void build_command(unsigned char *msg_buf, unsigned char const id, unsigned char const cmd, unsigned char const arg) {
+	msg_buf[E_MSG_ID] = id;
+	msg_buf[E_MSG_DIR] = cmd;
+	msg_buf[E_MSG_SPEED] = arg;
+	msg_buf[E_MSG_CS] = msg_buf[E_MSG_ID] ^ msg_buf[E_MSG_DIR] ^ msg_buf[E_MSG_SPEED];
+}
+
+/**
+ * @brief builds a command frame
+ * @param msg_buf buffer of at least msg_size bytes
+ */
+void lxr_hp_protocol::build_message(unsigned char *msg_buf, unsigned char const id, E_MOTOR_DIRECTION const dir, unsigned char const speed) {
+	build_command(msg_buf, id, static_cast<unsigned char>(dir), speed);
+}
+
+/**
+ * @brief builds a frame which configures the telemetry stream of the device
+ * @param period_ms period of the telemetry samples, 0 turns the stream off
+ */
+void lxr_hp_protocol::build_telemetry_message(unsigned char *msg_buf, unsigned char const id, unsigned char const period_ms) {
+	build_command(msg_buf, id, MOTOR_CMD_TELEMETRY, period_ms);
+}
+
+/**
+ * @brief builds a frame which appends points to the trajectory buffer of the device, 0 points only query its free space
+ * @param msg_buf buffer of at least max_msg_size bytes
+ * @param count number of points, at most trajectory_max_points
+ * @return the size of the frame
+ */
+size_t lxr_hp_protocol::build_trajectory_message(unsigned char *msg_buf, unsigned char const id, s_trajectory_point const *points, size_t const count) {
+	build_command(msg_buf, id, MOTOR_CMD_TRAJECTORY, static_cast<unsigned char>(count));
+	if(count == 0) return msg_size;
+
+	unsigned char *point_buf = msg_buf + msg_size;
+	unsigned char cs = 0;
+	for(size_t i = 0; i < count; i++, point_buf += trajectory_point_size) {
+		point_buf[0] = static_cast<unsigned char>(points[i].time_offset_ms);
+		point_buf[1] = static_cast<unsigned char>(points[i].time_offset_ms >> 8);
+		point_buf[2] = static_cast<unsigned char>(points[i].direction);
+		point_buf[3] = points[i].speed;
+		cs ^= point_buf[0] ^ point_buf[1] ^ point_buf[2] ^ point_buf[3];
+	}
+	*point_buf = cs;
+	return msg_size + count * trajectory_point_size + 1;
+}
+
+/**
+ * @brief builds a frame which switches the device to another protocol version after its reply
+ */
+void lxr_hp_protocol::build_protocol_message(unsigned char *msg_buf, unsigned char const id, unsigned char const version) {
+	build_command(msg_buf, id, MOTOR_CMD_PROTOCOL, version);
+}
+
+/**
+ * @brief builds a frame which switches the device to another baud rate after its reply - protocol version 2 only
+ */
+void lxr_hp_protocol::build_baud_rate_message(unsigned char *msg_buf, unsigned char const id, E_BAUD_RATE const baud_rate) {
+	build_command(msg_buf, id, MOTOR_CMD_BAUD_RATE, static_cast<unsigned char>(baud_rate));
+}
+
+/**
+ * @brief returns the baud rate in bit/s
+ */
+unsigned int lxr_hp_protocol::baud_rate_value(E_BAUD_RATE const baud_rate) {
+	return baud_rates[baud_rate];
+}
+
+/**
+ * @brief wraps a message into a frame of protocol version 2
+ * @param frame_buf buffer of at least max_frame_size bytes
+ * @return the size of the frame including its delimiter
+ */
+size_t lxr_hp_protocol::encode_frame(unsigned char *frame_buf, unsigned char const seq, unsigned char const *msg, size_t const msg_size) {
+	unsigned char payload[max_msg_size + 2];
+	payload[0] = seq;
+	std::copy(msg, msg + msg_size, payload + 1);
+	payload[msg_size + 1] = crc8(payload, msg_size + 1);
+
+	// consistent overhead byte stuffing, every code byte tells the distance to the next zero
+	size_t code_index = 0;
+	size_t write_index = 1;
+	unsigned char code = 1;
+	for(size_t i = 0; i < msg_size + 2; i++) {
+		if(payload[i] != 0) {
+			frame_buf[write_index++] = payload[i];
+			code++;
+		}
+		if(payload[i] == 0 || code == 0xFF) {
+			frame_buf[code_index] = code;
+			code = 1;
+			code_index = write_index++;
+		}
+	}
+	frame_buf[code_index] = code;
+	frame_buf[write_index++] = frame_delimiter;
+	return write_index;
+}
+
+/**
+ * @brief unwraps the message of a frame of protocol version 2 in place
+ * @param frame the frame without its delimiter, the message starts at frame + 1 afterwards
+ * @return the size of the message, 0 if the frame is corrupted
+ */
+size_t lxr_hp_protocol::decode_frame(unsigned char *frame, size_t const frame_size, unsigned char &seq) {
+	size_t read_index = 0;
+	size_t write_index = 0;
+	while(read_index < frame_size) {
+		unsigned char const code = frame[read_index++];
+		if(code == 0 || read_index + code - 1 > frame_size) return 0;
+		for(unsigned char i = 1; i < code; i++) frame[write_index++] = frame[read_index++];
+		if(code < 0xFF && read_index < frame_size) frame[write_index++] = 0;
+	}
+	// sequence number, at least a reply and the crc
+	if(write_index < reply_size + 2 || crc8(frame, write_index - 1) != frame[write_index - 1]) return 0;
+	seq = frame[0];
+	return write_index - 2;
+}
+
+/**
+ * @brief returns the total size of a frame received from the device
+ * @param header the first reply_header_size bytes of the frame
+ */
+size_t lxr_hp_protocol::reply_frame_size(unsigned char const *header) {
+	if(is_telemetry(header)) return telemetry_size;
+	return is_trajectory_reply(header) ? trajectory_reply_size : reply_size;
+}
+
+/**
+ * @brief returns true if the frame is a telemetry frame
+ */
+bool lxr_hp_protocol::is_telemetry(unsigned char const *frame) {
+	return frame[E_TEL_STATUS] == STATUS_TELEMETRY;
+}
+
+/**
+ * @brief decodes a telemetry frame
+ * @return NO_ERROR or a combination of ID_WRONG and CS_WRONG
+ */
+size_t lxr_hp_protocol::decode_telemetry(unsigned char const *frame, unsigned char const id, s_telemetry_sample &sample) {
+	unsigned char cs = 0;
+	for(size_t i = 0; i < E_TEL_CS; i++) cs ^= frame[i];
+
+	size_t err_code = NO_ERROR;
+	if(frame[E_TEL_ID] != id) err_code |= ID_WRONG;
+	if(cs != frame[E_TEL_CS]) err_code |= CS_WRONG;
+
+	sample.timestamp_ms = read_u16(frame + E_TEL_TIMESTAMP);
+	sample.current_half_bridge_1 = read_u16(frame + E_TEL_CURRENT_1);
+	sample.current_half_bridge_2 = read_u16(frame + E_TEL_CURRENT_2);
+	sample.speed = frame[E_TEL_SPEED];
+	sample.direction = (frame[E_TEL_DIR] == E_FWD) ? E_FWD : E_BWD;
+
+	return err_code;
+}
+
+/**
+ * @brief returns true if the device reports an error, with protocol version 2 also the reply to a corrupted frame
+ */
+bool lxr_hp_protocol::is_error_reply(unsigned char const *frame) {
+	return frame[E_REP_STATUS] == STATUS_ERROR;
+}
+
+/**
+ * @brief returns true if the frame is the reply to a trajectory upload
+ */
+bool lxr_hp_protocol::is_trajectory_reply(unsigned char const *frame) {
+	return frame[E_TRJ_STATUS] == STATUS_TRAJECTORY;
+}
+
+/**
+ * @brief decodes the reply to a trajectory upload
+ * @param accepted number of points appended to the buffer, the remaining ones have to be sent again
+ * @param free_points free space of the trajectory buffer after the upload
+ * @return NO_ERROR or a combination of ID_WRONG and CS_WRONG
+ */
+size_t lxr_hp_protocol::decode_trajectory_reply(unsigned char const *frame, unsigned char const id, size_t &accepted, size_t &free_points) {
+	unsigned char cs = 0;
+	for(size_t i = 0; i < E_TRJ_CS; i++) cs ^= frame[i];
+
+	size_t err_code = NO_ERROR;
+	if(frame[E_TRJ_ID] != id) err_code |= ID_WRONG;
+	if(cs != frame[E_TRJ_CS]) err_code |= CS_WRONG;
+
+	accepted = frame[E_TRJ_ACCEPTED];
+	free_points = frame[E_TRJ_FREE];
+
+	return err_code;
+}
+
+/**
+ * @brief returns the id of the sender of a reply frame
+ */
+unsigned char lxr_hp_protocol::reply_id(unsigned char const *reply) {
+	return reply[E_REP_ID];
+}
+
+/**
+ * @brief evaluates a reply frame
+ * @param reply buffer of reply_size bytes
+ * @param id the id of the device the reply is expected from
+ * @return NO_ERROR or a combination of ID_WRONG, STATUS_WRONG and CS_WRONG
+ */
+size_t lxr_hp_protocol::evaluate_reply(unsigned char const *reply, unsigned char const id) {
+	size_t err_code = NO_ERROR;
+	if(reply[E_REP_ID] != id) err_code |= ID_WRONG;
+	if(reply[E_REP_STATUS] != STATUS_OK) err_code |= STATUS_WRONG;
+	if((reply[E_REP_ID] ^ reply[E_REP_STATUS]) != reply[E_REP_CS]) err_code |= CS_WRONG;
+	return err_code;
+}
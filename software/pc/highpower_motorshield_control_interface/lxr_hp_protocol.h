@@ -0,0 +1,171 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief this module implements the frame format of the serial_motor_driver.ino protocol
+ * @file lxr_hp_protocol.h
+ * @license MPL 2.0
+ */
+
+#ifndef LXR_HP_PROTOCOL_H_
+#define LXR_HP_PROTOCOL_H_
+
+#include <cstddef>
+
+// error codes which are passed to the error callback function
+static size_t const NO_ERROR = 0;
+static size_t const ID_WRONG = 1;
+static size_t const STATUS_WRONG = 2;
+static size_t const CS_WRONG = 4;
+static size_t const SEQ_WRONG = 8; // protocol version 2: no reply received for a frame, a later frame has been answered
+static size_t const TIMEOUT = 16; // no reply received for a frame within the reply timeout
+typedef void(*error_callback)(size_t const err_code);
+
+// typedef for motor direction
+typedef enum {E_BWD = 0, E_FWD = 1} E_MOTOR_DIRECTION;
+
+// baud rates which can be negotiated with protocol version 2, the value is the index sent to the device
+typedef enum {E_BAUD_115200 = 0, E_BAUD_500000 = 1, E_BAUD_1000000 = 2} E_BAUD_RATE;
+
+// one current telemetry sample as streamed by serial_motor_driver.ino
+typedef struct {
+	unsigned short timestamp_ms; // millis() of the arduino, wraps every 65.5 s
+	unsigned short current_half_bridge_1; // raw adc value of IS1
+	unsigned short current_half_bridge_2; // raw adc value of IS2
+	unsigned char speed;
+	E_MOTOR_DIRECTION direction;
+} s_telemetry_sample;
+
+// one point of a trajectory which serial_motor_driver.ino executes on its own timer
+typedef struct {
+	unsigned short time_offset_ms; // to the previous point, to the reception for the first point after the buffer of the device has run empty
+	E_MOTOR_DIRECTION direction;
+	unsigned char speed;
+} s_trajectory_point;
+
+class lxr_hp_protocol {
+public:
+	static size_t const msg_size = 4;
+	static size_t const reply_size = 3;
+	static size_t const reply_header_size = 2;
+	static size_t const telemetry_size = 11;
+	static size_t const trajectory_reply_size = 5;
+	static size_t const max_reply_size = telemetry_size;
+	static size_t const trajectory_point_size = 4;
+	static size_t const trajectory_max_points = 8; // per upload frame
+	static size_t const trajectory_buffer_size = 32; // points of the trajectory buffer of the device
+	static size_t const max_msg_size = msg_size + trajectory_max_points * trajectory_point_size + 1;
+	static unsigned char const protocol_version_1 = 1;
+	static unsigned char const protocol_version_2 = 2;
+	static unsigned char const frame_delimiter = 0;
+	// sequence number, crc and the cobs code byte - the delimiter is not included
+	static size_t const frame_overhead = 3;
+	static size_t const max_frame_size = max_msg_size + frame_overhead + 1;
+
+	/**
+	 * @brief builds a command frame
+	 * @param msg_buf buffer of at least msg_size bytes
+	 */
+	static void build_message(unsigned char *msg_buf, unsigned char const id, E_MOTOR_DIRECTION const dir, unsigned char const speed);
+
+	/**
+	 * @brief builds a frame which configures the telemetry stream of the device
+	 * @param period_ms period of the telemetry samples, 0 turns the stream off
+	 */
+	static void build_telemetry_message(unsigned char *msg_buf, unsigned char const id, unsigned char const period_ms);
+
+	/**
+	 * @brief builds a frame which appends points to the trajectory buffer of the device, 0 points only query its free space
+	 * @param msg_buf buffer of at least max_msg_size bytes
+	 * @param count number of points, at most trajectory_max_points
+	 * @return the size of the frame
+	 */
+	static size_t build_trajectory_message(unsigned char *msg_buf, unsigned char const id, s_trajectory_point const *points, size_t const count);
+
+	/**
+	 * @brief builds a frame which switches the device to another protocol version after its reply
+	 */
+	static void build_protocol_message(unsigned char *msg_buf, unsigned char const id, unsigned char const version);
+
+	/**
+	 * @brief builds a frame which switches the device to another baud rate after its reply - protocol version 2 only
+	 */
+	static void build_baud_rate_message(unsigned char *msg_buf, unsigned char const id, E_BAUD_RATE const baud_rate);
+
+	/**
+	 * @brief returns the baud rate in bit/s
+	 */
+	static unsigned int baud_rate_value(E_BAUD_RATE const baud_rate);
+
+	/**
+	 * @brief wraps a message into a frame of protocol version 2
+	 * @param frame_buf buffer of at least max_frame_size bytes
+	 * @return the size of the frame including its delimiter
+	 */
+	static size_t encode_frame(unsigned char *frame_buf, unsigned char const seq, unsigned char const *msg, size_t const msg_size);
+
+	/**
+	 * @brief unwraps the message of a frame of protocol version 2 in place
+	 * @param frame the frame without its delimiter, the message starts at frame + 1 afterwards
+	 * @return the size of the message, 0 if the frame is corrupted
+	 */
+	static size_t decode_frame(unsigned char *frame, size_t const frame_size, unsigned char &seq);
+
+	/**
+	 * @brief returns the total size of a frame received from the device
+	 * @param header the first reply_header_size bytes of the frame
+	 */
+	static size_t reply_frame_size(unsigned char const *header);
+
+	/**
+	 * @brief returns true if the frame is a telemetry frame
+	 */
+	static bool is_telemetry(unsigned char const *frame);
+
+	/**
+	 * @brief decodes a telemetry frame
+	 * @return NO_ERROR or a combination of ID_WRONG and CS_WRONG
+	 */
+	static size_t decode_telemetry(unsigned char const *frame, unsigned char const id, s_telemetry_sample &sample);
+
+	/**
+	 * @brief returns true if the device reports an error, with protocol version 2 also the reply to a corrupted frame
+	 */
+	static bool is_error_reply(unsigned char const *frame);
+
+	/**
+	 * @brief returns true if the frame is the reply to a trajectory upload
+	 */
+	static bool is_trajectory_reply(unsigned char const *frame);
+
+	/**
+	 * @brief decodes the reply to a trajectory upload
+	 * @param accepted number of points appended to the buffer, the remaining ones have to be sent again
+	 * @param free_points free space of the trajectory buffer after the upload
+	 * @return NO_ERROR or a combination of ID_WRONG and CS_WRONG
+	 */
+	static size_t decode_trajectory_reply(unsigned char const *frame, unsigned char const id, size_t &accepted, size_t &free_points);
+
+	/**
+	 * @brief returns the id of the sender of a reply frame
+	 */
+	static unsigned char reply_id(unsigned char const *reply);
+
+	/**
+	 * @brief evaluates a reply frame
+	 * @param reply buffer of reply_size bytes
+	 * @param id the id of the device the reply is expected from
+	 * @return NO_ERROR or a combination of ID_WRONG, STATUS_WRONG and CS_WRONG
+	 */
+	static size_t evaluate_reply(unsigned char const *reply, unsigned char const id);
+
+private:
+	/**
+	 * @brief Constructor
+	 */
+	lxr_hp_protocol() { }
+};
+
+#endif /* LXR_HP_PROTOCOL_H_ */
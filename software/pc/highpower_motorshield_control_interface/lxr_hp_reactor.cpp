@@ -0,0 +1,39 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief this module runs the serial communication of several lxr_hp_motor_control instances on a few shared threads instead of two threads per instance
+ * @file lxr_hp_reactor.cpp
+ * @license MPL 2.0
+ */
+
+#include "lxr_hp_reactor.h"
+#include <boost/bind.hpp>
+
+/**
+ * @brief Constructor, starts the threads which run the non-blocking reads, writes and timers of all attached ports
+ * @param threads number of threads, the handlers of one port never run concurrently
+ */
+lxr_hp_reactor::lxr_hp_reactor(size_t const threads) : m_io_service(), m_work(new boost::asio::io_service::work(m_io_service)) {
+	for(size_t i = 0; i < threads; i++) {
+		m_threads.create_thread(boost::bind(&boost::asio::io_service::run, &m_io_service));
+	}
+}
+
+/**
+ * @brief Destructor, stops the threads - all lxr_hp_motor_control instances using the reactor have to be destroyed before
+ */
+lxr_hp_reactor::~lxr_hp_reactor() {
+	m_work.reset();
+	m_io_service.stop();
+	m_threads.join_all();
+}
+
+/**
+ * @brief returns the io_service which is shared by the attached ports
+ */
+boost::asio::io_service &lxr_hp_reactor::get_io_service() {
+	return m_io_service;
+}
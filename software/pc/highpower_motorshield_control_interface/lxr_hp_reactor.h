@@ -0,0 +1,45 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief this module runs the serial communication of several lxr_hp_motor_control instances on a few shared threads instead of two threads per instance
+ * @file lxr_hp_reactor.h
+ * @license MPL 2.0
+ */
+
+#ifndef LXR_HP_REACTOR_H_
+#define LXR_HP_REACTOR_H_
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+
+class lxr_hp_reactor {
+public:
+	/**
+	 * @brief Constructor, starts the threads which run the non-blocking reads, writes and timers of all attached ports
+	 * @param threads number of threads, the handlers of one port never run concurrently
+	 */
+	lxr_hp_reactor(size_t const threads = 1);
+
+	/**
+	 * @brief Destructor, stops the threads - all lxr_hp_motor_control instances using the reactor have to be destroyed before
+	 */
+	~lxr_hp_reactor();
+
+	/**
+	 * @brief returns the io_service which is shared by the attached ports
+	 */
+	boost::asio::io_service &get_io_service();
+
+private:
+	// boost::asio waits for the events of all ports with one epoll instance on linux
+	boost::asio::io_service m_io_service;
+	// keeps the threads running while no port is attached
+	boost::scoped_ptr<boost::asio::io_service::work> m_work;
+	boost::thread_group m_threads;
+};
+
+#endif /* LXR_HP_REACTOR_H_ */
@@ -19,6 +19,8 @@
  */
 void error_handler(size_t const err_code) {
 	std::cout << lxr_hp_motor_control::convert_to_string(err_code);
+	// a device which does not answer is tried again, its frames are sent on and the protocol is negotiated again if needed
+	if(err_code == TIMEOUT) return;
 	exit(1);
 }
 
@@ -26,7 +28,10 @@ int main(int argc, char **argv) {
 
 	unsigned char const serial_motor_driver_id = 128;
 
-	lxr_hp_motor_control mc("/dev/ttyACM0", serial_motor_driver_id);
+	// the device node can be passed as the first argument, e.g. the one of serial_motor_driver_sim
+	std::string const dev_node = (argc > 1) ? argv[1] : "/dev/ttyACM0";
+
+	lxr_hp_motor_control mc(dev_node, serial_motor_driver_id);
 	mc.register_error_callback(&error_handler);
 
 	char cmd = 0;
@@ -34,6 +39,7 @@ int main(int argc, char **argv) {
 		std::cout << "LXRobotics Highpower Motorshield Control Menu" << std::endl << std::endl;
 		std::cout << "[0]\tset speed" << std::endl;
 		std::cout << "[1]\tset direction" << std::endl;
+		std::cout << "[2]\tshow communication statistics" << std::endl;
 		std::cout << "[q]\tquit" << std::endl;
 		std::cout << ">> "; std::cin >> cmd;
 
@@ -60,6 +66,12 @@ int main(int argc, char **argv) {
 			default: std::cout << "Error, only 0 and 1 are possible selections" << std::endl; break;
 			}
 		} break;
+		case '2': {
+			s_com_statistics statistics;
+			mc.get_statistics(statistics);
+			std::cout << "frames " << statistics.frames << ", replies " << statistics.replies << ", lost " << statistics.lost << ", timeouts " << statistics.timeouts << ", retransmits " << statistics.retransmits << std::endl;
+			std::cout << "round trip time p50 < " << lxr_hp_motor_control::rtt_percentile_us(statistics, 0.5) << " us, p99 < " << lxr_hp_motor_control::rtt_percentile_us(statistics, 0.99) << " us, max " << statistics.max_rtt_us << " us" << std::endl;
+		} break;
 		case 'q': {
 			std::cout << "Exiting now." << std::endl;
 		} break;
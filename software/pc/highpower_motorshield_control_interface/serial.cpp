@@ -10,14 +10,46 @@
  */
 
 #include "serial.h"
+#include <algorithm>
+#include <boost/checked_delete.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <cerrno>
+#include <poll.h>
+
+std::size_t const serial::m_rx_buffer_size;
 
 /**
  * @brief Constructor
  */
 serial::serial(std::string const &devNode, unsigned int const baudRate) :
-                m_devNode(devNode), m_baudRate(baudRate), m_io_service(), m_serial_port(
-                                m_io_service, m_devNode) {
+                m_devNode(devNode), m_baudRate(baudRate), m_own_io_service(new boost::asio::io_service()), m_io_service(*m_own_io_service), m_serial_port(
+                                m_io_service, m_devNode), m_rx_head(0), m_rx_count(0) {
+
+        configure();
+}
+
+/**
+ * @brief Constructor for a serial port whose asynchronous operations are run by a shared io_service
+ */
+serial::serial(boost::asio::io_service &io_service, std::string const &devNode, unsigned int const baudRate) :
+                m_devNode(devNode), m_baudRate(baudRate), m_own_io_service(), m_io_service(io_service), m_serial_port(
+                                m_io_service, m_devNode), m_rx_head(0), m_rx_count(0) {
 
+        configure();
+}
+
+/**
+ * @brief Destructor
+ */
+serial::~serial() {
+
+}
+
+/**
+ * @brief sets the options of the serial port
+ */
+void serial::configure() {
         m_serial_port.set_option(
                         boost::asio::serial_port_base::baud_rate(m_baudRate));
         m_serial_port.set_option(boost::asio::serial_port_base::character_size(8));
@@ -33,26 +65,187 @@ serial::serial(std::string const &devNode, unsigned int const baudRate) :
 }
 
 /**
- * @brief Destructor
+ * @brief write data to the serial port, a failure is not reported - the reply to the data does not arrive then
  */
-serial::~serial() {
+void serial::writeToSerial(unsigned char const *buf, unsigned int const size) {
+        // a failed write is not thrown, the missing reply shows the failure at its deadline
+        boost::system::error_code error;
+        boost::asio::write(m_serial_port, boost::asio::buffer(buf, size), error);
+}
+
+/**
+ * @brief read data from the serial port
+ */
+boost::shared_ptr<unsigned char> serial::readFromSerial(unsigned int const size) {
+        boost::shared_ptr<unsigned char> buf(new unsigned char[size], boost::checked_array_deleter<unsigned char>());
 
+        readFromSerial(buf.get(), size);
+
+        return buf;
 }
 
 /**
- * @brief write data to the serial port
+ * @brief read exactly size bytes from the serial port into a caller supplied buffer
  */
-void serial::writeToSerial(unsigned char const *buf, unsigned int const size) {
-        boost::asio::write(m_serial_port, boost::asio::buffer(buf, size));
+void serial::readFromSerial(unsigned char *buf, unsigned int const size) {
+        for(unsigned int copied = 0; copied < size; ) {
+                if(m_rx_count == 0) fillRxBuffer();
+
+                // copy the contiguous part of the buffered data
+                std::size_t const contiguous = std::min(m_rx_count, m_rx_buffer_size - m_rx_head);
+                std::size_t const chunk = std::min(contiguous, static_cast<std::size_t>(size - copied));
+                std::copy(m_rx_buffer.begin() + m_rx_head, m_rx_buffer.begin() + m_rx_head + chunk, buf + copied);
+
+                m_rx_head = (m_rx_head + chunk) % m_rx_buffer_size;
+                m_rx_count -= chunk;
+                copied += chunk;
+        }
 }
 
 /**
- * @brief read data from the serial port
+ * @brief read the bytes up to the next delimiter into a caller supplied buffer, the delimiter is consumed
+ * @return the number of bytes before the delimiter, max_size + 1 if the frame did not fit into the buffer
  */
-boost::shared_ptr<unsigned char> serial::readFromSerial(unsigned int const size) {
-        boost::shared_ptr<unsigned char> buf(new unsigned char[size]);
+unsigned int serial::readFrameFromSerial(unsigned char *buf, unsigned int const max_size, unsigned char const delimiter) {
+        unsigned int length = 0;
+        for(;;) {
+                if(m_rx_count == 0) fillRxBuffer();
 
-        boost::asio::read(m_serial_port, boost::asio::buffer(buf.get(), size));
+                unsigned char const c = m_rx_buffer[m_rx_head];
+                m_rx_head = (m_rx_head + 1) % m_rx_buffer_size;
+                m_rx_count--;
+                if(c == delimiter) return length;
 
-        return buf;
+                // the bytes of an overlong frame are dropped up to its delimiter
+                if(length < max_size) buf[length] = c;
+                if(length <= max_size) length++;
+        }
+}
+
+/**
+ * @brief receives at least one byte into the ring buffer, but waits no longer than until the deadline
+ * @return false if no byte has been received until the deadline
+ */
+bool serial::fillRxBuffer(boost::posix_time::ptime const &deadline) {
+        // the wait is not run by the io_service, whose operations would allocate memory for every read
+        struct pollfd pfd = {m_serial_port.native_handle(), POLLIN, 0};
+        for(;;) {
+                long const remaining_us = (deadline - boost::posix_time::microsec_clock::universal_time()).total_microseconds();
+                if(remaining_us <= 0) return false;
+                int const ready = ::poll(&pfd, 1, static_cast<int>((remaining_us + 999) / 1000));
+                if(ready > 0 && (pfd.revents & POLLIN)) break;
+                // a failed port is not polled continuously, the caller sees a timeout at the deadline
+                if(ready > 0 || (ready < 0 && errno != EINTR)) boost::this_thread::sleep(deadline);
+        }
+
+        // more data is only requested if the buffered bytes do not form a complete frame, a full buffer therefore only holds garbage
+        if(m_rx_count == m_rx_buffer_size) m_rx_count = 0;
+
+        std::size_t const tail = (m_rx_head + m_rx_count) % m_rx_buffer_size;
+        std::size_t const contiguous_free = (tail >= m_rx_head) ? (m_rx_buffer_size - tail) : (m_rx_head - tail);
+
+        boost::system::error_code error;
+        std::size_t const received = m_serial_port.read_some(boost::asio::buffer(&m_rx_buffer[tail], contiguous_free), error);
+        if(received == 0) boost::this_thread::sleep(deadline);
+
+        m_rx_count += received;
+        return received > 0;
+}
+
+/**
+ * @brief changes the baud rate of the serial port, a failure is not reported
+ */
+void serial::setBaudRate(unsigned int const baudRate) {
+        m_baudRate = baudRate;
+        boost::system::error_code error;
+        m_serial_port.set_option(
+                        boost::asio::serial_port_base::baud_rate(m_baudRate), error);
+}
+
+/**
+ * @brief receives at least one byte from the serial port into the free part of the ring buffer
+ */
+void serial::fillRxBuffer() {
+        std::size_t const tail = (m_rx_head + m_rx_count) % m_rx_buffer_size;
+        std::size_t const contiguous_free = (tail >= m_rx_head) ? (m_rx_buffer_size - tail) : (m_rx_head - tail);
+
+        std::size_t const received = m_serial_port.read_some(boost::asio::buffer(&m_rx_buffer[tail], contiguous_free));
+
+        m_rx_count += received;
+}
+
+/**
+ * @brief returns the io_service which runs the asynchronous operations of the serial port
+ */
+boost::asio::io_service &serial::getIoService() {
+        return m_io_service;
+}
+
+/**
+ * @brief write data to the serial port without blocking, the buffer has to stay valid until the handler is called
+ */
+void serial::asyncWriteToSerial(unsigned char const *buf, unsigned int const size, boost::function<void (boost::system::error_code const &, std::size_t)> const &handler) {
+        boost::asio::async_write(m_serial_port, boost::asio::buffer(buf, size), handler);
+}
+
+/**
+ * @brief receives at least one byte into the ring buffer without blocking and calls the handler afterwards
+ */
+void serial::asyncFillRxBuffer(boost::function<void (boost::system::error_code const &)> const &handler) {
+        // more data is only requested if the buffered bytes do not form a complete frame, a full buffer therefore only holds garbage
+        if(m_rx_count == m_rx_buffer_size) m_rx_count = 0;
+
+        std::size_t const tail = (m_rx_head + m_rx_count) % m_rx_buffer_size;
+        std::size_t const contiguous_free = (tail >= m_rx_head) ? (m_rx_buffer_size - tail) : (m_rx_head - tail);
+
+        m_serial_port.async_read_some(boost::asio::buffer(&m_rx_buffer[tail], contiguous_free),
+                        boost::bind(&serial::onRxBufferFilled, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, handler));
+}
+
+/**
+ * @brief returns the number of bytes in the ring buffer, reading up to this number of bytes does not block
+ */
+unsigned int serial::bytesAvailable() const {
+        return static_cast<unsigned int>(m_rx_count);
+}
+
+/**
+ * @brief copies size bytes from the ring buffer without consuming them, size must not exceed bytesAvailable()
+ */
+void serial::peekFromSerial(unsigned char *buf, unsigned int const size) const {
+        for(unsigned int i = 0; i < size; i++) buf[i] = m_rx_buffer[(m_rx_head + i) % m_rx_buffer_size];
+}
+
+/**
+ * @brief returns true if the ring buffer contains the delimiter, readFrameFromSerial does then not block
+ */
+bool serial::isFrameAvailable(unsigned char const delimiter) const {
+        for(std::size_t i = 0; i < m_rx_count; i++) {
+                if(m_rx_buffer[(m_rx_head + i) % m_rx_buffer_size] == delimiter) return true;
+        }
+        return false;
+}
+
+/**
+ * @brief drops the bytes in the ring buffer, must not be called while a fill is pending
+ */
+void serial::discardRxBuffer() {
+        m_rx_head = 0;
+        m_rx_count = 0;
+}
+
+/**
+ * @brief closes the serial port, pending asynchronous operations are aborted
+ */
+void serial::close() {
+        boost::system::error_code error;
+        m_serial_port.close(error);
+}
+
+/**
+ * @brief adds the bytes received by asyncFillRxBuffer to the ring buffer and calls its handler
+ */
+void serial::onRxBufferFilled(boost::system::error_code const &error, std::size_t const received, boost::function<void (boost::system::error_code const &)> const &handler) {
+        m_rx_count += received;
+        handler(error);
 }
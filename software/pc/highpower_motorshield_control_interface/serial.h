@@ -14,7 +14,10 @@
 
 #include <string>
 #include <boost/asio.hpp>
+#include <boost/array.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/function.hpp>
 
 class serial {
 public:
@@ -23,26 +26,121 @@ public:
          */
         serial(std::string const &devNode, unsigned int const baudRate);
 
+        /**
+         * @brief Constructor for a serial port whose asynchronous operations are run by a shared io_service
+         */
+        serial(boost::asio::io_service &io_service, std::string const &devNode, unsigned int const baudRate);
+
         /**
          * @brief Destructor
          */
         ~serial();
 
         /**
-         * @brief write data to the serial port
+         * @brief write data to the serial port, a failure is not reported - the reply to the data does not arrive then
          */
         void writeToSerial(unsigned char const *buf, unsigned int const size);
 
         /**
          * @brief read data from the serial port
+         * @deprecated allocates a buffer for every call, use the overload with a caller supplied buffer
          */
         boost::shared_ptr<unsigned char> readFromSerial(unsigned int const size);
 
+        /**
+         * @brief read exactly size bytes from the serial port into a caller supplied buffer
+         * the data is received via a preallocated ring buffer, no heap allocation takes place - must only be called by one thread at a time
+         */
+        void readFromSerial(unsigned char *buf, unsigned int const size);
+
+        /**
+         * @brief read the bytes up to the next delimiter into a caller supplied buffer, the delimiter is consumed
+         * must only be called by one thread at a time
+         * @return the number of bytes before the delimiter, max_size + 1 if the frame did not fit into the buffer
+         */
+        unsigned int readFrameFromSerial(unsigned char *buf, unsigned int const max_size, unsigned char const delimiter);
+
+        /**
+         * @brief receives at least one byte into the ring buffer, but waits no longer than until the deadline
+         * no heap allocation takes place - must only be called by one thread at a time and not while a fill is pending
+         * @return false if no byte has been received until the deadline
+         */
+        bool fillRxBuffer(boost::posix_time::ptime const &deadline);
+
+        /**
+         * @brief changes the baud rate of the serial port, a failure is not reported
+         */
+        void setBaudRate(unsigned int const baudRate);
+
+        /**
+         * @brief returns the io_service which runs the asynchronous operations of the serial port
+         */
+        boost::asio::io_service &getIoService();
+
+        /**
+         * @brief write data to the serial port without blocking, the buffer has to stay valid until the handler is called
+         */
+        void asyncWriteToSerial(unsigned char const *buf, unsigned int const size, boost::function<void (boost::system::error_code const &, std::size_t)> const &handler);
+
+        /**
+         * @brief receives at least one byte into the ring buffer without blocking and calls the handler afterwards
+         * the ring buffer must not be accessed until the handler is called, only one fill may be pending at a time
+         */
+        void asyncFillRxBuffer(boost::function<void (boost::system::error_code const &)> const &handler);
+
+        /**
+         * @brief returns the number of bytes in the ring buffer, reading up to this number of bytes does not block
+         */
+        unsigned int bytesAvailable() const;
+
+        /**
+         * @brief copies size bytes from the ring buffer without consuming them, size must not exceed bytesAvailable()
+         */
+        void peekFromSerial(unsigned char *buf, unsigned int const size) const;
+
+        /**
+         * @brief returns true if the ring buffer contains the delimiter, readFrameFromSerial does then not block
+         */
+        bool isFrameAvailable(unsigned char const delimiter) const;
+
+        /**
+         * @brief drops the bytes in the ring buffer, must not be called while a fill is pending
+         */
+        void discardRxBuffer();
+
+        /**
+         * @brief closes the serial port, pending asynchronous operations are aborted
+         */
+        void close();
+
 private:
+        static std::size_t const m_rx_buffer_size = 256;
+
         std::string m_devNode;
         unsigned int m_baudRate;
-        boost::asio::io_service m_io_service;
+        // only allocated if the serial port is not run by a shared io_service
+        boost::scoped_ptr<boost::asio::io_service> m_own_io_service;
+        boost::asio::io_service &m_io_service;
         boost::asio::serial_port m_serial_port;
+
+        boost::array<unsigned char, m_rx_buffer_size> m_rx_buffer;
+        std::size_t m_rx_head;
+        std::size_t m_rx_count;
+
+        /**
+         * @brief receives at least one byte from the serial port into the free part of the ring buffer
+         */
+        void fillRxBuffer();
+
+        /**
+         * @brief sets the options of the serial port
+         */
+        void configure();
+
+        /**
+         * @brief adds the bytes received by asyncFillRxBuffer to the ring buffer and calls its handler
+         */
+        void onRxBufferFilled(boost::system::error_code const &error, std::size_t const received, boost::function<void (boost::system::error_code const &)> const &handler);
 };
 
 #endif /* SERIAL_H_ */
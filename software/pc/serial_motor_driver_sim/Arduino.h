@@ -0,0 +1,103 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief minimal replacement of the arduino core api used by serial_motor_driver.ino when it is run on linux
+ * @file Arduino.h
+ * @license MPL 2.0
+ */
+
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef bool boolean;
+
+/**
+ * @brief milliseconds since start of the simulator
+ */
+unsigned long millis();
+
+/**
+ * @brief microseconds since start of the simulator
+ */
+unsigned long micros();
+
+/**
+ * @brief sleeps for the given time
+ */
+void delay(unsigned long const ms);
+
+/**
+ * @brief emulation of the arduino serial port on the master side of a pseudo terminal
+ */
+class HardwareSerial {
+public:
+	/**
+	 * @brief Constructor
+	 */
+	HardwareSerial();
+
+	/**
+	 * @brief attaches the serial port to the master file descriptor of the pseudo terminal
+	 * @param latency_us additional delay of every received byte
+	 * @param baud_rate_pacing if != 0 received and sent bytes are paced to this baud rate
+	 * @param corruption_rate probability of a bit flip per byte in both directions
+	 * @param is_paced_to_begin if set the bytes are paced to the baud rate passed to begin instead
+	 */
+	void attach(int const fd, unsigned long const latency_us, unsigned long const baud_rate_pacing, double const corruption_rate, bool const is_paced_to_begin);
+
+	/**
+	 * @brief waits until data is available or timeout_ms has expired
+	 */
+	void wait_for_data(unsigned long const timeout_ms);
+
+	void begin(unsigned long const baud);
+	void setTimeout(unsigned long const timeout_ms);
+	int available();
+	int read();
+	size_t readBytes(char *buf, size_t const length);
+	size_t write(uint8_t const *buf, size_t const size);
+	size_t write(uint8_t const c);
+	void flush();
+
+private:
+	static size_t const m_rx_buffer_size = 64; // like the ring buffer of the arduino core
+
+	int m_fd;
+	unsigned long m_latency_us;
+	unsigned long m_byte_time_us;
+	bool m_is_paced_to_begin;
+	double m_corruption_rate;
+	unsigned long m_timeout_ms;
+
+	uint8_t m_rx_buffer[m_rx_buffer_size];
+	unsigned long m_rx_release_us[m_rx_buffer_size];
+	size_t m_rx_head;
+	size_t m_rx_count;
+	unsigned long m_last_rx_release_us;
+
+	/**
+	 * @brief moves the bytes waiting in the pseudo terminal into the receive buffer
+	 */
+	void poll_fd();
+
+	/**
+	 * @brief sets the time of one byte for the given baud rate, 0 = as fast as possible
+	 */
+	void set_pacing(unsigned long const baud_rate);
+
+	/**
+	 * @brief flips a random bit with the configured probability
+	 */
+	uint8_t corrupt(uint8_t const c) const;
+};
+
+extern HardwareSerial Serial;
+
+#endif /* ARDUINO_H_ */
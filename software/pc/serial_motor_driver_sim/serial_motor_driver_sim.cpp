@@ -0,0 +1,123 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief runs the unmodified serial_motor_driver.ino on linux against a pseudo terminal, the slave side acts as the arduino device node
+ * @file serial_motor_driver_sim.cpp
+ * @license MPL 2.0
+ *
+ * build: g++ -O2 -I. -I../../arduino/LXR_Highpower_Motorshield -I../../arduino/LXR_Highpower_Motorshield/examples/serial_motor_driver
+ *            serial_motor_driver_sim.cpp sim_arduino.cpp sim_motorshield.cpp -o serial_motor_driver_sim -lutil
+ * usage: serial_motor_driver_sim [-l latency_us] [-b baud_rate_pacing | -p] [-c corruption_rate] [-s seed] [-L symlink] [-v]
+ */
+
+#include "Arduino.h"
+#include "sim_motorshield.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* PROTOTYPE SECTION */
+
+// the arduino ide generates prototypes for all functions of a sketch, this has to be done by hand here
+void setup();
+void loop();
+void receive_messages(unsigned long const now);
+void receive_frames(unsigned long const now);
+void process_frame(int const length);
+void start_protocol(uint8_t const version);
+boolean process_message(uint8_t const *msg_buffer);
+boolean process_trajectory_points(uint8_t const *msg_buffer);
+void send_trajectory_reply(uint8_t const accepted);
+void execute_trajectory(unsigned long const now);
+void emergency_stop();
+void send_telemetry(unsigned long const now);
+void send_frame(uint8_t const *msg, int const size);
+int encode_frame(uint8_t const *msg, int const size, uint8_t *frame);
+int cobs_encode(uint8_t const *data, int const size, uint8_t *encoded);
+int cobs_decode(uint8_t *data, int const size);
+uint8_t crc8(uint8_t const *data, int const size);
+
+/* SKETCH SECTION */
+
+#include "serial_motor_driver.ino"
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief prints the command line options
+ */
+static void usage(char const *name) {
+	std::fprintf(stderr, "usage: %s [-l latency_us] [-b baud_rate_pacing | -p] [-c corruption_rate] [-s seed] [-L symlink] [-v]\n", name);
+	std::fprintf(stderr, "  -l  additional delay of every byte received by the sketch in us\n");
+	std::fprintf(stderr, "  -b  pace received and sent bytes to this baud rate (0 = as fast as possible)\n");
+	std::fprintf(stderr, "  -p  pace received and sent bytes to the baud rate the sketch passes to Serial.begin\n");
+	std::fprintf(stderr, "  -c  probability of a bit flip per byte in both directions, e.g. 0.001\n");
+	std::fprintf(stderr, "  -s  seed of the corruption random number generator\n");
+	std::fprintf(stderr, "  -L  create a symlink with this name pointing to the slave device node\n");
+	std::fprintf(stderr, "  -v  print every change of the motor state\n");
+}
+
+int main(int argc, char **argv) {
+
+	unsigned long latency_us = 0;
+	unsigned long baud_rate_pacing = 0;
+	bool is_paced_to_begin = false;
+	double corruption_rate = 0.0;
+	unsigned int seed = 1;
+	char const *symlink_name = 0;
+
+	int opt = 0;
+	while((opt = getopt(argc, argv, "l:b:pc:s:L:vh")) != -1) {
+		switch(opt) {
+		case 'l': latency_us = std::strtoul(optarg, 0, 10); break;
+		case 'b': baud_rate_pacing = std::strtoul(optarg, 0, 10); break;
+		case 'p': is_paced_to_begin = true; break;
+		case 'c': corruption_rate = std::strtod(optarg, 0); break;
+		case 's': seed = static_cast<unsigned int>(std::strtoul(optarg, 0, 10)); break;
+		case 'L': symlink_name = optarg; break;
+		case 'v': sim_motorshield::set_verbose(true); break;
+		default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	std::srand(seed);
+
+	int master_fd = -1, slave_fd = -1;
+	char slave_name[64] = {0};
+	if(openpty(&master_fd, &slave_fd, slave_name, 0, 0) != 0) {
+		std::perror("openpty");
+		return EXIT_FAILURE;
+	}
+	// raw mode on the master side, the pc library configures the slave side itself
+	struct termios tio;
+	tcgetattr(master_fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(master_fd, TCSANOW, &tio);
+
+	if(symlink_name != 0) {
+		unlink(symlink_name);
+		if(symlink(slave_name, symlink_name) != 0) std::perror("symlink");
+	}
+
+	std::printf("serial_motor_driver simulator listening on %s\n", slave_name);
+	std::fflush(stdout);
+
+	Serial.attach(master_fd, latency_us, baud_rate_pacing, corruption_rate, is_paced_to_begin);
+
+	setup();
+	for(;;) {
+		loop();
+		// do not spin, but wake up at least every ms for the time based parts of the sketch
+		Serial.wait_for_data(1);
+		std::fflush(stdout);
+	}
+
+	// the slave side is kept open so that the pty does not hang up while no client is connected
+	close(slave_fd);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief minimal replacement of the arduino core api used by serial_motor_driver.ino when it is run on linux
+ * @file sim_arduino.cpp
+ * @license MPL 2.0
+ */
+
+#include "Arduino.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+/* GLOBAL VARIABLE SECTION */
+HardwareSerial Serial;
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief monotonic time in microseconds
+ */
+static unsigned long long monotonic_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long long>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static unsigned long long const m_start_us = monotonic_us();
+
+/**
+ * @brief milliseconds since start of the simulator
+ */
+unsigned long millis() {
+	return static_cast<unsigned long>((monotonic_us() - m_start_us) / 1000);
+}
+
+/**
+ * @brief microseconds since start of the simulator
+ */
+unsigned long micros() {
+	return static_cast<unsigned long>(monotonic_us() - m_start_us);
+}
+
+/**
+ * @brief sleeps for the given time
+ */
+void delay(unsigned long const ms) {
+	usleep(ms * 1000);
+}
+
+/**
+ * @brief Constructor
+ */
+HardwareSerial::HardwareSerial() : m_fd(-1), m_latency_us(0), m_byte_time_us(0), m_is_paced_to_begin(false), m_corruption_rate(0.0), m_timeout_ms(1000), m_rx_head(0), m_rx_count(0), m_last_rx_release_us(0) {
+
+}
+
+/**
+ * @brief attaches the serial port to the master file descriptor of the pseudo terminal
+ */
+void HardwareSerial::attach(int const fd, unsigned long const latency_us, unsigned long const baud_rate_pacing, double const corruption_rate, bool const is_paced_to_begin) {
+	m_fd = fd;
+	m_latency_us = latency_us;
+	set_pacing(baud_rate_pacing);
+	m_is_paced_to_begin = is_paced_to_begin;
+	m_corruption_rate = corruption_rate;
+}
+
+/**
+ * @brief waits until data is available or timeout_ms has expired
+ */
+void HardwareSerial::wait_for_data(unsigned long const timeout_ms) {
+	if(available() > 0) return;
+
+	if(m_rx_count > 0) {
+		// a byte has been received but is still delayed by the latency/pacing emulation
+		unsigned long const now = micros();
+		unsigned long const release = m_rx_release_us[m_rx_head];
+		unsigned long const wait_us = std::min(release - now, timeout_ms * 1000);
+		usleep(wait_us);
+		return;
+	}
+
+	struct pollfd pfd = {m_fd, POLLIN, 0};
+	poll(&pfd, 1, static_cast<int>(timeout_ms));
+}
+
+void HardwareSerial::begin(unsigned long const baud) {
+	if(m_is_paced_to_begin) set_pacing(baud);
+}
+
+void HardwareSerial::setTimeout(unsigned long const timeout_ms) {
+	m_timeout_ms = timeout_ms;
+}
+
+int HardwareSerial::available() {
+	poll_fd();
+	unsigned long const now = micros();
+	int cnt = 0;
+	for(size_t i = 0; i < m_rx_count; i++) {
+		if(static_cast<long>(now - m_rx_release_us[(m_rx_head + i) % m_rx_buffer_size]) < 0) break;
+		cnt++;
+	}
+	return cnt;
+}
+
+int HardwareSerial::read() {
+	if(available() == 0) return -1;
+	uint8_t const c = m_rx_buffer[m_rx_head];
+	m_rx_head = (m_rx_head + 1) % m_rx_buffer_size;
+	m_rx_count--;
+	return c;
+}
+
+size_t HardwareSerial::readBytes(char *buf, size_t const length) {
+	size_t cnt = 0;
+	while(cnt < length) {
+		// like Stream::timedRead the timeout restarts for every byte
+		unsigned long const start = millis();
+		int c = read();
+		while(c < 0 && (millis() - start) < m_timeout_ms) {
+			wait_for_data(m_timeout_ms - (millis() - start));
+			c = read();
+		}
+		if(c < 0) break;
+		buf[cnt++] = static_cast<char>(c);
+	}
+	return cnt;
+}
+
+size_t HardwareSerial::write(uint8_t const *buf, size_t const size) {
+	uint8_t tx[256];
+	size_t written = 0;
+	while(written < size) {
+		size_t const chunk = std::min(size - written, sizeof(tx));
+		for(size_t i = 0; i < chunk; i++) tx[i] = corrupt(buf[written + i]);
+		if(::write(m_fd, tx, chunk) != static_cast<ssize_t>(chunk)) break;
+		written += chunk;
+	}
+	// the uart needs this long to shift the bytes out
+	if(m_byte_time_us > 0) usleep(m_byte_time_us * written);
+	return written;
+}
+
+size_t HardwareSerial::write(uint8_t const c) {
+	return write(&c, 1);
+}
+
+void HardwareSerial::flush() {
+
+}
+
+/**
+ * @brief moves the bytes waiting in the pseudo terminal into the receive buffer
+ */
+void HardwareSerial::poll_fd() {
+	if(m_fd < 0 || m_rx_count == m_rx_buffer_size) return;
+
+	struct pollfd pfd = {m_fd, POLLIN, 0};
+	if(poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) return;
+
+	uint8_t buf[m_rx_buffer_size];
+	ssize_t const n = ::read(m_fd, buf, m_rx_buffer_size - m_rx_count);
+	if(n <= 0) return;
+
+	unsigned long const now = micros();
+	for(ssize_t i = 0; i < n; i++) {
+		unsigned long release = now + m_latency_us;
+		if(m_byte_time_us > 0 && static_cast<long>(m_last_rx_release_us + m_byte_time_us - release) > 0) release = m_last_rx_release_us + m_byte_time_us;
+		m_last_rx_release_us = release;
+
+		size_t const tail = (m_rx_head + m_rx_count) % m_rx_buffer_size;
+		m_rx_buffer[tail] = corrupt(buf[i]);
+		m_rx_release_us[tail] = release;
+		m_rx_count++;
+	}
+}
+
+/**
+ * @brief sets the time of one byte for the given baud rate, 0 = as fast as possible
+ */
+void HardwareSerial::set_pacing(unsigned long const baud_rate) {
+	// 1 start bit, 8 data bits, 1 stop bit
+	m_byte_time_us = (baud_rate > 0) ? (10UL * 1000000UL + baud_rate - 1) / baud_rate : 0;
+}
+
+/**
+ * @brief flips a random bit with the configured probability
+ */
+uint8_t HardwareSerial::corrupt(uint8_t const c) const {
+	if(m_corruption_rate <= 0.0) return c;
+	if(std::rand() >= m_corruption_rate * (static_cast<double>(RAND_MAX) + 1.0)) return c;
+	return static_cast<uint8_t>(c ^ (1 << (std::rand() % 8)));
+}
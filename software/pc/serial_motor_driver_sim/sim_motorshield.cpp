@@ -0,0 +1,77 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief stub implementation of LXR_highpower_motorshield for running serial_motor_driver.ino on linux
+ * @file sim_motorshield.cpp
+ * @license MPL 2.0
+ */
+
+#include "Arduino.h"
+#include "LXR_highpower_motorshield.h"
+#include "sim_motorshield.h"
+
+#include <cstdio>
+
+/* GLOBAL VARIABLE SECTION */
+static uint8_t m_speed = 0;
+static E_DIRECTION m_direction = FWD;
+static bool m_verbose = false;
+
+// raw adc counts per speed step of the simulated motor current (20 counts = 1 A)
+static int const CURRENT_PER_SPEED_STEP = 2;
+
+/* FUNCTION SECTION */
+
+/**
+ * @brief enables a log line with the time since the start for every change of the motor state
+ */
+void sim_motorshield::set_verbose(bool const verbose) {
+	m_verbose = verbose;
+}
+
+void LXR_highpower_motorshield::begin(E_PWM_MODE const pwm_mode) {
+	(void)pwm_mode;
+	m_speed = 0;
+	m_direction = FWD;
+}
+
+void LXR_highpower_motorshield::set_speed(uint8_t const speed) {
+	if(m_verbose && speed != m_speed) std::printf("%lu ms: speed = %u\n", millis(), speed);
+	m_speed = speed;
+}
+
+uint8_t LXR_highpower_motorshield::get_speed() {
+	return m_speed;
+}
+
+void LXR_highpower_motorshield::set_direction(E_DIRECTION const dir) {
+	if(m_verbose && dir != m_direction) std::printf("%lu ms: direction = %s\n", millis(), (dir == FWD) ? "FWD" : "BWD");
+	m_direction = dir;
+}
+
+E_DIRECTION LXR_highpower_motorshield::get_direction() {
+	return m_direction;
+}
+
+void LXR_highpower_motorshield::begin_current_sampling() {
+
+}
+
+int LXR_highpower_motorshield::get_current_half_brigde_1() {
+	return (m_direction == FWD) ? m_speed * CURRENT_PER_SPEED_STEP : 0;
+}
+
+int LXR_highpower_motorshield::get_current_half_brigde_2() {
+	return (m_direction == BWD) ? m_speed * CURRENT_PER_SPEED_STEP : 0;
+}
+
+int LXR_highpower_motorshield::get_average_current_half_brigde_1() {
+	return get_current_half_brigde_1();
+}
+
+int LXR_highpower_motorshield::get_average_current_half_brigde_2() {
+	return get_current_half_brigde_2();
+}
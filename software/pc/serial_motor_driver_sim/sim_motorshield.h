@@ -0,0 +1,29 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * @author Alexander Entinger, MSc / LXRobotics GmbH
+ * @brief stub implementation of LXR_highpower_motorshield for running serial_motor_driver.ino on linux
+ * @file sim_motorshield.h
+ * @license MPL 2.0
+ */
+
+#ifndef SIM_MOTORSHIELD_H_
+#define SIM_MOTORSHIELD_H_
+
+class sim_motorshield {
+public:
+	/**
+	 * @brief enables a log line with the time since the start for every change of the motor state
+	 */
+	static void set_verbose(bool const verbose);
+
+private:
+	/**
+	 * @brief Constructor
+	 */
+	sim_motorshield() { }
+};
+
+#endif /* SIM_MOTORSHIELD_H_ */